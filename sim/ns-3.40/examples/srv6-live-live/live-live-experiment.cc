@@ -367,6 +367,7 @@ main(int argc, char* argv[])
     float flowEndTime = 11.0f;
     float endTime = 20.0f;
     bool dumpTraffic = false;
+    bool seqnEvents = false;
     std::string defaultBuffer = "1000p";
     std::string activeBuffer = "1000p";
     std::string backupBuffer = "1000p";
@@ -402,6 +403,9 @@ main(int argc, char* argv[])
     cmd.AddValue("seed", "The seed used for the simulation", seed);
     cmd.AddValue("alternate", "Enables the SD-WAN use case", alternate);
     cmd.AddValue("dump", "Dump traffic during the simulation", dumpTraffic);
+    cmd.AddValue("seqn-events",
+                 "Record the Live-Live sequence numbers to binary files instead of the bmv2 log",
+                 seqnEvents);
     cmd.AddValue("verbose", "Verbose output", verbose);
 
     cmd.Parse(argc, argv);
@@ -670,6 +674,10 @@ main(int argc, char* argv[])
     liveliveHelper.SetDeviceAttribute(
         "PipelineJson",
         StringValue("/ns3/ns-3.40/examples/srv6-live-live/livelive_build/srv6_livelive.json"));
+    if (seqnEvents)
+    {
+        liveliveHelper.SetDeviceAttribute("LogLevel", StringValue("Off"));
+    }
 
     uint8_t mac_str[6];
     std::ostringstream spreaderPortsCommand;
@@ -731,6 +739,11 @@ main(int argc, char* argv[])
     std::string e1Commands =
         spreaderPortsCommand.str() + "table_add srv6_function srv6_ll_deduplicate 85 => \n";
     liveliveHelper.SetDeviceAttribute("PipelineCommands", StringValue(e1Commands));
+    if (seqnEvents)
+    {
+        liveliveHelper.SetDeviceAttribute("EventLogFile",
+                                          StringValue(getPath(resultsPath, "seqn-e1.bin")));
+    }
     liveliveHelper.Install(e1, e1Interfaces);
 
     std::ostringstream despreaderPortsCommand;
@@ -774,6 +787,11 @@ main(int argc, char* argv[])
                   "table_add srv6_live_live_forward add_srv6_ll_segment 1 => e1::55\n" +
                   despreaderPortsCommand.str();
     liveliveHelper.SetDeviceAttribute("PipelineCommands", StringValue(e2Commands));
+    if (seqnEvents)
+    {
+        liveliveHelper.SetDeviceAttribute("EventLogFile",
+                                          StringValue(getPath(resultsPath, "seqn-e2.bin")));
+    }
     liveliveHelper.Install(e2, e2Interfaces);
 
     if (verbose)
@@ -203,6 +203,14 @@ TraceCwnd(std::string fileName, uint32_t nodeId)
                     MakeCallback(&CwndTracer));
 }
 
+void
+PathStatsTracer(Ptr<OutputStreamWrapper> stream, const LiveLivePathStats& stats)
+{
+    *stream->GetStream() << Simulator::Now().GetSeconds() << " " << stats.flowId << " "
+                         << stats.port << " " << stats.wins << " " << stats.dups << " "
+                         << stats.tooOld << " " << stats.gap.GetNanoSeconds() << std::endl;
+}
+
 std::map<std::string, std::pair<uint64_t, uint64_t>> ctx2tpInfo;
 std::map<std::string, FILE*> tpStream;
 Time period = Time::FromInteger(100, Time::Unit::MS);
@@ -317,6 +325,7 @@ main(int argc, char* argv[])
     std::string pathBuffer = "1000p";
     uint32_t maxBytes = 15000000;
     uint32_t nPaths = 2;
+    uint32_t llPaths = 0;
     std::string testType = "live-live";
     uint32_t seed = 10;
 
@@ -336,6 +345,10 @@ main(int argc, char* argv[])
     cmd.AddValue("path-buffer", "The size of the N paths buffers", pathBuffer);
     cmd.AddValue("seed", "The seed used for the simulation", seed);
     cmd.AddValue("n-paths", "Number of alternative paths", nPaths);
+    cmd.AddValue("ll-paths",
+                 "Number of paths each Live-Live flow is replicated on, chosen by the first "
+                 "copies delivered on each path (0 replicates on all the paths)",
+                 llPaths);
     cmd.AddValue("test-type", "Test type", testType);
     cmd.AddValue("dump", "Dump traffic during the simulation", dumpTraffic);
     cmd.AddValue("verbose", "Verbose output", verbose);
@@ -363,6 +376,7 @@ main(int argc, char* argv[])
     NS_LOG_INFO("N Path Buffer Size: " + pathBuffer);
     NS_LOG_INFO("TCP Congestion Control: " + congestionControl);
     NS_LOG_INFO("End Time: " + std::to_string(endTime));
+    NS_LOG_INFO("Live-Live Paths per Flow: " + std::to_string(llPaths));
 
     NS_LOG_INFO("Configuring Congestion Control.");
     Config::SetDefault("ns3::TcpSocket::SndBufSize", UintegerValue(2 << 17));
@@ -371,6 +385,10 @@ main(int argc, char* argv[])
     Config::SetDefault("ns3::TcpSocket::DelAckCount", UintegerValue(2));
     Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(1400));
 
+    // Switches are only configured in-process, skip the per-switch Thrift servers
+    Config::SetDefault("ns3::P4SwitchNetDevice::ControlPlane",
+                       EnumValue(P4SwitchNetDevice::CONTROL_PLANE_INPROC));
+
     std::filesystem::create_directories(resultsPath);
 
     std::mt19937 generator(seed);
@@ -567,7 +585,7 @@ main(int argc, char* argv[])
     }
 
     liveliveHelper.SetDeviceAttribute("PipelineCommands", StringValue(spreaderPortsCommand.str()));
-    liveliveHelper.Install(e1, e1Interfaces);
+    NetDeviceContainer e1Switch = liveliveHelper.Install(e1, e1Interfaces);
 
     std::ostringstream despreaderMcastSS;
     despreaderMcastSS << "mc_mgrp_create 1\n"
@@ -637,7 +655,29 @@ main(int argc, char* argv[])
 
     liveliveHelper.SetDeviceAttribute("PipelineCommands",
                                       StringValue(despreaderPortsCommand.str()));
-    liveliveHelper.Install(e2, e2Interfaces);
+    NetDeviceContainer e2Switch = liveliveHelper.Install(e2, e2Interfaces);
+
+    // Replicate each flow, in both directions, only on the paths that deliver it first
+    std::vector<Ptr<LiveLivePathSelector>> pathSelectors;
+    if (testType == "live-live" && llPaths > 0 && llPaths < nPaths)
+    {
+        for (uint32_t direction = 0; direction < 2; direction++)
+        {
+            Ptr<LiveLivePathSelector> selector = CreateObject<LiveLivePathSelector>();
+            selector->SetAttribute("ActivePaths", UintegerValue(llPaths));
+            selector->SetSpreader(direction == 0 ? e1Switch.Get(0) : e2Switch.Get(0));
+            selector->SetMerger(direction == 0 ? e2Switch.Get(0) : e1Switch.Get(0));
+            for (uint32_t i = 0; i < nPaths; ++i)
+            {
+                uint32_t e1Port = llFlows + 1 + i;
+                uint32_t e2Port = 1 + i;
+                selector->AddPath(direction == 0 ? e1Port : e2Port,
+                                  direction == 0 ? e2Port : e1Port);
+            }
+            selector->Start(Seconds(1.0));
+            pathSelectors.push_back(selector);
+        }
+    }
 
     NS_LOG_INFO("e1 COMMANDS:");
     NS_LOG_INFO(spreaderPortsCommand.str());
@@ -711,6 +751,26 @@ main(int argc, char* argv[])
     NS_LOG_INFO("Configure Tracing.");
     AsciiTraceHelper ascii;
 
+    // First copies, duplicates, too old packets and second-copy gap of each path, at e2
+    Ptr<LiveLivePathMonitor> pathMonitor;
+    if (testType == "live-live")
+    {
+        std::string pathStatsPath = getPath(resultsPath, "path-stats");
+        std::filesystem::create_directories(pathStatsPath);
+
+        pathMonitor = CreateObject<LiveLivePathMonitor>();
+        pathMonitor->SetMerger(e2Switch.Get(0));
+        for (uint32_t i = 0; i < nPaths; ++i)
+        {
+            pathMonitor->AddPort(1 + i);
+        }
+        pathMonitor->TraceConnectWithoutContext(
+            "PathStats",
+            MakeBoundCallback(&PathStatsTracer,
+                              ascii.CreateFileStream(getPath(pathStatsPath, "ll-paths.data"))));
+        pathMonitor->Start(Seconds(1.0));
+    }
+
     std::string cwndPath = getPath(resultsPath, "cwnd");
     std::filesystem::create_directories(cwndPath);
 
@@ -290,445 +290,56 @@ startThroughputTrace(std::string fileName, uint32_t nodeId, uint32_t ifaceId)
 
 /* SDWAN Functions */
 std::string SDWAN_LATENCY_CHECK_INTERVAL = "100ms";
-Time SDWAN_TARGET_LATENCY;
 std::string sdWanMode = "latency";
 
-void checkLatency(Ipv6Address srcAddr,
-                  Ipv6Address dstAddr,
-                  Ptr<Node> e1,
-                  Ptr<Node> e2,
-                  uint32_t startingPort);
-
-void checkLiveLiveLatency(Ipv6Address srcAddr,
-                          Ipv6Address dstAddr,
-                          Ptr<Node> e1,
-                          Ptr<Node> e2,
-                          uint32_t startingPort);
-
-void tcpRx(Ipv6Address srcAddr,
-           Ipv6Address dstAddr,
-           Ptr<Node> e1,
-           Ptr<Node> e2,
-           uint32_t startingPort,
-           std::string context,
-           const Ptr<const Packet> p,
-           const TcpHeader& hdr,
-           const Ptr<const TcpSocketBase> skt);
-
-void enableLiveLive(Ptr<Node> e1, Ipv6Address srcAddr, Ipv6Address dstAddr);
-
-void disableLiveLive(Ptr<Node> e1, Ipv6Address srcAddr, Ipv6Address dstAddr);
-
-bool llChecking = false;
-std::map<std::pair<Ipv6Address, Ipv6Address>, int64_t>* flowPrevTs =
-    new std::map<std::pair<Ipv6Address, Ipv6Address>, int64_t>;
-std::map<std::pair<Ipv6Address, Ipv6Address>, std::list<int64_t>>* flowLatencies =
-    new std::map<std::pair<Ipv6Address, Ipv6Address>, std::list<int64_t>>;
-
-std::map<std::string, std::map<std::pair<Ipv6Address, Ipv6Address>, int64_t>*>* llPrevTs =
-    new std::map<std::string, std::map<std::pair<Ipv6Address, Ipv6Address>, int64_t>*>;
-std::map<std::string,
-         std::map<std::pair<Ipv6Address, Ipv6Address>, std::list<int64_t>>*>* llLatencies =
-    new std::map<std::string, std::map<std::pair<Ipv6Address, Ipv6Address>, std::list<int64_t>>*>;
-
-Ipv6Prefix srcPrefix("2001::", 64);
-Ipv6Prefix dstPrefix("2002::", 64);
-
-std::map<std::pair<Ipv6Address, Ipv6Address>, std::string> flow2Handles;
-
-/* Callback for SD-WAN Latency Mode */
-void
-tracePktRxNetDevice(std::string context, Ptr<const Packet> p)
+/* Latency samples of the path carrying a flow since the last print */
+struct LatencySamples
 {
-    Ptr<Packet> pkt = p->Copy();
-    EthernetHeader eth;
-    pkt->RemoveHeader(eth);
-    if (eth.GetLengthType() != 0x86dd)
-        return;
-
-    Ipv6Header ipv6;
-    pkt->PeekHeader(ipv6);
-    if (ipv6.GetNextHeader() != Ipv6Header::IPV6_EXT_ROUTING)
-        return;
-
-    bool matched = false;
-    pkt->RemoveHeader(ipv6);
-
-    Ipv6Header innerIpv6;
-    if (!llChecking && ipv6.GetDestination() == Ipv6Address("e2::2"))
-    {
-        /* Really not UDP, but it's 8Bytes! And SRv6 is 24B here, so remove 3 times. */
-        UdpHeader junk;
-        pkt->RemoveHeader(junk);
-        pkt->RemoveHeader(junk);
-        pkt->RemoveHeader(junk);
-
-        pkt->PeekHeader(innerIpv6);
-
-        matched = true;
-    }
-    else if (llChecking && ipv6.GetDestination() == Ipv6Address("e2::55"))
-    {
-        /* Really not UDP, but it's 8Bytes! And SRv6 is 40B here, so remove 5 times. */
-        UdpHeader junk;
-        pkt->RemoveHeader(junk);
-        pkt->RemoveHeader(junk);
-        pkt->RemoveHeader(junk);
-        pkt->RemoveHeader(junk);
-        pkt->RemoveHeader(junk);
-        /* Remove LL TLV */
-        pkt->RemoveHeader(junk);
-
-        pkt->PeekHeader(innerIpv6);
-
-        matched = true;
-    }
-
-    if (!matched)
-        return;
-
-    if (innerIpv6.GetSource().HasPrefix(srcPrefix) &&
-        innerIpv6.GetDestination().HasPrefix(dstPrefix))
-    {
-        std::map<std::pair<Ipv6Address, Ipv6Address>, int64_t>* tsMapToUse;
-        std::map<std::pair<Ipv6Address, Ipv6Address>, std::list<int64_t>>* latencyMapToUse;
-
-        if (!llChecking)
-        {
-            tsMapToUse = flowPrevTs;
-            latencyMapToUse = flowLatencies;
-        }
-        else
-        {
-            auto tsMapIt = llPrevTs->find(context);
-            auto latMapit = llLatencies->find(context);
-            if (tsMapIt == llPrevTs->end())
-            {
-                std::map<std::pair<Ipv6Address, Ipv6Address>, int64_t>* ctxTs =
-                    new std::map<std::pair<Ipv6Address, Ipv6Address>, int64_t>;
-                llPrevTs->insert(std::make_pair(context, ctxTs));
-                tsMapToUse = ctxTs;
-
-                std::map<std::pair<Ipv6Address, Ipv6Address>, std::list<int64_t>>* ctxLat =
-                    new std::map<std::pair<Ipv6Address, Ipv6Address>, std::list<int64_t>>;
-                llLatencies->insert(std::make_pair(context, ctxLat));
-                latencyMapToUse = ctxLat;
-            }
-            else
-            {
-                tsMapToUse = ((*tsMapIt).second);
-                latencyMapToUse = ((*latMapit).second);
-            }
-        }
-
-        std::pair key(innerIpv6.GetSource(), innerIpv6.GetDestination());
-        auto tsIt = tsMapToUse->find(key);
-        if (tsIt == tsMapToUse->end())
-        {
-            tsMapToUse->insert(std::make_pair(key, Simulator::Now().GetNanoSeconds()));
-        }
-        else
-        {
-            uint64_t latency = Simulator::Now().GetNanoSeconds() - (*tsIt).second;
-
-            auto it = latencyMapToUse->find(key);
-            if (it == latencyMapToUse->end())
-            {
-                std::list<int64_t> latencies;
-                latencies.push_back(latency);
-
-                latencyMapToUse->insert(std::make_pair(key, latencies));
-            }
-            else
-            {
-                (*it).second.push_back(latency);
-            }
-
-            tsMapToUse->erase(tsIt);
-        }
-    }
-}
-
-/* Callback for SD-WAN TCP Mode */
-void
-startTcpRx(uint32_t nodeId,
-           Ipv6Address srcAddr,
-           Ipv6Address dstAddr,
-           Ptr<Node> e1,
-           Ptr<Node> e2,
-           uint32_t startingPort)
-{
-    Config::Connect("/NodeList/" + std::to_string(nodeId) + "/$ns3::TcpL4Protocol/SocketList/1/Rx",
-                    MakeBoundCallback(&tcpRx, srcAddr, dstAddr, e1, e2, startingPort));
-}
-
-/* Generic Functions */
-std::string
-runP4CommandAndGetHandle(P4SwitchNetDevice* p4Switch, std::string command)
-{
-    std::string output = p4Switch->RunPipelineCommands(command);
-
-    StringVector lines = SplitString(output, "\n");
-    for (auto line : lines)
-    {
-        if (line.find("with handle") != std::string::npos)
-        {
-            StringVector tokens = SplitString(line, " ");
-            return tokens.back();
-        }
-    }
-
-    return "";
-}
-
-void
-changeFlowRoute(uint32_t port,
-                Ptr<Node> e1,
-                Ptr<Node> e2,
-                Ipv6Address srcAddr,
-                Ipv6Address dstAddr,
-                uint32_t startingPort)
-{
-    Ptr<NetDevice> e1Device = e1->GetDevice(e1->GetNDevices() - 1);
-    P4SwitchNetDevice* e1P4Switch = dynamic_cast<P4SwitchNetDevice*>(&(*(e1Device)));
-
-    Ptr<NetDevice> e2Device = e2->GetDevice(e2->GetNDevices() - 1);
-    P4SwitchNetDevice* e2P4Switch = dynamic_cast<P4SwitchNetDevice*>(&(*(e2Device)));
-
-    std::pair e1Key(srcAddr, dstAddr);
-    auto e1It = flow2Handles.find(e1Key);
-    if (e1It != flow2Handles.end())
-    {
-        std::ostringstream spreaderCommand;
-        spreaderCommand << "table_delete check_live_live_enabled " << (*e1It).second << std::endl;
-        std::string out = e1P4Switch->RunPipelineCommands(spreaderCommand.str());
-
-        flow2Handles.erase(e1It);
-    }
-
-    std::pair e2Key(dstAddr, srcAddr);
-    auto e2It = flow2Handles.find(e2Key);
-    if (e2It != flow2Handles.end())
-    {
-        std::ostringstream despreaderCommand;
-        despreaderCommand << "table_delete check_live_live_enabled " << (*e2It).second << std::endl;
-        e2P4Switch->RunPipelineCommands(despreaderCommand.str());
-
-        flow2Handles.erase(e2It);
-    }
-
-    std::ostringstream spreaderCommand;
-    spreaderCommand << "table_add check_live_live_enabled ipv6_encap_forward_port " << srcAddr
-                    << "/128 => e1::2 " << startingPort + port << std::endl;
-    std::string e1Handle = runP4CommandAndGetHandle(e1P4Switch, spreaderCommand.str());
-    flow2Handles.insert(std::make_pair(e1Key, e1Handle));
-
-    std::ostringstream despreaderCommand;
-    despreaderCommand << "table_add check_live_live_enabled ipv6_encap_forward_port " << dstAddr
-                      << "/128 => e2::2 " << port << std::endl;
-    std::string e2Handle = runP4CommandAndGetHandle(e2P4Switch, despreaderCommand.str());
-    flow2Handles.insert(std::make_pair(e2Key, e2Handle));
-}
+    double sum = 0;
+    uint32_t count = 0;
+};
 
 void
-checkLatency(Ipv6Address srcAddr,
-             Ipv6Address dstAddr,
-             Ptr<Node> e1,
-             Ptr<Node> e2,
-             uint32_t startingPort)
+sampleTracer(Ptr<SrV6PathController> controller,
+             LatencySamples* samples,
+             uint32_t path,
+             Time sample)
 {
-    bool reschedule = true;
-
-    std::pair key(srcAddr, dstAddr);
-
-    auto it = flowLatencies->find(key);
-    if (it != flowLatencies->end())
-    {
-        if (!(*it).second.empty())
-        {
-            double sum = std::accumulate((*it).second.begin(), (*it).second.end(), 0.0);
-            Time avg(sum / (*it).second.size());
-
-            std::cout << "ll-latency-ts=" << Simulator::Now().GetSeconds()
-                      << " ll-latency=" << avg.GetMicroSeconds() << std::endl;
-
-            if (sdWanMode == "latency" && avg.Compare(SDWAN_TARGET_LATENCY) >= 0)
-            {
-                std::cout << "ll-sdwan-enabled=" << Simulator::Now().GetSeconds() << std::endl;
-
-                Simulator::Schedule(Seconds(1),
-                                    &checkLiveLiveLatency,
-                                    srcAddr,
-                                    dstAddr,
-                                    e1,
-                                    e2,
-                                    startingPort);
-                enableLiveLive(e1, srcAddr, dstAddr);
-                reschedule = false;
-            }
-        }
-
-        (*it).second.clear();
-        flowPrevTs->erase(key);
-    }
+    /* Only the path carrying the flow, replicas are only used to choose the next one */
+    if (controller->IsProbing() || path != controller->GetPath())
+        return;
 
-    if (reschedule)
-    {
-        Simulator::Schedule(Time(SDWAN_LATENCY_CHECK_INTERVAL),
-                            &checkLatency,
-                            srcAddr,
-                            dstAddr,
-                            e1,
-                            e2,
-                            startingPort);
-    }
+    samples->sum += sample.GetNanoSeconds();
+    samples->count++;
 }
 
-/* Functions for Latency Mode */
 void
-enableLiveLive(Ptr<Node> e1, Ipv6Address srcAddr, Ipv6Address dstAddr)
+printLatency(LatencySamples* samples)
 {
-    llChecking = true;
-
-    Ptr<NetDevice> e1Device = e1->GetDevice(e1->GetNDevices() - 1);
-    P4SwitchNetDevice* e1P4Switch = dynamic_cast<P4SwitchNetDevice*>(&(*(e1Device)));
-
-    std::pair key(srcAddr, dstAddr);
-    auto it = flow2Handles.find(key);
-    if (it != flow2Handles.end())
+    if (samples->count > 0)
     {
-        std::ostringstream spreaderCommand;
-        spreaderCommand << "table_delete check_live_live_enabled " << (*it).second << std::endl;
-        std::string out = e1P4Switch->RunPipelineCommands(spreaderCommand.str());
-
-        flow2Handles.erase(it);
+        Time avg(samples->sum / samples->count);
+        std::cout << "ll-latency-ts=" << Simulator::Now().GetSeconds()
+                  << " ll-latency=" << avg.GetMicroSeconds() << std::endl;
+        *samples = LatencySamples();
     }
 
-    std::ostringstream spreaderCommand;
-    spreaderCommand << "table_add check_live_live_enabled live_live_mcast " << srcAddr
-                    << "/128 => 1 e1::2 " << std::endl;
-    std::string e1Handle = runP4CommandAndGetHandle(e1P4Switch, spreaderCommand.str());
-
-    flow2Handles.insert(std::make_pair(key, e1Handle));
+    Simulator::Schedule(Time(SDWAN_LATENCY_CHECK_INTERVAL), &printLatency, samples);
 }
 
 void
-disableLiveLive(Ptr<Node> e1, Ipv6Address srcAddr, Ipv6Address dstAddr)
+alertTracer(uint32_t path)
 {
-    llChecking = false;
-
-    Ptr<NetDevice> e1Device = e1->GetDevice(e1->GetNDevices() - 1);
-    P4SwitchNetDevice* e1P4Switch = dynamic_cast<P4SwitchNetDevice*>(&(*(e1Device)));
-
-    std::pair key(srcAddr, dstAddr);
-    auto it = flow2Handles.find(key);
-    if (it != flow2Handles.end())
-    {
-        std::ostringstream spreaderCommand;
-        spreaderCommand << "table_delete check_live_live_enabled " << (*it).second << std::endl;
-        std::string out = e1P4Switch->RunPipelineCommands(spreaderCommand.str());
-
-        flow2Handles.erase(it);
-    }
+    std::cout << "ll-sdwan-enabled=" << Simulator::Now().GetSeconds() << std::endl;
 }
 
+/* Callback for SD-WAN TCP Mode */
 void
-checkLiveLiveLatency(Ipv6Address srcAddr,
-                     Ipv6Address dstAddr,
-                     Ptr<Node> e1,
-                     Ptr<Node> e2,
-                     uint32_t startingPort)
-{
-    std::pair key(srcAddr, dstAddr);
-
-    std::string minCtx = "";
-    float minLatency = std::numeric_limits<float>::max();
-    for (auto item : *llLatencies)
-    {
-        auto it = (item.second)->find(key);
-        if (it != (item.second)->end() && !(*it).second.empty())
-        {
-            if (verbose)
-            {
-                for (auto l : (*it).second)
-                {
-                    NS_LOG_INFO(item.first << " latency=" << l);
-                }
-            }
-
-            double sum = std::accumulate((*it).second.begin(), (*it).second.end(), 0.0);
-            double avg = sum / (*it).second.size();
-            avg /= 1000000.0f; // milliseconds
-
-            if (avg < minLatency)
-            {
-                minLatency = avg;
-                minCtx = item.first;
-            }
-        }
-
-        if (it != (item.second)->end())
-        {
-            (*it).second.clear();
-            llPrevTs->at(item.first)->erase(key);
-        }
-    }
-
-    disableLiveLive(e1, srcAddr, dstAddr);
-    if (minCtx != "")
-    {
-        if (verbose)
-        {
-            NS_LOG_INFO("Getting best latency of " << minLatency << " on ctx " << minCtx);
-        }
-
-        StringVector parts = SplitString(minCtx, "/");
-        uint32_t port = std::stoi(parts[4]) + 1;
-        changeFlowRoute(port, e1, e2, srcAddr, dstAddr, startingPort);
-    }
-    Simulator::Schedule(Time(SDWAN_LATENCY_CHECK_INTERVAL),
-                        &checkLatency,
-                        srcAddr,
-                        dstAddr,
-                        e1,
-                        e2,
-                        startingPort);
-}
-
-/* Functions for TCP Mode */
-SequenceNumber32 prevSeqno(0);
-uint32_t oooPkts = 0;
-uint32_t N_RETRANSMISSIONS_THRESHOLD = 34;
-
-void
-tcpRx(Ipv6Address srcAddr,
-      Ipv6Address dstAddr,
-      Ptr<Node> e1,
-      Ptr<Node> e2,
-      uint32_t startingPort,
-      std::string context,
-      const Ptr<const Packet> p,
-      const TcpHeader& hdr,
-      const Ptr<const TcpSocketBase> skt)
+startTcpRx(uint32_t nodeId, Ptr<SrV6PathController> controller)
 {
-    SequenceNumber32 currSeqno = hdr.GetSequenceNumber();
-
-    if (currSeqno <= prevSeqno)
-    {
-        oooPkts++;
-        if (oooPkts >= N_RETRANSMISSIONS_THRESHOLD)
-        {
-            std::cout << "ll-sdwan-enabled=" << Simulator::Now().GetSeconds() << std::endl;
-
-            changeFlowRoute(2, e1, e2, srcAddr, dstAddr, startingPort);
-
-            oooPkts = 0;
-        }
-    }
-    else
-    {
-        prevSeqno = currSeqno;
-    }
+    Config::ConnectWithoutContext("/NodeList/" + std::to_string(nodeId) +
+                                      "/$ns3::TcpL4Protocol/SocketList/1/Rx",
+                                  MakeCallback(&SrV6PathController::ReceiveTcpSegment, controller));
 }
 
 int
@@ -821,7 +432,6 @@ main(int argc, char* argv[])
     if (sdWanMode == "latency")
     {
         NS_LOG_INFO("Sensitive Flow Latency: " + sdWanTargetDelay);
-        SDWAN_TARGET_LATENCY = Time(sdWanTargetDelay);
     }
 
     NS_LOG_INFO("Configuring Congestion Control.");
@@ -1109,7 +719,7 @@ main(int argc, char* argv[])
     std::string e1Commands =
         spreaderPortsCommand.str() + "table_add srv6_function srv6_ll_deduplicate 85 => \n";
     liveliveHelper.SetDeviceAttribute("PipelineCommands", StringValue(e1Commands));
-    liveliveHelper.Install(e1, e1Interfaces);
+    NetDeviceContainer e1Switch = liveliveHelper.Install(e1, e1Interfaces);
 
     std::ostringstream despreaderPortsCommand;
     for (uint32_t i = 0; i < llFlows; i++)
@@ -1151,7 +761,7 @@ main(int argc, char* argv[])
         "table_add srv6_live_live_forward add_srv6_ll_segment 1 => e1::55\n" +
         despreaderPortsCommand.str();
     liveliveHelper.SetDeviceAttribute("PipelineCommands", StringValue(e2Commands));
-    liveliveHelper.Install(e2, e2Interfaces);
+    NetDeviceContainer e2Switch = liveliveHelper.Install(e2, e2Interfaces);
 
     if (verbose)
     {
@@ -1225,6 +835,9 @@ main(int argc, char* argv[])
     }
 
     uint16_t llPort = 40000;
+    uint32_t startingPort = llFlows + activeFlows + backupFlows;
+    std::vector<Ptr<SrV6PathController>> controllers;
+    std::vector<LatencySamples> latencySamples(llFlows);
     if (llFlows > 0)
     {
         for (uint32_t i = 0; i < llFlows; i++)
@@ -1241,27 +854,31 @@ main(int argc, char* argv[])
             llSenderApp.Start(Seconds(1.0));
             llSenderApp.Stop(Seconds(flowEndTime));
 
+            /* The flow starts on the active path, e2 ports 1 and 2 are the active and backup */
+            Ptr<SrV6PathController> controller = CreateObject<SrV6PathController>();
+            controller->SetAttribute("Mode", StringValue(sdWanMode));
+            controller->SetAttribute("TargetLatency", TimeValue(Time(sdWanTargetDelay)));
+            controller->SetSpreader(DynamicCast<P4SwitchNetDevice>(e1Switch.Get(0)));
+            controller->SetMerger(DynamicCast<P4SwitchNetDevice>(e2Switch.Get(0)));
+            controller->SetFlow(srcAddr, dstAddr);
+            controller->AddPath(startingPort + 1, 1, e2Interfaces.Get(0));
+            controller->AddPath(startingPort + 2, 2, e2Interfaces.Get(1));
+            controller->TraceConnectWithoutContext(
+                "Sample",
+                MakeBoundCallback(&sampleTracer, controller, &latencySamples[i]));
+            controller->TraceConnectWithoutContext("Alert", MakeCallback(&alertTracer));
+            controller->Start();
+            controllers.push_back(controller);
             Simulator::Schedule(Time(SDWAN_LATENCY_CHECK_INTERVAL),
-                                &checkLatency,
-                                srcAddr,
-                                dstAddr,
-                                e1,
-                                e2,
-                                llFlows + activeFlows + backupFlows);
+                                &printLatency,
+                                &latencySamples[i]);
 
             if (sdWanMode == "tcp")
             {
-                for (uint32_t i = 0; i < llFlows; i++)
-                {
-                    Simulator::Schedule(Seconds(1.1),
-                                        &startTcpRx,
-                                        llReceivers.Get(i)->GetId(),
-                                        srcAddr,
-                                        dstAddr,
-                                        e1,
-                                        e2,
-                                        llFlows + activeFlows + backupFlows);
-                }
+                Simulator::Schedule(Seconds(1.1),
+                                    &startTcpRx,
+                                    llReceivers.Get(i)->GetId(),
+                                    controller);
             }
         }
     }
@@ -1311,10 +928,6 @@ main(int argc, char* argv[])
         }
     }
 
-    Config::Connect("/NodeList/" + std::to_string(e2->GetId()) +
-                        "/DeviceList/*/$ns3::CsmaNetDevice/MacPromiscRx",
-                    MakeCallback(&tracePktRxNetDevice));
-
     NS_LOG_INFO("Configure Tracing.");
     AsciiTraceHelper ascii;
 
@@ -1367,9 +980,4 @@ main(int argc, char* argv[])
     {
         fclose(item.second);
     }
-
-    delete flowPrevTs;
-    delete flowLatencies;
-    delete llPrevTs;
-    delete llLatencies;
 }
@@ -1,4 +1,6 @@
+import glob
 import os
+import struct
 import sys
 from itertools import islice
 
@@ -188,19 +190,35 @@ def plot_throughput_figure(results):
 
 
 def plot_seqn_figure(results):
-    def plot_seqn_line(ll_port, color, marker, label):
-        to_plot = {'x': [], 'y': [], 'dy': []}
+    def read_seqn_events():
+        # Binary files written by the P4 switches with --seqn-events, see P4EventSink
+        events = []
+        for file_name in sorted(glob.glob(os.path.join(results, "seqn-*.bin"))):
+            with open(file_name, "rb") as f:
+                magic, version = struct.unpack("<4sI", f.read(8))
+                if magic != b"P4EV" or version != 1:
+                    continue
+                events.extend(struct.iter_unpack("<QII", f.read()))
+        return sorted(events)
+
+    def read_seqn_log():
+        # "ll-pkt-seqno" lines printed by log_msg() in the bmv2 log
+        events = []
         with open(os.path.join(results, "log.txt"), "r") as f:
-            seqn_lines = f.readlines()
+            for line in f:
+                if not "ll-pkt-seqno" in line:
+                    continue
+                line = line.strip().split()
+                events.append((int(line[6]), int(line[9]), int(line[-1])))
+        return events
 
-        for line in seqn_lines:
-            if not "ll-pkt-seqno" in line:
-                continue
-            line = line.strip().split()
-            port = int(line[-1])
+    seqn_events = read_seqn_events() or read_seqn_log()
+
+    def plot_seqn_line(ll_port, color, marker, label):
+        to_plot = {'x': [], 'y': [], 'dy': []}
+        for ts, seqn, port in seqn_events:
             if port == ll_port:
-                ts = int(line[6]) / 10 ** 9
-                seqn = int(line[9])
+                ts = ts / 10 ** 9
 
                 if ts > 12:
                     continue
@@ -24,6 +24,7 @@ end=40
 dump=""
 random=""
 alternate=""
+seqn_events="--seqn-events"
 
 random_lbl="b"
 if [[ $random != "" ]]
@@ -36,7 +37,7 @@ result_path="$ll_flows-$active_flows-$backup_flows-$random_lbl/$default_bw-$acti
 
 mkdir -p results/$result_path
 ../../ns3 run "live-live-experiment --results-path=examples/srv6-live-live/results/$result_path --ll-flows=$ll_flows --active-flows=$active_flows --backup-flows=$backup_flows  --default-bw=$default_bw --ll-rate=$ll_rate --active-bw=$active_bw --active-delay=$active_delay --active-rate-tcp=$active_rate_tcp --active-rate-udp=$active_rate_udp --backup-bw=$backup_bw --backup-delay=$backup_delay --backup-rate-tcp=$backup_rate_tcp --max-bytes=$maxBytes 
---backup-rate-udp=$backup_rate_udp --congestion-control=$congestion_control --default-buffer=$default_buffer --active-buffer=$active_buffer --backup-buffer=$backup_buffer --flow-end=$flow_end --end=$end --seed=$seed $random $dump $alternate" > results/$result_path/log.txt
+--backup-rate-udp=$backup_rate_udp --congestion-control=$congestion_control --default-buffer=$default_buffer --active-buffer=$active_buffer --backup-buffer=$backup_buffer --flow-end=$flow_end --end=$end --seed=$seed $random $dump $alternate $seqn_events" > results/$result_path/log.txt
 
 python3 flowmon_parser.py results/$result_path/flow-monitor/flow_monitor.xml
 python3 plot.py results/$result_path/ figures/$result_path
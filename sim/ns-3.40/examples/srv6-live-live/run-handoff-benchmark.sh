@@ -0,0 +1,100 @@
+#!/bin/bash
+
+# Packets/s on one core of P4Pipeline::process, before and after a change of the ns-3 <-> bmv2
+# packet handoff. Both arguments are ns-3.40 trees, e.g. extracted from two revisions with
+#   git archive <rev> sim/ns-3.40 | tar -x --strip-components=2 -C <dir>
+# The same microbenchmark, which only uses the public P4Pipeline API (from the constructor with
+# enableThrift on), is built in the scratch folder of both trees, so that the numbers only differ
+# by the pipeline code.
+
+if [ $# -ne 2 ]; then
+    echo "usage: $0 <before ns-3.40 tree> <after ns-3.40 tree>"
+    exit 1
+fi
+
+json="/ns3/ns-3.40/examples/srv6-live-live/forward_build/srv6_forward.json"
+packets=1000000
+payload_size=1400
+core=0
+output="results/benchmark/handoff.json"
+
+benchmark=$(cat <<'EOF'
+#include "ns3/core-module.h"
+#include "ns3/ethernet-header.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/p4-switch-module.h"
+
+#include <chrono>
+#include <iostream>
+
+using namespace ns3;
+
+int
+main(int argc, char* argv[])
+{
+    std::string json;
+    uint32_t packets = 100000;
+    uint32_t payloadSize = 1400;
+
+    CommandLine cmd;
+    cmd.AddValue("json", "The bmv2 JSON of srv6_forward.p4", json);
+    cmd.AddValue("packets", "Number of packets to process", packets);
+    cmd.AddValue("payload-size", "UDP payload size in bytes", payloadSize);
+    cmd.Parse(argc, argv);
+
+    P4Pipeline pipeline(json, "bench", false);
+    pipeline.run_cli_commands("table_add srv6_table srv6_noop 2002::/64 => 2");
+
+    Ptr<Packet> packet = Create<Packet>(payloadSize);
+    UdpHeader udp;
+    udp.SetSourcePort(10000);
+    udp.SetDestinationPort(20000);
+    packet->AddHeader(udp);
+    Ipv6Header ipv6;
+    ipv6.SetSource(Ipv6Address("2001::1"));
+    ipv6.SetDestination(Ipv6Address("2002::1"));
+    ipv6.SetNextHeader(UdpL4Protocol::PROT_NUMBER);
+    ipv6.SetPayloadLength(packet->GetSize());
+    ipv6.SetHopLimit(64);
+    packet->AddHeader(ipv6);
+    EthernetHeader eth;
+    eth.SetLengthType(Ipv6L3Protocol::PROT_NUMBER);
+    packet->AddHeader(eth);
+
+    auto run = [&](uint32_t n) {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            delete pipeline.process(packet, 1);
+        }
+    };
+
+    run(packets / 100);
+    auto start = std::chrono::steady_clock::now();
+    run(packets);
+    double elapsed =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << packets / elapsed << std::endl;
+
+    return 0;
+}
+EOF
+)
+
+mkdir -p results/benchmark
+
+runs=""
+for tree in "$1" "$2"
+do
+    echo "$benchmark" > "$tree/scratch/handoff-benchmark.cc"
+    (cd "$tree" && ./ns3 configure --build-profile=optimized > /dev/null && ./ns3 build handoff-benchmark > /dev/null) || exit 1
+
+    pps=$(cd "$tree" && taskset -c $core ./ns3 run --no-build "handoff-benchmark --json=$json --packets=$packets --payload-size=$payload_size" 2>/dev/null | tail -n 1)
+    echo "tree=$tree pps_per_core=$pps"
+
+    runs="$runs${runs:+, }{\"tree\": \"$tree\", \"pps_per_core\": $pps}"
+    rm "$tree/scratch/handoff-benchmark.cc"
+done
+
+echo "{\"benchmark\": \"handoff\", \"packets\": $packets, \"payload_size\": $payload_size, \"runs\": [$runs]}" > $output
+chmod 777 -R results
@@ -0,0 +1,41 @@
+#!/bin/bash
+
+# Simulated seconds per wall-clock second of live-live-n-path, from 2 to 64 paths.
+# Wall-clock time includes the setup of the topology and of the P4 pipelines.
+
+default_bw="100Mbps"
+path_bw="100Mbps"
+ll_rate="10Mbps"
+maxBytes=12500000
+path_delay="5us"
+congestion_control="TcpCubic"
+ll_flows=1
+default_buffer="10000p"
+path_buffer="10000p"
+seed=1
+end=10
+test_type="live-live"
+output="results/benchmark/n-path.json"
+
+mkdir -p results/benchmark
+../../ns3 build live-live-n-path > /dev/null || exit 1
+
+runs=""
+for n_paths in 2 4 8 16 32 64
+do
+    result_path="benchmark/n-path/$n_paths"
+    mkdir -p results/$result_path
+
+    start=$(date +%s.%N)
+    ../../ns3 run --no-build "live-live-n-path --results-path=examples/srv6-live-live/results/$result_path --ll-flows=$ll_flows --default-bw=$default_bw --ll-rate=$ll_rate --path-bw=$path_bw --path-delay=$path_delay --max-bytes=$maxBytes --congestion-control=$congestion_control --default-buffer=$default_buffer --path-buffer=$path_buffer --end=$end --seed=$seed --n-paths=$n_paths --test-type=$test_type" > results/$result_path/log.txt
+    stop=$(date +%s.%N)
+
+    wall=$(awk "BEGIN { print $stop - $start }")
+    speed=$(awk "BEGIN { print $end / $wall }")
+    echo "n_paths=$n_paths wall_s=$wall sim_s_per_wall_s=$speed"
+
+    runs="$runs${runs:+, }{\"n_paths\": $n_paths, \"sim_s\": $end, \"wall_s\": $wall, \"sim_s_per_wall_s\": $speed}"
+done
+
+echo "{\"benchmark\": \"live-live-n-path\", \"test_type\": \"$test_type\", \"runs\": [$runs]}" > $output
+chmod 777 -R results
@@ -0,0 +1,432 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Benchmarks of the P4 switch.
+ *
+ * Packets are pushed through a P4 pipeline in a loop and the achieved packets/s and ns/packet on
+ * one core are printed, and optionally saved as JSON to track regressions. The pipeline cases
+ * call P4Pipeline::process without running the simulator, so they measure the glue between ns-3
+ * and bmv2 (packet conversion, PRE, egress) together with the P4 program:
+ *
+ *   forward  srv6_forward.p4, an SRv6 packet matching a single LPM entry
+ *   encap    srv6_livelive.p4, an IPv6/UDP packet encapsulated in SRv6 towards one port
+ *   mcast    srv6_livelive.p4, an IPv6/UDP packet replicated on --mcast-n Live-Live paths
+ *   dedup    srv6_livelive.p4, Live-Live packets each received twice, on two ports. Sequence
+ *            numbers span the whole 16-bit space, so 65536 packets are kept in memory
+ *
+ * The device case sends the forward packet through a P4SwitchNetDevice between two simple
+ * devices and runs the simulator, measuring a full switch hop. Bmv2 logging is disabled.
+ *
+ *   ./ns3 run "p4-pipeline-benchmark --case=all --packets=1000000 --output=bench.json"
+ *
+ * End-to-end simulation speed over the n-path topology is measured by
+ * examples/srv6-live-live/run-n-path-benchmark.sh.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/ethernet-header.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+#include "ns3/p4-switch-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE("P4PipelineBenchmark");
+
+namespace
+{
+
+/**
+ * Result of a benchmark case
+ */
+struct BenchmarkResult
+{
+    std::string name; //!< Case name
+    uint64_t packets; //!< Packets processed
+    uint64_t outputs; //!< Packets emitted by the switch
+    uint32_t size;    //!< Size of the input packets, Ethernet included
+    double elapsed;   //!< Wall-clock seconds
+};
+
+/**
+ * Build an IPv6/UDP packet from 2001::1 to 2002::1
+ */
+Ptr<Packet>
+MakeUdpPacket(uint32_t payloadSize)
+{
+    Ptr<Packet> packet = Create<Packet>(payloadSize);
+
+    UdpHeader udp;
+    udp.SetSourcePort(10000);
+    udp.SetDestinationPort(20000);
+    packet->AddHeader(udp);
+
+    Ipv6Header ipv6;
+    ipv6.SetSource(Ipv6Address("2001::1"));
+    ipv6.SetDestination(Ipv6Address("2002::1"));
+    ipv6.SetNextHeader(UdpL4Protocol::PROT_NUMBER);
+    ipv6.SetPayloadLength(packet->GetSize());
+    ipv6.SetHopLimit(64);
+    packet->AddHeader(ipv6);
+
+    return packet;
+}
+
+/**
+ * Build a Live-Live packet, as emitted by e1 towards the deduplication function e2::55
+ */
+Ptr<Packet>
+MakeLiveLivePacket(uint32_t payloadSize, uint16_t seqN)
+{
+    Ptr<Packet> packet = MakeUdpPacket(payloadSize);
+
+    LiveLiveTlvHeader tlv;
+    tlv.SetSeqN(seqN);
+    tlv.SetFlowId(1);
+    packet->AddHeader(tlv);
+
+    Ipv6SegmentRoutingHeader srh;
+    srh.SetNextHeader(Ipv6Header::IPV6_IPV6);
+    srh.SetHdrExtLen(2);
+    srh.SetSegmentsLeft(0);
+    srh.SetTag(1);
+    srh.SetSegments({Ipv6Address("e2::55")});
+    packet->AddHeader(srh);
+
+    Ipv6Header ipv6;
+    ipv6.SetSource(Ipv6Address("e1::2"));
+    ipv6.SetDestination(Ipv6Address("e2::55"));
+    ipv6.SetNextHeader(Ipv6Header::IPV6_EXT_ROUTING);
+    ipv6.SetPayloadLength(packet->GetSize());
+    ipv6.SetHopLimit(64);
+    packet->AddHeader(ipv6);
+
+    return packet;
+}
+
+/**
+ * Add the Ethernet header that the switch ports would restore
+ */
+Ptr<Packet>
+AddEthernet(Ptr<Packet> packet)
+{
+    EthernetHeader eth;
+    eth.SetSource(Mac48Address("00:00:00:00:00:01"));
+    eth.SetDestination(Mac48Address("00:00:00:00:00:02"));
+    eth.SetLengthType(Ipv6L3Protocol::PROT_NUMBER);
+    packet->AddHeader(eth);
+    return packet;
+}
+
+/**
+ * Run a pipeline case: the inputs are processed in a loop, in order, in batches of batchSize
+ */
+BenchmarkResult
+RunPipeline(const std::string& name,
+            const std::string& json,
+            const std::string& commands,
+            const std::vector<P4PipelineInput>& inputs,
+            uint32_t packets,
+            uint32_t warmup,
+            uint32_t batchSize)
+{
+    P4Pipeline pipeline(json, "bench", false, bm::Logger::LogLevel::OFF);
+    std::cout << pipeline.run_cli_commands(commands);
+
+    uint64_t outputs = 0;
+    size_t next = 0;
+    std::vector<P4PipelineInput> batch;
+    std::vector<P4PipelineOutput> pkts;
+    auto run = [&](uint32_t n) {
+        for (uint32_t i = 0; i < n; i += std::max(batchSize, 1U))
+        {
+            pkts.clear();
+            if (batchSize <= 1)
+            {
+                pipeline.process(inputs[next].packet, inputs[next].port, pkts);
+                next = (next + 1) % inputs.size();
+            }
+            else
+            {
+                batch.clear();
+                for (uint32_t j = 0; j < batchSize; j++)
+                {
+                    batch.push_back(inputs[next]);
+                    next = (next + 1) % inputs.size();
+                }
+                pipeline.process_batch(batch, pkts);
+            }
+            outputs += pkts.size();
+        }
+    };
+
+    run(warmup);
+    outputs = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    run(packets);
+    auto end = std::chrono::steady_clock::now();
+
+    return {name,
+            packets,
+            outputs,
+            inputs[0].packet->GetSize(),
+            std::chrono::duration<double>(end - start).count()};
+}
+
+uint64_t g_received = 0; //!< Packets received by the sink of the device case
+
+void
+CountReceived(Ptr<NetDevice> device,
+              Ptr<const Packet> packet,
+              uint16_t protocol,
+              const Address& from,
+              const Address& to,
+              NetDevice::PacketType packetType)
+{
+    g_received++;
+}
+
+void
+SendPackets(Ptr<NetDevice> device, Ptr<Packet> packet, Address dst, uint32_t n, Time interval)
+{
+    device->Send(packet->Copy(), dst, Ipv6L3Protocol::PROT_NUMBER);
+    if (n > 1)
+    {
+        Simulator::Schedule(interval, &SendPackets, device, packet, dst, n - 1, interval);
+    }
+}
+
+/**
+ * Run the device case: packets are sent one every interval through a P4SwitchNetDevice
+ */
+BenchmarkResult
+RunDevice(const std::string& json,
+          const std::string& commands,
+          Ptr<Packet> packet,
+          uint32_t packets,
+          Time interval)
+{
+    NodeContainer nodes;
+    nodes.Create(3);
+
+    auto addDevice = [](Ptr<Node> node, Ptr<SimpleChannel> channel) {
+        Ptr<SimpleNetDevice> device = CreateObject<SimpleNetDevice>();
+        device->SetAddress(Mac48Address::Allocate());
+        device->SetChannel(channel);
+        node->AddDevice(device);
+        return device;
+    };
+
+    Ptr<SimpleChannel> inChannel = CreateObject<SimpleChannel>();
+    Ptr<SimpleChannel> outChannel = CreateObject<SimpleChannel>();
+    Ptr<SimpleNetDevice> src = addDevice(nodes.Get(0), inChannel);
+    NetDeviceContainer ports;
+    ports.Add(addDevice(nodes.Get(1), inChannel));
+    ports.Add(addDevice(nodes.Get(1), outChannel));
+    Ptr<SimpleNetDevice> dst = addDevice(nodes.Get(2), outChannel);
+
+    P4SwitchHelper helper;
+    helper.SetDeviceAttribute("PipelineJson", StringValue(json));
+    helper.SetDeviceAttribute("PipelineCommands", StringValue(commands));
+    helper.SetDeviceAttribute("ControlPlane", EnumValue(P4SwitchNetDevice::CONTROL_PLANE_INPROC));
+    helper.SetDeviceAttribute("LogLevel", EnumValue(P4SwitchNetDevice::LOG_LEVEL_OFF));
+    helper.Install(nodes.Get(1), ports);
+
+    nodes.Get(2)->RegisterProtocolHandler(MakeCallback(&CountReceived), 0, dst, true);
+    g_received = 0;
+    Simulator::ScheduleWithContext(nodes.Get(0)->GetId(),
+                                   Seconds(0),
+                                   &SendPackets,
+                                   src,
+                                   packet,
+                                   ports.Get(0)->GetAddress(),
+                                   packets,
+                                   interval);
+
+    auto start = std::chrono::steady_clock::now();
+    Simulator::Run();
+    auto end = std::chrono::steady_clock::now();
+    Simulator::Destroy();
+
+    return {"device",
+            packets,
+            g_received,
+            packet->GetSize() + 14,
+            std::chrono::duration<double>(end - start).count()};
+}
+
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::string benchCase = "forward";
+    std::string forwardJson = "/ns3/ns-3.40/examples/srv6-live-live/forward_build/srv6_forward.json";
+    std::string liveliveJson =
+        "/ns3/ns-3.40/examples/srv6-live-live/livelive_build/srv6_livelive.json";
+    std::string commands;
+    std::string output;
+    uint32_t packets = 100000;
+    uint32_t payloadSize = 1400;
+    uint32_t warmup = 1000;
+    uint32_t batch = 1;
+    uint32_t mcastN = 2;
+    Time interval = MicroSeconds(1);
+
+    CommandLine cmd;
+    cmd.AddValue("case", "forward, encap, mcast, dedup, device or all", benchCase);
+    cmd.AddValue("json", "The bmv2 JSON of srv6_forward.p4", forwardJson);
+    cmd.AddValue("livelive-json", "The bmv2 JSON of srv6_livelive.p4", liveliveJson);
+    cmd.AddValue("commands", "CLI commands replacing the ones of the case", commands);
+    cmd.AddValue("packets", "Number of packets to process", packets);
+    cmd.AddValue("payload-size", "UDP payload size in bytes", payloadSize);
+    cmd.AddValue("warmup", "Number of packets processed before measuring", warmup);
+    cmd.AddValue("batch", "Number of packets given to the pipeline at once", batch);
+    cmd.AddValue("mcast-n", "Number of Live-Live paths of the mcast case", mcastN);
+    cmd.AddValue("interval", "Time between the packets of the device case", interval);
+    cmd.AddValue("output", "JSON file where to save the results", output);
+    cmd.Parse(argc, argv);
+
+    auto caseCommands = [&commands](const std::string& defaults) {
+        return commands.empty() ? defaults : commands;
+    };
+    std::string forwardCommands = caseCommands("table_add srv6_table srv6_noop e2::/64 => 2");
+
+    std::vector<BenchmarkResult> results;
+    auto selected = [&benchCase](const std::string& name) {
+        return benchCase == name || benchCase == "all";
+    };
+
+    if (selected("forward"))
+    {
+        Ptr<Packet> packet = AddEthernet(MakeLiveLivePacket(payloadSize, 1));
+        results.push_back(RunPipeline("forward",
+                                      forwardJson,
+                                      forwardCommands,
+                                      {{packet, 1}},
+                                      packets,
+                                      warmup,
+                                      batch));
+    }
+
+    if (selected("encap"))
+    {
+        Ptr<Packet> packet = AddEthernet(MakeUdpPacket(payloadSize));
+        results.push_back(RunPipeline(
+            "encap",
+            liveliveJson,
+            caseCommands("table_add check_live_live_enabled ipv6_encap_forward_port 2001::/64 => "
+                         "e1::2 2\n"
+                         "table_add srv6_forward add_srv6_dest_segment 2 => e2::2"),
+            {{packet, 1}},
+            packets,
+            warmup,
+            batch));
+    }
+
+    if (selected("mcast"))
+    {
+        std::ostringstream mcastCommands;
+        mcastCommands << "mc_mgrp_create 1\nmc_node_create 1";
+        for (uint32_t i = 0; i < mcastN; i++)
+        {
+            mcastCommands << " " << i + 2;
+        }
+        mcastCommands << "\nmc_node_associate 1 0\n"
+                      << "table_add check_live_live_enabled live_live_mcast 2001::/64 => 1 e1::2\n"
+                      << "table_add srv6_live_live_forward add_srv6_ll_segment 1 => e2::55";
+
+        Ptr<Packet> packet = AddEthernet(MakeUdpPacket(payloadSize));
+        results.push_back(RunPipeline("mcast-" + std::to_string(mcastN),
+                                      liveliveJson,
+                                      caseCommands(mcastCommands.str()),
+                                      {{packet, 1}},
+                                      packets,
+                                      warmup,
+                                      batch));
+    }
+
+    if (selected("dedup"))
+    {
+        std::vector<P4PipelineInput> inputs;
+        for (uint32_t seqN = 0; seqN <= UINT16_MAX; seqN++)
+        {
+            Ptr<Packet> packet = AddEthernet(MakeLiveLivePacket(payloadSize, seqN));
+            inputs.push_back({packet, 2});
+            inputs.push_back({packet, 3});
+        }
+        results.push_back(
+            RunPipeline("dedup",
+                        liveliveJson,
+                        caseCommands("table_add srv6_function srv6_ll_deduplicate 85 =>\n"
+                                     "table_add ipv6_forward forward 2002::/64 => 1 0x000000000001"),
+                        inputs,
+                        packets,
+                        warmup,
+                        batch));
+    }
+
+    if (selected("device"))
+    {
+        results.push_back(RunDevice(forwardJson,
+                                    forwardCommands,
+                                    MakeLiveLivePacket(payloadSize, 1),
+                                    packets,
+                                    interval));
+    }
+
+    if (results.empty())
+    {
+        NS_FATAL_ERROR("Unknown case " << benchCase);
+    }
+
+    std::ostringstream json;
+    json << "{\"benchmark\": \"p4-pipeline\", \"batch\": " << batch << ", \"results\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& r = results[i];
+        std::cout << "case=" << r.name << " packets=" << r.packets << " outputs=" << r.outputs
+                  << " size=" << r.size << " elapsed_s=" << r.elapsed
+                  << " pps=" << r.packets / r.elapsed
+                  << " ns_per_pkt=" << r.elapsed * 1e9 / r.packets << std::endl;
+
+        json << (i > 0 ? ", " : "") << "{\"case\": \"" << r.name << "\", \"packets\": " << r.packets
+             << ", \"outputs\": " << r.outputs << ", \"size\": " << r.size
+             << ", \"elapsed_s\": " << r.elapsed << ", \"pps\": " << r.packets / r.elapsed
+             << ", \"ns_per_pkt\": " << r.elapsed * 1e9 / r.packets << "}";
+    }
+    json << "]}";
+
+    if (!output.empty())
+    {
+        std::ofstream file(output);
+        file << json.str() << std::endl;
+        if (!file)
+        {
+            NS_FATAL_ERROR("Cannot write " << output);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+#ifndef LIVE_LIVE_HELPER_H
+#define LIVE_LIVE_HELPER_H
+
+#include "ns3/net-device-container.h"
+#include "ns3/object-factory.h"
+#include <string>
+
+namespace ns3 {
+
+class Node;
+class AttributeValue;
+
+/**
+ * \ingroup p4-switch
+ * \brief Create native Live-Live switches, as P4SwitchHelper does for P4 switches
+ *
+ * The devices take the same PipelineCommands as a P4SwitchNetDevice running
+ * srv6_livelive.p4, so the two helpers can be swapped in a scenario.
+ */
+class LiveLiveHelper
+{
+public:
+  /*
+   * Construct a LiveLiveHelper
+   */
+  LiveLiveHelper ();
+  /**
+   * Set an attribute on each ns3::LiveLiveNetDevice created by
+   * LiveLiveHelper::Install
+   *
+   * \param n1 the name of the attribute to set
+   * \param v1 the value of the attribute to set
+   */
+  void SetDeviceAttribute (std::string n1, const AttributeValue &v1);
+  /**
+   * This method creates an ns3::LiveLiveNetDevice with the attributes
+   * configured by LiveLiveHelper::SetDeviceAttribute, adds the device
+   * to the node, and attaches the given NetDevices as ports of the
+   * bridge.
+   *
+   * \param node The node to install the device in
+   * \param c Container of NetDevices to add as bridge ports
+   * \returns A container holding the added net device.
+   */
+  NetDeviceContainer Install (Ptr<Node> node, NetDeviceContainer c);
+  /**
+   * This method creates an ns3::LiveLiveNetDevice with the attributes
+   * configured by LiveLiveHelper::SetDeviceAttribute, adds the device
+   * to the node, and attaches the given NetDevices as ports of the
+   * bridge.
+   *
+   * \param nodeName The name of the node to install the device in
+   * \param c Container of NetDevices to add as bridge ports
+   * \returns A container holding the added net device.
+   */
+  NetDeviceContainer Install (std::string nodeName, NetDeviceContainer c);
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by the ns3::LiveLiveNetDevice devices of a container.
+   *
+   * \param c Container of the devices created by LiveLiveHelper::Install
+   * \param stream First stream index to use
+   * \returns The number of stream indices assigned
+   */
+  int64_t AssignStreams (NetDeviceContainer c, int64_t stream);
+
+private:
+  ObjectFactory m_deviceFactory; //!< Object factory
+};
+
+} // namespace ns3
+
+#endif /* LIVE_LIVE_HELPER_H */
@@ -0,0 +1,221 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "ipv6-segment-routing-header.h"
+
+#include "ns3/address-utils.h"
+#include "ns3/log.h"
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::Ipv6SegmentRoutingHeader implementation.
+ */
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("Ipv6SegmentRoutingHeader");
+
+NS_OBJECT_ENSURE_REGISTERED(Ipv6SegmentRoutingHeader);
+
+TypeId
+Ipv6SegmentRoutingHeader::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::Ipv6SegmentRoutingHeader")
+                            .SetParent<Header>()
+                            .SetGroupName("P4Switch")
+                            .AddConstructor<Ipv6SegmentRoutingHeader>();
+    return tid;
+}
+
+TypeId
+Ipv6SegmentRoutingHeader::GetInstanceTypeId() const
+{
+    return GetTypeId();
+}
+
+Ipv6SegmentRoutingHeader::Ipv6SegmentRoutingHeader()
+    : m_nextHeader(0),
+      m_hdrExtLen(0),
+      m_routingType(4),
+      m_segmentsLeft(0),
+      m_flags(0),
+      m_tag(0)
+{
+}
+
+Ipv6SegmentRoutingHeader::~Ipv6SegmentRoutingHeader()
+{
+}
+
+void
+Ipv6SegmentRoutingHeader::SetNextHeader(uint8_t nextHeader)
+{
+    m_nextHeader = nextHeader;
+}
+
+uint8_t
+Ipv6SegmentRoutingHeader::GetNextHeader() const
+{
+    return m_nextHeader;
+}
+
+void
+Ipv6SegmentRoutingHeader::SetHdrExtLen(uint8_t hdrExtLen)
+{
+    m_hdrExtLen = hdrExtLen;
+}
+
+uint8_t
+Ipv6SegmentRoutingHeader::GetHdrExtLen() const
+{
+    return m_hdrExtLen;
+}
+
+void
+Ipv6SegmentRoutingHeader::SetRoutingType(uint8_t routingType)
+{
+    m_routingType = routingType;
+}
+
+uint8_t
+Ipv6SegmentRoutingHeader::GetRoutingType() const
+{
+    return m_routingType;
+}
+
+void
+Ipv6SegmentRoutingHeader::SetSegmentsLeft(uint8_t segmentsLeft)
+{
+    m_segmentsLeft = segmentsLeft;
+}
+
+uint8_t
+Ipv6SegmentRoutingHeader::GetSegmentsLeft() const
+{
+    return m_segmentsLeft;
+}
+
+void
+Ipv6SegmentRoutingHeader::SetFlags(uint8_t flags)
+{
+    m_flags = flags;
+}
+
+uint8_t
+Ipv6SegmentRoutingHeader::GetFlags() const
+{
+    return m_flags;
+}
+
+void
+Ipv6SegmentRoutingHeader::SetTag(uint16_t tag)
+{
+    m_tag = tag;
+}
+
+uint16_t
+Ipv6SegmentRoutingHeader::GetTag() const
+{
+    return m_tag;
+}
+
+void
+Ipv6SegmentRoutingHeader::SetSegments(const std::vector<Ipv6Address>& segments)
+{
+    NS_ASSERT_MSG(!segments.empty() && segments.size() <= 256, "Invalid segment list size");
+    m_segments = segments;
+}
+
+const std::vector<Ipv6Address>&
+Ipv6SegmentRoutingHeader::GetSegments() const
+{
+    return m_segments;
+}
+
+Ipv6Address
+Ipv6SegmentRoutingHeader::GetActiveSegment() const
+{
+    if (m_segmentsLeft >= m_segments.size())
+    {
+        return Ipv6Address::GetAny();
+    }
+    return m_segments[m_segmentsLeft];
+}
+
+void
+Ipv6SegmentRoutingHeader::Print(std::ostream& os) const
+{
+    os << "next header=" << (uint32_t)m_nextHeader << ", hdr ext len=" << (uint32_t)m_hdrExtLen
+       << ", routing type=" << (uint32_t)m_routingType
+       << ", segments left=" << (uint32_t)m_segmentsLeft << ", flags=" << (uint32_t)m_flags
+       << ", tag=" << m_tag << ", segments=(";
+    for (size_t i = 0; i < m_segments.size(); i++)
+    {
+        os << (i ? " " : "") << m_segments[i];
+    }
+    os << ")";
+}
+
+uint32_t
+Ipv6SegmentRoutingHeader::GetSerializedSize() const
+{
+    return 8 + 16 * m_segments.size();
+}
+
+void
+Ipv6SegmentRoutingHeader::Serialize(Buffer::Iterator start) const
+{
+    Buffer::Iterator i = start;
+
+    i.WriteU8(m_nextHeader);
+    i.WriteU8(m_hdrExtLen);
+    i.WriteU8(m_routingType);
+    i.WriteU8(m_segmentsLeft);
+    i.WriteU8(m_segments.empty() ? 0 : m_segments.size() - 1);
+    i.WriteU8(m_flags);
+    i.WriteHtonU16(m_tag);
+
+    for (const auto& segment : m_segments)
+    {
+        WriteTo(i, segment);
+    }
+}
+
+uint32_t
+Ipv6SegmentRoutingHeader::Deserialize(Buffer::Iterator start)
+{
+    Buffer::Iterator i = start;
+
+    m_nextHeader = i.ReadU8();
+    m_hdrExtLen = i.ReadU8();
+    m_routingType = i.ReadU8();
+    m_segmentsLeft = i.ReadU8();
+    uint32_t lastEntry = i.ReadU8();
+    m_flags = i.ReadU8();
+    m_tag = i.ReadNtohU16();
+
+    m_segments.resize(lastEntry + 1);
+    for (auto& segment : m_segments)
+    {
+        ReadFrom(i, segment);
+    }
+
+    return GetSerializedSize();
+}
+
+} // namespace ns3
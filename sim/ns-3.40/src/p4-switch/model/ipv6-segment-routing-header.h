@@ -0,0 +1,99 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef IPV6_SEGMENT_ROUTING_HEADER_H
+#define IPV6_SEGMENT_ROUTING_HEADER_H
+
+#include "ns3/header.h"
+#include "ns3/ipv6-address.h"
+
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::Ipv6SegmentRoutingHeader declaration.
+ */
+
+namespace ns3
+{
+
+/**
+ * \ingroup p4-switch
+ * \brief IPv6 Segment Routing Header (routing type 4, RFC 8754)
+ *
+ * Fixed part and segment list of the SRH, as emitted by the srv6_h and srv6_list_h
+ * headers of the SRv6 P4 programs. The number of segments is given by the Last Entry
+ * field. TLVs are not part of this header, as the P4 programs do not account for them
+ * in Hdr Ext Len.
+ */
+class Ipv6SegmentRoutingHeader : public Header
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+    TypeId GetInstanceTypeId() const override;
+
+    Ipv6SegmentRoutingHeader();
+    ~Ipv6SegmentRoutingHeader() override;
+
+    void SetNextHeader(uint8_t nextHeader);
+    uint8_t GetNextHeader() const;
+    void SetHdrExtLen(uint8_t hdrExtLen);
+    uint8_t GetHdrExtLen() const;
+    void SetRoutingType(uint8_t routingType);
+    uint8_t GetRoutingType() const;
+    void SetSegmentsLeft(uint8_t segmentsLeft);
+    uint8_t GetSegmentsLeft() const;
+    void SetFlags(uint8_t flags);
+    uint8_t GetFlags() const;
+    void SetTag(uint16_t tag);
+    uint16_t GetTag() const;
+
+    /**
+     * \brief Set the segment list, the Last Entry field is derived from it
+     * \param segments the segments, in wire order
+     */
+    void SetSegments(const std::vector<Ipv6Address>& segments);
+    const std::vector<Ipv6Address>& GetSegments() const;
+
+    /**
+     * \return the active segment, i.e. the one indexed by Segments Left
+     */
+    Ipv6Address GetActiveSegment() const;
+
+    void Print(std::ostream& os) const override;
+    uint32_t GetSerializedSize() const override;
+    void Serialize(Buffer::Iterator start) const override;
+    uint32_t Deserialize(Buffer::Iterator start) override;
+
+  private:
+    uint8_t m_nextHeader;                //!< Next Header
+    uint8_t m_hdrExtLen;                 //!< Hdr Ext Len, in 8-octet units
+    uint8_t m_routingType;               //!< Routing Type
+    uint8_t m_segmentsLeft;              //!< Segments Left
+    uint8_t m_flags;                     //!< Flags
+    uint16_t m_tag;                      //!< Tag
+    std::vector<Ipv6Address> m_segments; //!< Segment list
+};
+
+} // namespace ns3
+
+#endif /* IPV6_SEGMENT_ROUTING_HEADER_H */
@@ -0,0 +1,1778 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "live-live-net-device.h"
+
+#include "ns3/channel.h"
+#include "ns3/ethernet-header.h"
+#include "ns3/log.h"
+#include "ns3/names.h"
+#include "ns3/node.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::LiveLiveNetDevice implementation.
+ */
+
+namespace
+{
+
+// Header sizes and constants of srv6_livelive.p4 (headers.p4, defines.p4)
+const size_t BRIDGE_LEN = 6;
+const size_t ETHERNET_LEN = 14;
+const size_t IPV6_LEN = 40;
+const size_t SRV6_LEN = 8;
+const size_t SEGMENT_LEN = 16;
+const size_t TLV_LEN = 8;
+const size_t TCP_LEN = 20;
+const size_t UDP_LEN = 8;
+const size_t META_LEN = 2;
+const uint32_t MAX_SEGMENTS = 10;
+const size_t MAX_HEADERS_LEN = BRIDGE_LEN + ETHERNET_LEN + IPV6_LEN + SRV6_LEN +
+                               MAX_SEGMENTS * SEGMENT_LEN + TLV_LEN + IPV6_LEN + TCP_LEN +
+                               UDP_LEN + META_LEN;
+
+const uint16_t ETHERTYPE_IPV6 = 0x86dd;
+const uint8_t PROTO_TCP = 6;
+const uint8_t PROTO_UDP = 17;
+const uint8_t PROTO_SRV6 = 43;
+const uint8_t PROTO_IPV6 = 41;
+
+const uint16_t DROP_PORT = 511;                   //!< egress_spec of mark_to_drop
+const uint64_t TIMESTAMP_MASK = (1ULL << 48) - 1; //!< ingress_global_timestamp is 48 bits
+
+uint16_t
+GetU16(const uint8_t* buf)
+{
+    return (buf[0] << 8) | buf[1];
+}
+
+void
+SetU16(uint8_t* buf, uint16_t value)
+{
+    buf[0] = value >> 8;
+    buf[1] = value & 0xff;
+}
+
+uint32_t
+GetU32(const uint8_t* buf)
+{
+    return (static_cast<uint32_t>(GetU16(buf)) << 16) | GetU16(buf + 2);
+}
+
+void
+SetU32(uint8_t* buf, uint32_t value)
+{
+    SetU16(buf, value >> 16);
+    SetU16(buf + 2, value & 0xffff);
+}
+
+/**
+ * Whether a table or action name given to the CLI refers to a P4 name, either in full or as
+ * a dot-separated suffix (e.g. "IngressPipe.ipv6_forward" or "ipv6_forward").
+ */
+bool
+MatchesName(const std::string& given, const std::string& name)
+{
+    return given == name ||
+           (given.size() > name.size() && given[given.size() - name.size() - 1] == '.' &&
+            given.compare(given.size() - name.size(), name.size(), name) == 0);
+}
+
+bool
+ParseUint(const std::string& str, uint64_t& value)
+{
+    if (str.empty())
+    {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoull(str.c_str(), &end, 0);
+    return *end == '\0';
+}
+
+/**
+ * Parse a value of at most 64 bits, checking that it fits its bit width.
+ */
+bool
+ParseBits(const std::string& str, uint32_t bitwidth, uint64_t& value)
+{
+    return ParseUint(str, value) && (bitwidth >= 64 || value < (1ULL << bitwidth));
+}
+
+/**
+ * Parse a 128-bit value, given as an IPv6 address or as an integer.
+ */
+bool
+ParseIpv6(const std::string& str, ns3::Ipv6Address& addr)
+{
+    uint8_t buf[16];
+    if (inet_pton(AF_INET6, str.c_str(), buf) != 1)
+    {
+        uint64_t value;
+        if (!ParseUint(str, value))
+        {
+            return false;
+        }
+        std::memset(buf, 0, 8);
+        for (int i = 15; i >= 8; i--, value >>= 8)
+        {
+            buf[i] = value & 0xff;
+        }
+    }
+    addr = ns3::Ipv6Address::Deserialize(buf);
+    return true;
+}
+
+/**
+ * Parse a 48-bit value, given as a MAC address or as an integer.
+ */
+bool
+ParseMac(const std::string& str, uint8_t mac[6])
+{
+    unsigned int bytes[6];
+    char end;
+    if (std::sscanf(str.c_str(),
+                    "%2x:%2x:%2x:%2x:%2x:%2x%c",
+                    &bytes[0],
+                    &bytes[1],
+                    &bytes[2],
+                    &bytes[3],
+                    &bytes[4],
+                    &bytes[5],
+                    &end) == 6)
+    {
+        std::copy(bytes, bytes + 6, mac);
+        return true;
+    }
+
+    uint64_t value;
+    if (!ParseBits(str, 48, value))
+    {
+        return false;
+    }
+    for (int i = 5; i >= 0; i--, value >>= 8)
+    {
+        mac[i] = value & 0xff;
+    }
+    return true;
+}
+
+/**
+ * Parse an LPM key, as address/length.
+ */
+bool
+ParseLpmKey(const std::string& str, ns3::Ipv6Address& prefix, ns3::Ipv6Prefix& mask)
+{
+    size_t slash = str.find('/');
+    uint64_t length;
+    if (slash == std::string::npos || !ParseIpv6(str.substr(0, slash), prefix) ||
+        !ParseUint(str.substr(slash + 1), length) || length > 128)
+    {
+        return false;
+    }
+    mask = ns3::Ipv6Prefix(static_cast<uint8_t>(length));
+    prefix = prefix.CombinePrefix(mask);
+    return true;
+}
+
+/**
+ * Insert an LPM entry, keeping the longest prefixes first so that the first match wins.
+ * \return false if the prefix is already in the table
+ */
+template <typename Entry>
+bool
+InsertLpmEntry(std::vector<Entry>& entries, const Entry& entry)
+{
+    auto it = entries.begin();
+    for (; it != entries.end(); it++)
+    {
+        if (it->mask.GetPrefixLength() == entry.mask.GetPrefixLength() &&
+            it->prefix == entry.prefix)
+        {
+            return false;
+        }
+        if (it->mask.GetPrefixLength() < entry.mask.GetPrefixLength())
+        {
+            break;
+        }
+    }
+    entries.insert(it, entry);
+    return true;
+}
+
+template <typename Entry>
+const Entry*
+LookupLpm(const std::vector<Entry>& entries, const uint8_t* addr)
+{
+    ns3::Ipv6Address key = ns3::Ipv6Address::Deserialize(addr);
+    for (const auto& entry : entries)
+    {
+        if (entry.mask.IsMatch(entry.prefix, key))
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("LiveLiveNetDevice");
+
+NS_OBJECT_ENSURE_REGISTERED(LiveLiveNetDevice);
+
+/**
+ * Headers of srv6_livelive.p4, in deparser order, as raw bytes in network order. Header
+ * stacks only hold valid elements at their front, so the segment list is kept as a count.
+ */
+struct LiveLiveNetDevice::Headers
+{
+    bool bridge;                                 //!< bridge valid
+    uint16_t bridgeSeqN;                         //!< bridge.seq_n
+    uint32_t bridgeFlowId;                       //!< bridge.flow_id
+    uint8_t ethernet[ETHERNET_LEN];              //!< ethernet
+    bool ipv6;                                   //!< ipv6 valid
+    uint8_t ipv6Hdr[IPV6_LEN];                   //!< ipv6
+    bool srv6;                                   //!< srv6 valid
+    uint8_t srv6Hdr[SRV6_LEN];                   //!< srv6
+    uint32_t nSegments;                          //!< Valid elements of srv6_list
+    uint8_t segments[MAX_SEGMENTS][SEGMENT_LEN]; //!< srv6_list
+    bool tlv;                                    //!< srv6_ll_tlv valid
+    uint8_t tlvHdr[TLV_LEN];                     //!< srv6_ll_tlv
+    bool inner;                                  //!< ipv6_inner valid
+    uint8_t innerHdr[IPV6_LEN];                  //!< ipv6_inner
+    bool tcp;                                    //!< tcp valid, options stay in the payload
+    uint8_t tcpHdr[TCP_LEN];                     //!< tcp
+    bool udp;                                    //!< udp valid
+    uint8_t udpHdr[UDP_LEN];                     //!< udp
+    bool meta;                                   //!< meta valid
+    uint8_t metaHdr[META_LEN];                   //!< meta
+    uint16_t l4SrcPort;                          //!< meta.l4_lookup.src_port
+    uint16_t l4DstPort;                          //!< meta.l4_lookup.dst_port
+    size_t parsedLen;                            //!< Bytes extracted by the parser
+};
+
+TypeId
+LiveLiveNetDevice::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::LiveLiveNetDevice")
+            .SetParent<NetDevice>()
+            .SetGroupName("P4Switch")
+            .AddConstructor<LiveLiveNetDevice>()
+            .AddAttribute(
+                "Mtu",
+                "The MAC-level Maximum Transmission Unit",
+                UintegerValue(1500),
+                MakeUintegerAccessor(&LiveLiveNetDevice::SetMtu, &LiveLiveNetDevice::GetMtu),
+                MakeUintegerChecker<uint16_t>())
+            .AddAttribute("PipelineCommands",
+                          "CLI commands to run before starting the simulation, the same as for "
+                          "a P4SwitchNetDevice running srv6_livelive.p4",
+                          StringValue(""),
+                          MakeStringAccessor(&LiveLiveNetDevice::GetPipelineCommands,
+                                             &LiveLiveNetDevice::SetPipelineCommands),
+                          MakeStringChecker())
+            .AddAttribute("FlowTableBits",
+                          "log2 of the number of flow table slots, as FLOW_TABLE_BITS",
+                          UintegerValue(10),
+                          MakeUintegerAccessor(&LiveLiveNetDevice::m_flow_table_bits),
+                          MakeUintegerChecker<uint32_t>(1, 24))
+            .AddAttribute("WindowWordBits",
+                          "log2 of the number of 64-bit words of the dedup window of each flow, "
+                          "as WINDOW_WORD_BITS",
+                          UintegerValue(4),
+                          MakeUintegerAccessor(&LiveLiveNetDevice::m_window_word_bits),
+                          MakeUintegerChecker<uint32_t>(0, 9))
+            .AddAttribute("PathPortBits",
+                          "log2 of the number of ports with per-path state (path_wins, "
+                          "path_dups, path_too_old, path_gap_ewma) in each flow slot, as "
+                          "PATH_PORT_BITS",
+                          UintegerValue(7),
+                          MakeUintegerAccessor(&LiveLiveNetDevice::m_path_port_bits),
+                          MakeUintegerChecker<uint32_t>(0, 9))
+            .AddAttribute("GapRingBits",
+                          "log2 of the sequence numbers of each flow whose first arrival time is "
+                          "kept to measure the second copy, as GAP_RING_BITS",
+                          UintegerValue(6),
+                          MakeUintegerAccessor(&LiveLiveNetDevice::m_gap_ring_bits),
+                          MakeUintegerChecker<uint32_t>(0, 16))
+            .AddAttribute("GapEwmaShift",
+                          "Weight of a new sample in the moving average of the arrival gap of "
+                          "the second copies, as 1 / 2^GAP_EWMA_SHIFT",
+                          UintegerValue(3),
+                          MakeUintegerAccessor(&LiveLiveNetDevice::m_gap_ewma_shift),
+                          MakeUintegerChecker<uint32_t>(0, 47))
+            .AddAttribute("FlowIdleTimeout",
+                          "Time without packets after which a flow table slot starts a new "
+                          "epoch on the spreader and can be taken by another flow on the merger, "
+                          "as FLOW_IDLE_TIMEOUT, which P4Pipeline compares to nanosecond "
+                          "timestamps",
+                          TimeValue(Seconds(1)),
+                          MakeTimeAccessor(&LiveLiveNetDevice::m_flow_idle_timeout),
+                          MakeTimeChecker());
+
+    return tid;
+}
+
+LiveLiveNetDevice::LiveLiveNetDevice()
+    : m_initialized(false),
+      m_node(nullptr),
+      m_ifIndex(0)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_channel = CreateObject<P4SwitchChannel>();
+    m_random = CreateObject<UniformRandomVariable>();
+    m_check_live_live_enabled_default =
+        {Ipv6Address::GetAny(), Ipv6Prefix(static_cast<uint8_t>(0)), ENCAP_FORWARD_RANDOM,
+         Ipv6Address::GetAny(), 0, 0, 0};
+    m_ipv6_forward_default = {Ipv6Address::GetAny(), Ipv6Prefix(static_cast<uint8_t>(0)), false,
+                              0, {0, 0, 0, 0, 0, 0}};
+}
+
+LiveLiveNetDevice::~LiveLiveNetDevice()
+{
+    NS_LOG_FUNCTION_NOARGS();
+}
+
+void
+LiveLiveNetDevice::DoDispose()
+{
+    NS_LOG_FUNCTION_NOARGS();
+    for (auto& port : m_ports)
+    {
+        port = nullptr;
+    }
+    m_ports.clear();
+    m_outputs.clear();
+    m_tags.clear();
+    m_channel = nullptr;
+    m_node = nullptr;
+    NetDevice::DoDispose();
+}
+
+void
+LiveLiveNetDevice::InitState()
+{
+    NS_LOG_FUNCTION_NOARGS();
+
+    m_node_name = m_node ? Names::FindName(m_node) : "";
+    m_initialized = true;
+
+    size_t slots = 1 << m_flow_table_bits;
+    size_t words = slots << m_window_word_bits;
+    size_t paths = slots << m_path_port_bits;
+    size_t ring = slots << m_gap_ring_bits;
+    m_seq_n.assign(slots, 0);
+    m_flow_epoch.assign(slots, 0);
+    m_flow_last_tx.assign(slots, 0);
+    m_flow_mcast_grp.assign(slots, 0);
+    m_flow_owner.assign(slots, 0);
+    m_flow_last_rx.assign(slots, 0);
+    m_flow_max_seq_n.assign(slots, 0);
+    m_flow_generation.assign(slots, 0);
+    m_flow_to_bitmap.assign(words, 0);
+    m_flow_word_block.assign(words, 0);
+    m_path_wins.assign(paths, 0);
+    m_path_dups.assign(paths, 0);
+    m_path_too_old.assign(paths, 0);
+    m_path_gap_ewma.assign(paths, 0);
+    m_first_rx_ts.assign(ring, 0);
+    m_first_rx_tag.assign(ring, 0);
+
+    if (!m_pipeline_commands.empty())
+    {
+        NS_LOG_DEBUG(m_node_name << " Running Live-Live commands:\n"
+                                 << m_pipeline_commands << "\n"
+                                 << RunPipelineCommands(m_pipeline_commands));
+    }
+}
+
+std::string
+LiveLiveNetDevice::RunPipelineCommands(std::string commands)
+{
+    if (!m_initialized)
+    {
+        InitState();
+    }
+
+    std::ostringstream out;
+    std::istringstream lines(commands);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        RunPipelineCommand(line, out);
+    }
+    return out.str();
+}
+
+void
+LiveLiveNetDevice::RunPipelineCommand(const std::string& line, std::ostream& out)
+{
+    std::vector<std::string> args;
+    std::istringstream iss(line);
+    std::string token;
+    while (iss >> token)
+    {
+        args.push_back(token);
+    }
+    if (args.empty() || args[0][0] == '#')
+    {
+        return;
+    }
+
+    std::string cmd = args[0];
+    args.erase(args.begin());
+
+    if ((cmd == "table_add" || cmd == "table_set_default") && args.size() >= 2)
+    {
+        bool isDefault = (cmd == "table_set_default");
+        std::vector<std::string> key;
+        std::vector<std::string> params;
+        if (isDefault)
+        {
+            params.assign(args.begin() + 2, args.end());
+            out << "Setting default action of " << args[0] << std::endl;
+        }
+        else
+        {
+            auto sep = std::find(args.begin() + 2, args.end(), "=>");
+            key.assign(args.begin() + 2, sep);
+            if (sep != args.end())
+            {
+                params.assign(sep + 1, args.end());
+            }
+            out << "Adding entry to table " << args[0] << std::endl;
+        }
+
+        uint32_t handle = 0;
+        std::string error = AddTableEntry(args[0], args[1], key, params, isDefault, handle);
+        if (!error.empty())
+        {
+            out << "Invalid table operation (" << error << ")" << std::endl;
+        }
+        else if (!isDefault)
+        {
+            out << "Entry has been added with handle " << handle << std::endl;
+        }
+    }
+    else if (cmd == "mc_mgrp_create" && args.size() == 1)
+    {
+        uint64_t mgid;
+        out << "Creating multicast group " << args[0] << std::endl;
+        if (!ParseBits(args[0], 16, mgid) || m_mc_groups.count(mgid))
+        {
+            out << "Invalid PRE operation" << std::endl;
+            return;
+        }
+        m_mc_groups[mgid];
+    }
+    else if (cmd == "mc_node_create" && args.size() >= 1)
+    {
+        // Ports after a "|" are LAG indexes, LAGs are not supported
+        uint64_t rid;
+        McNode node;
+        bool valid = ParseBits(args[0], 16, rid);
+        for (auto it = args.begin() + 1; valid && it != args.end() && *it != "|"; it++)
+        {
+            uint64_t port;
+            valid = ParseBits(*it, 9, port);
+            node.ports.push_back(port);
+        }
+
+        out << "Creating node with rid " << args[0] << std::endl;
+        if (!valid)
+        {
+            out << "Invalid PRE operation" << std::endl;
+            return;
+        }
+        // Replicas follow the port bitmap of the node, in increasing port order
+        std::sort(node.ports.begin(), node.ports.end());
+        node.ports.erase(std::unique(node.ports.begin(), node.ports.end()), node.ports.end());
+        node.rid = rid;
+        node.associated = false;
+        m_mc_nodes.push_back(node);
+        out << "node was created with handle " << m_mc_nodes.size() - 1 << std::endl;
+    }
+    else if (cmd == "mc_node_update" && args.size() >= 1)
+    {
+        uint64_t handle;
+        std::vector<uint16_t> ports;
+        bool valid = ParseUint(args[0], handle) && handle < m_mc_nodes.size();
+        for (auto it = args.begin() + 1; valid && it != args.end() && *it != "|"; it++)
+        {
+            uint64_t port;
+            valid = ParseBits(*it, 9, port);
+            ports.push_back(port);
+        }
+
+        out << "Updating node " << args[0] << std::endl;
+        if (!valid)
+        {
+            out << "Invalid PRE operation" << std::endl;
+            return;
+        }
+        std::sort(ports.begin(), ports.end());
+        ports.erase(std::unique(ports.begin(), ports.end()), ports.end());
+        m_mc_nodes[handle].ports = ports;
+    }
+    else if (cmd == "mc_node_associate" && args.size() == 2)
+    {
+        uint64_t mgid;
+        uint64_t handle;
+        out << "Associating node " << args[1] << " to multicast group " << args[0] << std::endl;
+        if (!ParseUint(args[0], mgid) || !ParseUint(args[1], handle) ||
+            !m_mc_groups.count(mgid) || handle >= m_mc_nodes.size() ||
+            m_mc_nodes[handle].associated)
+        {
+            out << "Invalid PRE operation" << std::endl;
+            return;
+        }
+        m_mc_nodes[handle].associated = true;
+        m_mc_groups[mgid].push_back(handle);
+    }
+    else if (cmd == "register_read" && (args.size() == 1 || args.size() == 2))
+    {
+        RegisterRef reg;
+        if (!GetRegister(args[0], reg))
+        {
+            out << "Error: Unknown register array " << args[0] << std::endl;
+            return;
+        }
+
+        uint64_t first = 0;
+        uint64_t last = reg.size;
+        if (args.size() == 2)
+        {
+            if (!ParseUint(args[1], first))
+            {
+                out << "Error: Bad format for index " << args[1] << std::endl;
+                return;
+            }
+            last = first + 1;
+        }
+
+        out << reg.name;
+        if (args.size() == 2)
+        {
+            out << "[" << first << "]";
+        }
+        out << "=";
+        for (uint64_t i = first; i < last; i++)
+        {
+            uint64_t value;
+            if (!RegisterRead(reg.name, i, value))
+            {
+                out << std::endl << "Invalid register operation" << std::endl;
+                return;
+            }
+            out << ((i == first) ? " " : ", ") << value;
+        }
+        out << std::endl;
+    }
+    else if (cmd == "register_write" && args.size() == 3)
+    {
+        uint64_t index;
+        uint64_t value;
+        if (!ParseUint(args[1], index) || !ParseUint(args[2], value) ||
+            !RegisterWrite(args[0], index, value))
+        {
+            out << "Invalid register operation" << std::endl;
+        }
+    }
+    else
+    {
+        out << "*** Unknown syntax: " << line << std::endl;
+    }
+}
+
+bool
+LiveLiveNetDevice::GetRegister(const std::string& name, RegisterRef& reg)
+{
+    const RegisterRef registers[] = {
+        {"IngressPipe.seq_n", 16, m_seq_n.data(), m_seq_n.size(), sizeof(uint16_t)},
+        {"IngressPipe.flow_epoch", 8, m_flow_epoch.data(), m_flow_epoch.size(), sizeof(uint8_t)},
+        {"IngressPipe.flow_last_tx",
+         48,
+         m_flow_last_tx.data(),
+         m_flow_last_tx.size(),
+         sizeof(uint64_t)},
+        {"IngressPipe.flow_mcast_grp",
+         16,
+         m_flow_mcast_grp.data(),
+         m_flow_mcast_grp.size(),
+         sizeof(uint16_t)},
+        {"IngressPipe.flow_owner", 32, m_flow_owner.data(), m_flow_owner.size(), sizeof(uint32_t)},
+        {"IngressPipe.flow_last_rx",
+         48,
+         m_flow_last_rx.data(),
+         m_flow_last_rx.size(),
+         sizeof(uint64_t)},
+        {"IngressPipe.flow_max_seq_n",
+         16,
+         m_flow_max_seq_n.data(),
+         m_flow_max_seq_n.size(),
+         sizeof(uint16_t)},
+        {"IngressPipe.flow_generation",
+         8,
+         m_flow_generation.data(),
+         m_flow_generation.size(),
+         sizeof(uint8_t)},
+        {"IngressPipe.flow_to_bitmap",
+         64,
+         m_flow_to_bitmap.data(),
+         m_flow_to_bitmap.size(),
+         sizeof(uint64_t)},
+        {"IngressPipe.flow_word_block",
+         32,
+         m_flow_word_block.data(),
+         m_flow_word_block.size(),
+         sizeof(uint32_t)},
+        {"IngressPipe.path_wins", 32, m_path_wins.data(), m_path_wins.size(), sizeof(uint32_t)},
+        {"IngressPipe.path_dups", 32, m_path_dups.data(), m_path_dups.size(), sizeof(uint32_t)},
+        {"IngressPipe.path_too_old",
+         32,
+         m_path_too_old.data(),
+         m_path_too_old.size(),
+         sizeof(uint32_t)},
+        {"IngressPipe.path_gap_ewma",
+         48,
+         m_path_gap_ewma.data(),
+         m_path_gap_ewma.size(),
+         sizeof(uint64_t)},
+        {"IngressPipe.first_rx_ts",
+         48,
+         m_first_rx_ts.data(),
+         m_first_rx_ts.size(),
+         sizeof(uint64_t)},
+        {"IngressPipe.first_rx_tag",
+         32,
+         m_first_rx_tag.data(),
+         m_first_rx_tag.size(),
+         sizeof(uint32_t)},
+    };
+
+    for (const auto& candidate : registers)
+    {
+        // The name can be abbreviated to a dot-separated suffix, as in P4Pipeline
+        if (MatchesName(candidate.name, name))
+        {
+            reg = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+LiveLiveNetDevice::RegisterRead(const std::string& name, uint32_t index, uint64_t& value)
+{
+    if (!m_initialized)
+    {
+        InitState();
+    }
+
+    RegisterRef reg;
+    if (!GetRegister(name, reg) || index >= reg.size)
+    {
+        return false;
+    }
+    void* cell = static_cast<uint8_t*>(reg.data) + index * reg.cellSize;
+    switch (reg.cellSize)
+    {
+    case sizeof(uint8_t):
+        value = *static_cast<uint8_t*>(cell);
+        break;
+    case sizeof(uint16_t):
+        value = *static_cast<uint16_t*>(cell);
+        break;
+    case sizeof(uint32_t):
+        value = *static_cast<uint32_t*>(cell);
+        break;
+    default:
+        value = *static_cast<uint64_t*>(cell);
+        break;
+    }
+    return true;
+}
+
+bool
+LiveLiveNetDevice::RegisterWrite(const std::string& name, uint32_t index, uint64_t value)
+{
+    if (!m_initialized)
+    {
+        InitState();
+    }
+
+    RegisterRef reg;
+    if (!GetRegister(name, reg) || index >= reg.size)
+    {
+        return false;
+    }
+    if (reg.bitwidth < 64)
+    {
+        value &= (1ULL << reg.bitwidth) - 1;
+    }
+    void* cell = static_cast<uint8_t*>(reg.data) + index * reg.cellSize;
+    switch (reg.cellSize)
+    {
+    case sizeof(uint8_t):
+        *static_cast<uint8_t*>(cell) = value;
+        break;
+    case sizeof(uint16_t):
+        *static_cast<uint16_t*>(cell) = value;
+        break;
+    case sizeof(uint32_t):
+        *static_cast<uint32_t*>(cell) = value;
+        break;
+    default:
+        *static_cast<uint64_t*>(cell) = value;
+        break;
+    }
+    return true;
+}
+
+std::string
+LiveLiveNetDevice::AddTableEntry(const std::string& table,
+                                 const std::string& action,
+                                 const std::vector<std::string>& key,
+                                 const std::vector<std::string>& params,
+                                 bool isDefault,
+                                 uint32_t& handle)
+{
+    if (!isDefault && key.size() != 1)
+    {
+        return "BAD_MATCH_KEY";
+    }
+
+    if (MatchesName(table, "check_live_live_enabled"))
+    {
+        SpreaderEntry entry = m_check_live_live_enabled_default;
+        uint64_t port = 0;
+        uint64_t portHi = 0;
+        uint64_t group = 0;
+        bool valid;
+        if (MatchesName(action, "ipv6_encap_forward_random"))
+        {
+            entry.action = ENCAP_FORWARD_RANDOM;
+            valid = params.size() == 3 && ParseIpv6(params[0], entry.srcAddr) &&
+                    ParseBits(params[1], 9, port) && ParseBits(params[2], 9, portHi);
+        }
+        else if (MatchesName(action, "ipv6_encap_forward_port"))
+        {
+            entry.action = ENCAP_FORWARD_PORT;
+            valid = params.size() == 2 && ParseIpv6(params[0], entry.srcAddr) &&
+                    ParseBits(params[1], 9, port);
+        }
+        else if (MatchesName(action, "live_live_mcast"))
+        {
+            entry.action = LIVE_LIVE_MCAST;
+            valid = params.size() == 2 && ParseBits(params[0], 16, group) &&
+                    ParseIpv6(params[1], entry.srcAddr);
+        }
+        else
+        {
+            return "INVALID_ACTION_NAME";
+        }
+        if (!valid)
+        {
+            return "BAD_ACTION_DATA";
+        }
+        entry.port = port;
+        entry.portHi = portHi;
+        entry.mcastGroup = group;
+
+        if (isDefault)
+        {
+            m_check_live_live_enabled_default = entry;
+            return "";
+        }
+        if (!ParseLpmKey(key[0], entry.prefix, entry.mask))
+        {
+            return "BAD_MATCH_KEY";
+        }
+        handle = m_check_live_live_enabled.size();
+        return InsertLpmEntry(m_check_live_live_enabled, entry) ? "" : "DUPLICATE_ENTRY";
+    }
+
+    if (MatchesName(table, "ipv6_forward"))
+    {
+        ForwardEntry entry = m_ipv6_forward_default;
+        entry.forward = MatchesName(action, "forward");
+        if (!entry.forward && !MatchesName(action, "NoAction"))
+        {
+            return "INVALID_ACTION_NAME";
+        }
+        uint64_t port = 0;
+        if (entry.forward ? params.size() != 2 || !ParseBits(params[0], 9, port) ||
+                                !ParseMac(params[1], entry.mac)
+                          : !params.empty())
+        {
+            return "BAD_ACTION_DATA";
+        }
+        entry.port = port;
+
+        if (isDefault)
+        {
+            m_ipv6_forward_default = entry;
+            return "";
+        }
+        if (!ParseLpmKey(key[0], entry.prefix, entry.mask))
+        {
+            return "BAD_MATCH_KEY";
+        }
+        handle = m_ipv6_forward.size();
+        return InsertLpmEntry(m_ipv6_forward, entry) ? "" : "DUPLICATE_ENTRY";
+    }
+
+    if (MatchesName(table, "srv6_function"))
+    {
+        bool deduplicate = MatchesName(action, "srv6_ll_deduplicate");
+        if (!deduplicate && !MatchesName(action, "NoAction"))
+        {
+            return "INVALID_ACTION_NAME";
+        }
+        if (!params.empty())
+        {
+            return "BAD_ACTION_DATA";
+        }
+        if (isDefault)
+        {
+            // The default action runs on a miss, where the P4 program does not deduplicate
+            return "";
+        }
+        uint64_t funcId;
+        if (!ParseUint(key[0], funcId))
+        {
+            return "BAD_MATCH_KEY";
+        }
+        handle = m_srv6_function.size();
+        return m_srv6_function.emplace(funcId, deduplicate).second ? "" : "DUPLICATE_ENTRY";
+    }
+
+    bool destSegment = MatchesName(table, "srv6_forward");
+    if (destSegment || MatchesName(table, "srv6_live_live_forward"))
+    {
+        if (isDefault)
+        {
+            // const default_action = NoAction
+            return "ERROR";
+        }
+        SegmentEntry entry{false, Ipv6Address::GetAny()};
+        entry.add = MatchesName(action,
+                                destSegment ? "add_srv6_dest_segment" : "add_srv6_ll_segment");
+        if (!entry.add && !MatchesName(action, "NoAction"))
+        {
+            return "INVALID_ACTION_NAME";
+        }
+        if (entry.add ? params.size() != 1 || !ParseIpv6(params[0], entry.segment)
+                      : !params.empty())
+        {
+            return "BAD_ACTION_DATA";
+        }
+        // Keyed by egress_port (9 bits) or egress_rid (16 bits)
+        uint64_t value;
+        if (!ParseBits(key[0], destSegment ? 9 : 16, value))
+        {
+            return "BAD_MATCH_KEY";
+        }
+        auto& entries = destSegment ? m_srv6_forward : m_srv6_live_live_forward;
+        handle = entries.size();
+        return entries.emplace(value, entry).second ? "" : "DUPLICATE_ENTRY";
+    }
+
+    return "INVALID_TABLE_NAME";
+}
+
+uint32_t
+LiveLiveNetDevice::Crc32(const uint8_t* data, size_t len)
+{
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t;
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffff;
+}
+
+bool
+LiveLiveNetDevice::Parse(const uint8_t* data, size_t len, Headers& hdr)
+{
+    // parse_ethernet
+    if (len < ETHERNET_LEN)
+    {
+        return false;
+    }
+    std::memcpy(hdr.ethernet, data, ETHERNET_LEN);
+    size_t pos = ETHERNET_LEN;
+    hdr.parsedLen = pos;
+    if (GetU16(data + 12) != ETHERTYPE_IPV6)
+    {
+        return true;
+    }
+
+    // parse_ipv6
+    if (len - pos < IPV6_LEN)
+    {
+        return false;
+    }
+    std::memcpy(hdr.ipv6Hdr, data + pos, IPV6_LEN);
+    hdr.ipv6 = true;
+    pos += IPV6_LEN;
+    uint8_t nextHdr = hdr.ipv6Hdr[6];
+
+    if (nextHdr == PROTO_SRV6)
+    {
+        // parse_srv6, parse_srv6_list up to last_entry, then the TLV if tagged
+        if (len - pos < SRV6_LEN)
+        {
+            return false;
+        }
+        std::memcpy(hdr.srv6Hdr, data + pos, SRV6_LEN);
+        hdr.srv6 = true;
+        pos += SRV6_LEN;
+
+        uint32_t nSegments = hdr.srv6Hdr[4] + 1;
+        if (nSegments > MAX_SEGMENTS || len - pos < nSegments * SEGMENT_LEN)
+        {
+            return false;
+        }
+        std::memcpy(hdr.segments, data + pos, nSegments * SEGMENT_LEN);
+        hdr.nSegments = nSegments;
+        pos += nSegments * SEGMENT_LEN;
+
+        uint16_t tag = GetU16(hdr.srv6Hdr + 6);
+        if (tag == 1)
+        {
+            if (len - pos < TLV_LEN)
+            {
+                return false;
+            }
+            std::memcpy(hdr.tlvHdr, data + pos, TLV_LEN);
+            hdr.tlv = true;
+            pos += TLV_LEN;
+        }
+        else if (tag != 0)
+        {
+            return false;
+        }
+        nextHdr = hdr.srv6Hdr[0];
+    }
+
+    if (nextHdr == PROTO_IPV6)
+    {
+        // parse_ipv6_inner
+        if (len - pos < IPV6_LEN)
+        {
+            return false;
+        }
+        std::memcpy(hdr.innerHdr, data + pos, IPV6_LEN);
+        hdr.inner = true;
+        pos += IPV6_LEN;
+        nextHdr = hdr.innerHdr[6];
+    }
+
+    if (nextHdr == PROTO_TCP)
+    {
+        // The options are emitted unchanged, they are left in the payload
+        if (len - pos < TCP_LEN)
+        {
+            return false;
+        }
+        std::memcpy(hdr.tcpHdr, data + pos, TCP_LEN);
+        hdr.tcp = true;
+        pos += TCP_LEN;
+        hdr.l4SrcPort = GetU16(hdr.tcpHdr);
+        hdr.l4DstPort = GetU16(hdr.tcpHdr + 2);
+    }
+    else if (nextHdr == PROTO_UDP)
+    {
+        if (len - pos < UDP_LEN)
+        {
+            return false;
+        }
+        std::memcpy(hdr.udpHdr, data + pos, UDP_LEN);
+        hdr.udp = true;
+        pos += UDP_LEN;
+        hdr.l4SrcPort = GetU16(hdr.udpHdr);
+        hdr.l4DstPort = GetU16(hdr.udpHdr + 2);
+
+        // parse_meta, the packet goes on without it when the payload is shorter
+        if (len - pos >= META_LEN)
+        {
+            std::memcpy(hdr.metaHdr, data + pos, META_LEN);
+            hdr.meta = true;
+            pos += META_LEN;
+        }
+    }
+
+    hdr.parsedLen = pos;
+    return true;
+}
+
+size_t
+LiveLiveNetDevice::Deparse(const Headers& hdr, uint8_t* out)
+{
+    size_t pos = 0;
+    if (hdr.bridge)
+    {
+        SetU16(out, hdr.bridgeSeqN);
+        SetU32(out + 2, hdr.bridgeFlowId);
+        pos += BRIDGE_LEN;
+    }
+    std::memcpy(out + pos, hdr.ethernet, ETHERNET_LEN);
+    pos += ETHERNET_LEN;
+    if (hdr.ipv6)
+    {
+        std::memcpy(out + pos, hdr.ipv6Hdr, IPV6_LEN);
+        pos += IPV6_LEN;
+    }
+    if (hdr.srv6)
+    {
+        std::memcpy(out + pos, hdr.srv6Hdr, SRV6_LEN);
+        pos += SRV6_LEN;
+    }
+    std::memcpy(out + pos, hdr.segments, hdr.nSegments * SEGMENT_LEN);
+    pos += hdr.nSegments * SEGMENT_LEN;
+    if (hdr.tlv)
+    {
+        std::memcpy(out + pos, hdr.tlvHdr, TLV_LEN);
+        pos += TLV_LEN;
+    }
+    if (hdr.inner)
+    {
+        std::memcpy(out + pos, hdr.innerHdr, IPV6_LEN);
+        pos += IPV6_LEN;
+    }
+    if (hdr.tcp)
+    {
+        std::memcpy(out + pos, hdr.tcpHdr, TCP_LEN);
+        pos += TCP_LEN;
+    }
+    if (hdr.udp)
+    {
+        std::memcpy(out + pos, hdr.udpHdr, UDP_LEN);
+        pos += UDP_LEN;
+    }
+    if (hdr.meta)
+    {
+        std::memcpy(out + pos, hdr.metaHdr, META_LEN);
+        pos += META_LEN;
+    }
+    return pos;
+}
+
+void
+LiveLiveNetDevice::Encapsulate(Headers& hdr, const Ipv6Address& srcAddr)
+{
+    // Original IPv6 header, all its fields are copied
+    std::memcpy(hdr.innerHdr, hdr.ipv6Hdr, IPV6_LEN);
+    hdr.innerHdr[0] = (6 << 4) | (hdr.innerHdr[0] & 0x0f);
+    hdr.inner = true;
+
+    SetU16(hdr.ipv6Hdr + 4, GetU16(hdr.ipv6Hdr + 4) + IPV6_LEN + SRV6_LEN);
+    hdr.ipv6Hdr[6] = PROTO_SRV6;
+    srcAddr.Serialize(hdr.ipv6Hdr + 8);
+
+    // setValid() zeroes the header, so hdr_ext_len starts from 0
+    std::memset(hdr.srv6Hdr, 0, SRV6_LEN);
+    hdr.srv6Hdr[0] = PROTO_IPV6;
+    hdr.srv6Hdr[2] = 0x4;
+    hdr.srv6 = true;
+}
+
+void
+LiveLiveNetDevice::PushSegment(Headers& hdr, const Ipv6Address& segment)
+{
+    // The last element is lost if the stack is full
+    uint32_t kept = std::min(hdr.nSegments, MAX_SEGMENTS - 1);
+    std::memmove(hdr.segments[1], hdr.segments[0], kept * SEGMENT_LEN);
+    segment.Serialize(hdr.segments[0]);
+    hdr.nSegments = kept + 1;
+}
+
+void
+LiveLiveNetDevice::Process(Ptr<const Packet> frame, uint32_t port_n, std::vector<Output>& outputs)
+{
+    NS_LOG_FUNCTION(this << frame << port_n);
+
+    if (!m_initialized)
+    {
+        InitState();
+    }
+
+    uint32_t size = frame->GetSize();
+    m_frame.resize(size);
+    frame->CopyData(m_frame.data(), size);
+
+    Headers hdr{};
+    if (!Parse(m_frame.data(), size, hdr))
+    {
+        NS_LOG_DEBUG(m_node_name << " Cannot parse frame from port " << port_n << ", dropping");
+        return;
+    }
+
+    uint64_t timestamp = Simulator::Now().GetNanoSeconds() & TIMESTAMP_MASK;
+    uint16_t egressSpec = 0;
+    uint16_t mcastGrp = 0;
+    Ingress(hdr, port_n, timestamp, egressSpec, mcastGrp);
+
+    const uint8_t* payload = m_frame.data() + hdr.parsedLen;
+    size_t payloadLen = size - hdr.parsedLen;
+    m_out_frame.resize(MAX_HEADERS_LEN + payloadLen);
+    if (mcastGrp != 0)
+    {
+        auto group = m_mc_groups.find(mcastGrp);
+        if (group == m_mc_groups.end())
+        {
+            return;
+        }
+        for (uint32_t handle : group->second)
+        {
+            const McNode& node = m_mc_nodes[handle];
+            for (uint16_t port : node.ports)
+            {
+                Headers replica = hdr;
+                Egress(replica, port, node.rid, payload, payloadLen, outputs);
+            }
+        }
+    }
+    else if (egressSpec != DROP_PORT)
+    {
+        Egress(hdr, egressSpec, 0, payload, payloadLen, outputs);
+    }
+}
+
+void
+LiveLiveNetDevice::Ingress(Headers& hdr,
+                           uint16_t ingressPort,
+                           uint64_t timestamp,
+                           uint16_t& egressSpec,
+                           uint16_t& mcastGrp)
+{
+    if (!hdr.ipv6)
+    {
+        egressSpec = DROP_PORT;
+        return;
+    }
+
+    if (!hdr.srv6)
+    {
+        if (!hdr.tcp && !hdr.udp && !hdr.inner)
+        {
+            egressSpec = DROP_PORT;
+            return;
+        }
+
+        const SpreaderEntry* entry = LookupLpm(m_check_live_live_enabled, hdr.ipv6Hdr + 8);
+        if (!entry)
+        {
+            entry = &m_check_live_live_enabled_default;
+        }
+        switch (entry->action)
+        {
+        case ENCAP_FORWARD_RANDOM:
+            egressSpec = entry->portHi > entry->port
+                             ? m_random->GetInteger(entry->port, entry->portHi)
+                             : entry->port;
+            Encapsulate(hdr, entry->srcAddr);
+            break;
+        case ENCAP_FORWARD_PORT:
+            egressSpec = entry->port;
+            Encapsulate(hdr, entry->srcAddr);
+            break;
+        case LIVE_LIVE_MCAST:
+            mcastGrp = entry->mcastGroup;
+            Encapsulate(hdr, entry->srcAddr);
+            SetU16(hdr.srv6Hdr + 6, 1);
+            hdr.bridge = true;
+            AssignFlowSeqN(hdr, timestamp, mcastGrp);
+            break;
+        }
+    }
+    else if (hdr.srv6Hdr[3] == 0)
+    {
+        // srv6_func_id is the lower half of the last segment, any entry is a hit
+        uint64_t funcId = 0;
+        for (size_t i = 8; i < SEGMENT_LEN; i++)
+        {
+            funcId = (funcId << 8) | hdr.segments[0][i];
+        }
+        if (m_srv6_function.count(funcId) && !Deduplicate(hdr, ingressPort, timestamp))
+        {
+            egressSpec = DROP_PORT;
+            return;
+        }
+        DecapForward(hdr, egressSpec);
+    }
+}
+
+void
+LiveLiveNetDevice::AssignFlowSeqN(Headers& hdr, uint64_t timestamp, uint16_t& mcastGrp)
+{
+    // hash(crc32, {ipv6_inner.src_addr, ipv6_inner.dst_addr, l4 ports, ipv6_inner.next_hdr})
+    uint8_t fields[37];
+    std::memcpy(fields, hdr.innerHdr + 8, 32);
+    SetU16(fields + 32, hdr.l4SrcPort);
+    SetU16(fields + 34, hdr.l4DstPort);
+    fields[36] = hdr.innerHdr[6];
+    uint32_t flowHash = Crc32(fields, sizeof(fields));
+    uint32_t flowIdx = flowHash & ((1U << m_flow_table_bits) - 1);
+
+    uint64_t timeout = m_flow_idle_timeout.GetNanoSeconds();
+    bool idle = ((timestamp - m_flow_last_tx[flowIdx]) & TIMESTAMP_MASK) > timeout;
+    if (idle)
+    {
+        m_flow_epoch[flowIdx]++;
+        m_seq_n[flowIdx] = 0;
+    }
+    m_flow_last_tx[flowIdx] = timestamp;
+
+    hdr.bridgeFlowId =
+        (static_cast<uint32_t>(m_flow_epoch[flowIdx]) << 24) | (flowHash & 0xffffff);
+    hdr.bridgeSeqN = ++m_seq_n[flowIdx];
+    if (m_flow_mcast_grp[flowIdx] != 0)
+    {
+        mcastGrp = m_flow_mcast_grp[flowIdx];
+    }
+}
+
+bool
+LiveLiveNetDevice::Deduplicate(const Headers& hdr, uint16_t ingressPort, uint64_t timestamp)
+{
+    uint16_t seqN = GetU16(hdr.tlvHdr + 2);
+    uint32_t flowId = GetU32(hdr.tlvHdr + 4);
+    uint32_t flowIdx = flowId & ((1U << m_flow_table_bits) - 1);
+    uint32_t windowWords = 1U << m_window_word_bits;
+
+    // A new flow id takes over a free or idle slot, and fails open if the owner is active
+    if (m_flow_owner[flowIdx] != flowId)
+    {
+        uint64_t lastRx = m_flow_last_rx[flowIdx];
+        if (lastRx != 0 &&
+            ((timestamp - lastRx) & TIMESTAMP_MASK) <=
+                static_cast<uint64_t>(m_flow_idle_timeout.GetNanoSeconds()))
+        {
+            return true;
+        }
+        m_flow_owner[flowIdx] = flowId;
+        m_flow_generation[flowIdx]++;
+        m_flow_max_seq_n[flowIdx] = seqN;
+    }
+    m_flow_last_rx[flowIdx] = timestamp;
+    uint32_t pathIdx =
+        (flowIdx << m_path_port_bits) | (ingressPort & ((1U << m_path_port_bits) - 1));
+    uint32_t ringIdx = (flowIdx << m_gap_ring_bits) | (seqN & ((1U << m_gap_ring_bits) - 1));
+    uint32_t tag = (static_cast<uint32_t>(m_flow_generation[flowIdx]) << 16) | seqN;
+
+    // Serial number arithmetic (RFC 1982), old packets are accepted within the window
+    uint16_t maxSeqN = m_flow_max_seq_n[flowIdx];
+    uint16_t ahead = seqN - maxSeqN;
+    bool newer = ahead != 0 && ahead < 0x8000;
+    uint16_t blocksBehind = ((maxSeqN >> 6) - (seqN >> 6)) & 0x3ff;
+    if (!newer && blocksBehind >= windowWords)
+    {
+        m_path_too_old[pathIdx]++;
+        return false;
+    }
+
+    uint32_t wordIdx = (flowIdx << m_window_word_bits) | ((seqN >> 6) & (windowWords - 1));
+    uint32_t block = (static_cast<uint32_t>(m_flow_generation[flowIdx]) << 10) | (seqN >> 6);
+    if (m_flow_word_block[wordIdx] != block)
+    {
+        m_flow_to_bitmap[wordIdx] = 0;
+        m_flow_word_block[wordIdx] = block;
+    }
+
+    uint64_t mask = 1ULL << (seqN & 0x3f);
+    if (m_flow_to_bitmap[wordIdx] & mask)
+    {
+        m_path_dups[pathIdx]++;
+
+        // The first duplicate is the runner-up, measure its gap
+        if (m_first_rx_tag[ringIdx] == tag)
+        {
+            uint64_t gap = (timestamp - m_first_rx_ts[ringIdx]) & TIMESTAMP_MASK;
+            uint64_t& gapEwma = m_path_gap_ewma[pathIdx];
+            gapEwma = (gapEwma - (gapEwma >> m_gap_ewma_shift) + (gap >> m_gap_ewma_shift)) &
+                      TIMESTAMP_MASK;
+            m_first_rx_tag[ringIdx] = 0;
+        }
+        return false;
+    }
+    m_flow_to_bitmap[wordIdx] |= mask;
+    if (newer)
+    {
+        m_flow_max_seq_n[flowIdx] = seqN;
+    }
+    m_path_wins[pathIdx]++;
+    m_first_rx_ts[ringIdx] = timestamp;
+    m_first_rx_tag[ringIdx] = tag;
+    return true;
+}
+
+void
+LiveLiveNetDevice::DecapForward(Headers& hdr, uint16_t& egressSpec)
+{
+    hdr.ipv6 = false;
+    hdr.srv6 = false;
+    hdr.nSegments = 0;
+    hdr.tlv = false;
+
+    const ForwardEntry* entry = LookupLpm(m_ipv6_forward, hdr.innerHdr + 24);
+    if (!entry)
+    {
+        entry = &m_ipv6_forward_default;
+    }
+    if (entry->forward)
+    {
+        egressSpec = entry->port;
+        std::memcpy(hdr.ethernet, entry->mac, 6);
+    }
+}
+
+void
+LiveLiveNetDevice::Egress(Headers& hdr,
+                          uint16_t egressPort,
+                          uint16_t rid,
+                          const uint8_t* payload,
+                          size_t payloadLen,
+                          std::vector<Output>& outputs)
+{
+    uint8_t nSegments = 0;
+
+    auto dest = m_srv6_forward.find(egressPort);
+    if (dest != m_srv6_forward.end() && dest->second.add)
+    {
+        // add_srv6_dest_segment
+        dest->second.segment.Serialize(hdr.ipv6Hdr + 24);
+        PushSegment(hdr, dest->second.segment);
+        SetU16(hdr.ipv6Hdr + 4, GetU16(hdr.ipv6Hdr + 4) + SEGMENT_LEN);
+        hdr.srv6Hdr[1] += 2;
+        nSegments++;
+    }
+
+    auto ll = m_srv6_live_live_forward.find(rid);
+    if (ll != m_srv6_live_live_forward.end() && ll->second.add)
+    {
+        // add_srv6_ll_segment, the bridged flow id and sequence number move to the TLV
+        PushSegment(hdr, ll->second.segment);
+        if (!hdr.tlv)
+        {
+            std::memset(hdr.tlvHdr, 0, TLV_LEN);
+            hdr.tlv = true;
+        }
+        hdr.tlvHdr[0] = 0xff;
+        hdr.tlvHdr[1] = 0x06;
+        SetU16(hdr.tlvHdr + 2, hdr.bridgeSeqN);
+        SetU32(hdr.tlvHdr + 4, hdr.bridgeFlowId);
+        SetU16(hdr.metaHdr, hdr.bridgeSeqN);
+        hdr.bridge = false;
+        SetU16(hdr.ipv6Hdr + 4, GetU16(hdr.ipv6Hdr + 4) + SEGMENT_LEN + TLV_LEN);
+        hdr.srv6Hdr[1] += 2;
+        nSegments++;
+    }
+
+    hdr.srv6Hdr[3] = nSegments - 1;
+    hdr.srv6Hdr[4] = nSegments - 1;
+
+    size_t len = Deparse(hdr, m_out_frame.data());
+    std::memcpy(m_out_frame.data() + len, payload, payloadLen);
+    outputs.push_back({egressPort, Create<Packet>(m_out_frame.data(), len + payloadLen)});
+}
+
+void
+LiveLiveNetDevice::ReceiveFromDevice(uint32_t port_n,
+                                     Ptr<NetDevice> incomingPort,
+                                     Ptr<const Packet> packet,
+                                     uint16_t protocol,
+                                     const Address& src,
+                                     const Address& dst,
+                                     PacketType packetType)
+{
+    NS_LOG_FUNCTION_NOARGS();
+
+    // Re-append the Ethernet header, removed by the port, as P4SwitchNetDevice does
+    Ptr<Packet> full_packet = packet->Copy();
+    EthernetHeader eth_hdr_in;
+    eth_hdr_in.SetSource(Mac48Address::ConvertFrom(src));
+    eth_hdr_in.SetDestination(Mac48Address::ConvertFrom(dst));
+    eth_hdr_in.SetLengthType(protocol);
+    full_packet->AddHeader(eth_hdr_in);
+
+    m_outputs.clear();
+    Process(full_packet, port_n, m_outputs);
+    for (auto& output : m_outputs)
+    {
+        SendOutput(output.port, output.packet, full_packet);
+    }
+}
+
+void
+LiveLiveNetDevice::SendOutput(uint16_t port_n, Ptr<Packet> out_pkt, Ptr<const Packet> packet)
+{
+    NS_LOG_FUNCTION_NOARGS();
+
+    Ptr<NetDevice> port = GetPort(port_n);
+    if (!port)
+    {
+        NS_LOG_DEBUG(m_node_name << " Port " << port_n << " not found, dropping packet");
+        return;
+    }
+
+    // Remove the Ethernet header, the port adds its own framing
+    EthernetHeader eth_hdr_out;
+    out_pkt->RemoveHeader(eth_hdr_out);
+
+    // Tags are copied through one reusable instance per type
+    ByteTagIterator it = packet->GetByteTagIterator();
+    while (it.HasNext())
+    {
+        ByteTagIterator::Item tag_item = it.Next();
+        Tag* tag = GetTagInstance(tag_item.GetTypeId());
+        tag_item.GetTag(*tag);
+        out_pkt->AddByteTag(*tag);
+    }
+
+    PacketTagIterator pit = packet->GetPacketTagIterator();
+    while (pit.HasNext())
+    {
+        PacketTagIterator::Item tag_item = pit.Next();
+        Tag* tag = GetTagInstance(tag_item.GetTypeId());
+        tag_item.GetTag(*tag);
+        out_pkt->AddPacketTag(*tag);
+    }
+
+    NS_LOG_DEBUG(m_node_name << " Forwarding pkt " << out_pkt << " to port " << port_n << " "
+                             << eth_hdr_out.GetDestination() << " " << eth_hdr_out.GetSource()
+                             << " " << eth_hdr_out.GetLengthType());
+
+    if (port->SupportsSendFrom())
+    {
+        port->SendFrom(out_pkt,
+                       eth_hdr_out.GetSource(),
+                       eth_hdr_out.GetDestination(),
+                       eth_hdr_out.GetLengthType());
+    }
+    else
+    {
+        port->Send(out_pkt, eth_hdr_out.GetDestination(), eth_hdr_out.GetLengthType());
+    }
+}
+
+Tag*
+LiveLiveNetDevice::GetTagInstance(TypeId tid)
+{
+    uint16_t uid = tid.GetUid();
+    if (uid >= m_tags.size())
+    {
+        m_tags.resize(uid + 1);
+    }
+    if (!m_tags[uid])
+    {
+        m_tags[uid].reset(dynamic_cast<Tag*>(tid.GetConstructor()()));
+        NS_ASSERT(m_tags[uid] != nullptr);
+    }
+    return m_tags[uid].get();
+}
+
+int64_t
+LiveLiveNetDevice::AssignStreams(int64_t stream)
+{
+    NS_LOG_FUNCTION(this << stream);
+    m_random->SetStream(stream);
+    return 1;
+}
+
+void
+LiveLiveNetDevice::AddPort(Ptr<NetDevice> port)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    NS_ASSERT(port != this);
+
+    if (!Mac48Address::IsMatchingType(port->GetAddress()))
+    {
+        NS_FATAL_ERROR("Device does not use MAC-48 addresses: cannot be added to Live-Live "
+                       "switch.");
+    }
+    if (m_address == Mac48Address())
+    {
+        m_address = Mac48Address::ConvertFrom(port->GetAddress());
+    }
+
+    // Ports are numbered from 1, as in the P4 switch
+    uint32_t port_n = m_ports.size() + 1;
+    m_node->RegisterProtocolHandler(
+        MakeCallback(&LiveLiveNetDevice::ReceiveFromDevice, this, port_n),
+        0,
+        port,
+        true);
+    m_ports.push_back(port);
+    if (port->GetChannel())
+    {
+        m_channel->AddChannel(port->GetChannel());
+    }
+}
+
+uint32_t
+LiveLiveNetDevice::GetNPorts() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return m_ports.size();
+}
+
+Ptr<NetDevice>
+LiveLiveNetDevice::GetPort(uint32_t n) const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    if (n <= 0 || n > GetNPorts())
+    {
+        return nullptr;
+    }
+
+    return m_ports[n - 1];
+}
+
+uint32_t
+LiveLiveNetDevice::GetPortN(Ptr<NetDevice> port)
+{
+    for (uint32_t n = 0; n < m_ports.size(); n++)
+    {
+        if (m_ports[n] == port)
+        {
+            return n + 1;
+        }
+    }
+
+    NS_FATAL_ERROR("Port number port " << port << " cannot be found!");
+}
+
+std::string
+LiveLiveNetDevice::GetPipelineCommands() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return m_pipeline_commands;
+}
+
+void
+LiveLiveNetDevice::SetPipelineCommands(std::string pipeline_commands)
+{
+    NS_LOG_FUNCTION(this << pipeline_commands);
+    m_pipeline_commands = pipeline_commands;
+}
+
+void
+LiveLiveNetDevice::SetIfIndex(const uint32_t index)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_ifIndex = index;
+}
+
+uint32_t
+LiveLiveNetDevice::GetIfIndex() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return m_ifIndex;
+}
+
+Ptr<Channel>
+LiveLiveNetDevice::GetChannel() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return m_channel;
+}
+
+void
+LiveLiveNetDevice::SetAddress(Address address)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_address = Mac48Address::ConvertFrom(address);
+}
+
+Address
+LiveLiveNetDevice::GetAddress() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return m_address;
+}
+
+bool
+LiveLiveNetDevice::SetMtu(const uint16_t mtu)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_mtu = mtu;
+    return true;
+}
+
+uint16_t
+LiveLiveNetDevice::GetMtu() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return m_mtu;
+}
+
+bool
+LiveLiveNetDevice::IsLinkUp() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return true;
+}
+
+void
+LiveLiveNetDevice::AddLinkChangeCallback(Callback<void> callback)
+{
+    // Unused.
+}
+
+bool
+LiveLiveNetDevice::IsBroadcast() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return true;
+}
+
+Address
+LiveLiveNetDevice::GetBroadcast() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return Mac48Address("ff:ff:ff:ff:ff:ff");
+}
+
+bool
+LiveLiveNetDevice::IsMulticast() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return true;
+}
+
+Address
+LiveLiveNetDevice::GetMulticast(Ipv4Address multicastGroup) const
+{
+    NS_LOG_FUNCTION(this << multicastGroup);
+    return Mac48Address::GetMulticast(multicastGroup);
+}
+
+bool
+LiveLiveNetDevice::IsPointToPoint() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return false;
+}
+
+bool
+LiveLiveNetDevice::IsBridge() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return true;
+}
+
+bool
+LiveLiveNetDevice::Send(Ptr<Packet> packet, const Address& dest, uint16_t protocolNumber)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return SendFrom(packet, m_address, dest, protocolNumber);
+}
+
+bool
+LiveLiveNetDevice::SendFrom(Ptr<Packet> packet,
+                            const Address& src,
+                            const Address& dest,
+                            uint16_t protocolNumber)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return false;
+}
+
+Ptr<Node>
+LiveLiveNetDevice::GetNode() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return m_node;
+}
+
+void
+LiveLiveNetDevice::SetNode(Ptr<Node> node)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_node = node;
+}
+
+bool
+LiveLiveNetDevice::NeedsArp() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return false;
+}
+
+void
+LiveLiveNetDevice::SetReceiveCallback(NetDevice::ReceiveCallback cb)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_rxCallback = cb;
+}
+
+void
+LiveLiveNetDevice::SetPromiscReceiveCallback(NetDevice::PromiscReceiveCallback cb)
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_promiscRxCallback = cb;
+}
+
+bool
+LiveLiveNetDevice::SupportsSendFrom() const
+{
+    NS_LOG_FUNCTION_NOARGS();
+    return false;
+}
+
+Address
+LiveLiveNetDevice::GetMulticast(Ipv6Address addr) const
+{
+    NS_LOG_FUNCTION(this << addr);
+    return Mac48Address::GetMulticast(addr);
+}
+} // namespace ns3
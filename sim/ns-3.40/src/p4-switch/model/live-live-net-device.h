@@ -0,0 +1,489 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef LIVE_LIVE_NET_DEVICE_H
+#define LIVE_LIVE_NET_DEVICE_H
+
+#include "ns3/ipv6-address.h"
+#include "ns3/mac48-address.h"
+#include "ns3/net-device.h"
+#include "ns3/nstime.h"
+#include "ns3/p4-switch-channel.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/tag.h"
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::LiveLiveNetDevice declaration.
+ */
+
+namespace ns3
+{
+
+class Node;
+
+/**
+ * \ingroup p4-switch
+ * \brief a virtual net device that implements srv6_livelive.p4 natively
+ *
+ * The LiveLiveNetDevice aggregates multiple "real" netdevices, like P4SwitchNetDevice, and
+ * forwards packets with the same semantics as the srv6_livelive.p4 program running on bmv2,
+ * without interpreting a P4 program:
+ *
+ * - as spreader, IPv6 packets are encapsulated in SRv6 and, for the sources of
+ *   check_live_live_enabled with live_live_mcast, tagged with a flow id (epoch ++ 24 bits of
+ *   the crc32 of the 5-tuple) and a per-flow sequence number and multicast to all the paths;
+ * - as merger, packets whose last segment is a srv6_ll_deduplicate function are checked
+ *   against the per-flow window of sequence numbers, and only the first copy is decapsulated
+ *   and forwarded.
+ *
+ * The merger counts, for each flow slot and ingress port, the first copies it delivers
+ * (path_wins), the duplicates (path_dups) and the packets behind the window (path_too_old) it
+ * drops, and averages how much later than the first copy the port delivers the second one
+ * (path_gap_ewma). The spreader multicasts the flows of a slot to the group in flow_mcast_grp,
+ * if set, instead of the one of the entry, so that a LiveLivePathSelector can replicate each
+ * flow on its best paths only.
+ *
+ * The tables, the multicast groups and the constants (FlowTableBits, WindowWordBits,
+ * PathPortBits, GapRingBits, GapEwmaShift, FlowIdleTimeout) are those of the P4 program. The
+ * tables and groups are filled with the subset of the simple_switch_CLI commands it needs, so
+ * the PipelineCommands of a P4SwitchNetDevice can be reused as they are. Given the same
+ * commands and inputs, the output frames are identical byte for byte to those of P4Pipeline,
+ * except for the ports chosen by ipv6_encap_forward_random. Frames that the P4 parser cannot
+ * fully extract (truncated headers, more than 10 segments, unknown SRH tags) are dropped.
+ */
+class LiveLiveNetDevice : public NetDevice
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * A frame emitted by the data plane
+     */
+    struct Output
+    {
+        uint16_t port;      //!< Egress port
+        Ptr<Packet> packet; //!< Ethernet frame, as the bytes of the packet
+    };
+
+    LiveLiveNetDevice();
+    ~LiveLiveNetDevice() override;
+
+    LiveLiveNetDevice(const LiveLiveNetDevice&) = delete;
+    LiveLiveNetDevice& operator=(const LiveLiveNetDevice&) = delete;
+
+    /**
+     * \brief Add a port to the switch
+     *
+     * Ports can be any NetDevice with MAC-48 addresses, as for P4SwitchNetDevice.
+     *
+     * \param port the port
+     */
+    void AddPort(Ptr<NetDevice> port);
+    uint32_t GetNPorts() const;
+    Ptr<NetDevice> GetPort(uint32_t n) const;
+    uint32_t GetPortN(Ptr<NetDevice> port);
+
+    std::string GetPipelineCommands() const;
+    void SetPipelineCommands(std::string pipeline_commands);
+
+    /**
+     * \brief Run simple_switch_CLI commands on the tables and multicast groups
+     *
+     * Supported commands are table_add and table_set_default for the tables of
+     * srv6_livelive.p4, mc_mgrp_create, mc_node_create, mc_node_update, mc_node_associate,
+     * register_read and register_write.
+     *
+     * \param commands the commands, one per line
+     * \return the output of the commands, in the format of P4Pipeline::run_cli_commands()
+     */
+    std::string RunPipelineCommands(std::string commands);
+
+    /**
+     * \brief Read a register cell, as P4Pipeline::register_read()
+     * \param name the register name, in full or as a dot-separated suffix (e.g. "path_wins")
+     * \param index the cell
+     * \param value set to the value of the cell
+     * \return false if the register does not exist or the index is out of range
+     */
+    bool RegisterRead(const std::string& name, uint32_t index, uint64_t& value);
+
+    /**
+     * \brief Write a register cell, as P4Pipeline::register_write()
+     * \param name the register name, in full or as a dot-separated suffix
+     * \param index the cell
+     * \param value the value, truncated to the width of the register
+     * \return false if the register does not exist or the index is out of range
+     */
+    bool RegisterWrite(const std::string& name, uint32_t index, uint64_t value);
+
+    /**
+     * \brief Process an Ethernet frame as srv6_livelive.p4 would
+     *
+     * The ingress timestamp is the current simulation time in nanoseconds, as in P4Pipeline.
+     * The outputs are appended in the order of P4Pipeline::process(): multicast replicas by
+     * node association order, then by port.
+     *
+     * \param frame the frame, including the Ethernet header
+     * \param port_n the ingress port
+     * \param outputs where the emitted frames are appended
+     */
+    void Process(Ptr<const Packet> frame, uint32_t port_n, std::vector<Output>& outputs);
+
+    /**
+     * \brief Compute the crc32 hash of bmv2 (reflected CRC-32, as in zlib)
+     * \param data the bytes to hash
+     * \param len the number of bytes
+     * \return the hash
+     */
+    static uint32_t Crc32(const uint8_t* data, size_t len);
+
+    /**
+     * \brief Assign a fixed random variable stream number to the random variables used by
+     *        this model (ipv6_encap_forward_random)
+     * \param stream first stream index to use
+     * \return the number of stream indices assigned by this model
+     */
+    int64_t AssignStreams(int64_t stream);
+
+    // inherited from NetDevice base class.
+    void SetIfIndex(const uint32_t index) override;
+    uint32_t GetIfIndex() const override;
+    Ptr<Channel> GetChannel() const override;
+    void SetAddress(Address address) override;
+    Address GetAddress() const override;
+    bool SetMtu(const uint16_t mtu) override;
+    uint16_t GetMtu() const override;
+    bool IsLinkUp() const override;
+    void AddLinkChangeCallback(Callback<void> callback) override;
+    bool IsBroadcast() const override;
+    Address GetBroadcast() const override;
+    bool IsMulticast() const override;
+    Address GetMulticast(Ipv4Address multicastGroup) const override;
+    bool IsPointToPoint() const override;
+    bool IsBridge() const override;
+    bool Send(Ptr<Packet> packet, const Address& dest, uint16_t protocolNumber) override;
+    bool SendFrom(Ptr<Packet> packet,
+                  const Address& source,
+                  const Address& dest,
+                  uint16_t protocolNumber) override;
+    Ptr<Node> GetNode() const override;
+    void SetNode(Ptr<Node> node) override;
+    bool NeedsArp() const override;
+    void SetReceiveCallback(NetDevice::ReceiveCallback cb) override;
+    void SetPromiscReceiveCallback(NetDevice::PromiscReceiveCallback cb) override;
+    bool SupportsSendFrom() const override;
+    Address GetMulticast(Ipv6Address addr) const override;
+
+  protected:
+    void DoDispose() override;
+
+    /**
+     * \brief Receive a packet from a port
+     * \param port_n the port number, bound to the callback when the port is added
+     * \param device the port
+     * \param packet the packet
+     * \param protocol the protocol number
+     * \param source the source address
+     * \param destination the destination address
+     * \param packetType the packet type
+     */
+    void ReceiveFromDevice(uint32_t port_n,
+                           Ptr<NetDevice> device,
+                           Ptr<const Packet> packet,
+                           uint16_t protocol,
+                           const Address& source,
+                           const Address& destination,
+                           PacketType packetType);
+
+    /**
+     * \brief Send a frame emitted by the data plane
+     * \param port_n the egress port
+     * \param out_pkt the frame to send
+     * \param packet the received packet it derives from, its tags are copied
+     */
+    void SendOutput(uint16_t port_n, Ptr<Packet> out_pkt, Ptr<const Packet> packet);
+
+    /**
+     * \brief Size the registers and run PipelineCommands, on first use
+     */
+    void InitState();
+
+    /**
+     * \brief Get the instance used to copy the tags of a type, created on first use
+     * \param tid the TypeId of the tag
+     * \return the tag instance
+     */
+    Tag* GetTagInstance(TypeId tid);
+
+  private:
+    struct Headers;
+
+    /**
+     * Actions of check_live_live_enabled
+     */
+    enum SpreaderAction
+    {
+        ENCAP_FORWARD_RANDOM, //!< ipv6_encap_forward_random
+        ENCAP_FORWARD_PORT,   //!< ipv6_encap_forward_port
+        LIVE_LIVE_MCAST,      //!< live_live_mcast
+    };
+
+    /**
+     * Entry of check_live_live_enabled
+     */
+    struct SpreaderEntry
+    {
+        Ipv6Address prefix;    //!< Matched source prefix
+        Ipv6Prefix mask;       //!< Prefix length
+        SpreaderAction action; //!< Action
+        Ipv6Address srcAddr;   //!< Source address of the SRv6 encapsulation
+        uint16_t port;         //!< Egress port, or lower bound of the random port
+        uint16_t portHi;       //!< Upper bound of the random port
+        uint16_t mcastGroup;   //!< Multicast group
+    };
+
+    /**
+     * Entry of ipv6_forward
+     */
+    struct ForwardEntry
+    {
+        Ipv6Address prefix; //!< Matched destination prefix
+        Ipv6Prefix mask;    //!< Prefix length
+        bool forward;       //!< Whether the action is forward, NoAction otherwise
+        uint16_t port;      //!< Egress port
+        uint8_t mac[6];     //!< Destination MAC address
+    };
+
+    /**
+     * Entry of srv6_forward and srv6_live_live_forward
+     */
+    struct SegmentEntry
+    {
+        bool add;            //!< Whether the action adds the segment, NoAction otherwise
+        Ipv6Address segment; //!< Segment to add
+    };
+
+    /**
+     * Register of the P4 program, as an array of cells of the smallest fitting integer type
+     */
+    struct RegisterRef
+    {
+        const char* name;  //!< Full P4 name
+        uint32_t bitwidth; //!< Width of the cells, in bits
+        void* data;        //!< First cell
+        size_t size;       //!< Number of cells
+        size_t cellSize;   //!< Size of a cell, in bytes
+    };
+
+    /**
+     * Node of a multicast group
+     */
+    struct McNode
+    {
+        uint16_t rid;                //!< Replication id, seen as egress_rid
+        std::vector<uint16_t> ports; //!< Ports, in increasing order
+        bool associated;             //!< Whether the node belongs to a group
+    };
+
+    /**
+     * \brief Extract the headers of a frame, as PktParser
+     * \param data the frame
+     * \param len the length of the frame
+     * \param hdr filled with the headers
+     * \return false if a header is truncated or the SRH is not supported by the parser
+     */
+    static bool Parse(const uint8_t* data, size_t len, Headers& hdr);
+
+    /**
+     * \brief Emit the valid headers, as PktDeparser
+     * \param hdr the headers
+     * \param out the buffer, large enough for all the headers
+     * \return the number of bytes written
+     */
+    static size_t Deparse(const Headers& hdr, uint8_t* out);
+
+    /**
+     * \brief Move the IPv6 header inside an SRv6 encapsulation, as encapsulate_srv6
+     * \param hdr the headers
+     * \param srcAddr the source address of the outer IPv6 header
+     */
+    static void Encapsulate(Headers& hdr, const Ipv6Address& srcAddr);
+
+    /**
+     * \brief Push a segment in front of the segment list, as push_front(1)
+     * \param hdr the headers
+     * \param segment the segment
+     */
+    static void PushSegment(Headers& hdr, const Ipv6Address& segment);
+
+    /**
+     * \brief Run a single CLI command
+     * \param line the command
+     * \param out where to write the result
+     */
+    void RunPipelineCommand(const std::string& line, std::ostream& out);
+
+    /**
+     * \brief Add an entry, or set the default action, of a table
+     * \param table the table name
+     * \param action the action name
+     * \param key the match key, empty for the default action
+     * \param params the action parameters
+     * \param isDefault whether to set the default action
+     * \param handle set to the handle of the new entry
+     * \return an empty string on success, the error otherwise
+     */
+    std::string AddTableEntry(const std::string& table,
+                              const std::string& action,
+                              const std::vector<std::string>& key,
+                              const std::vector<std::string>& params,
+                              bool isDefault,
+                              uint32_t& handle);
+
+    /**
+     * \brief Get a register by name
+     * \param name the register name, in full or as a dot-separated suffix
+     * \param reg set to the register
+     * \return false if the register does not exist
+     */
+    bool GetRegister(const std::string& name, RegisterRef& reg);
+
+    /**
+     * \brief Run the ingress control, as IngressPipe
+     * \param hdr the parsed headers
+     * \param ingressPort the ingress port
+     * \param timestamp the ingress timestamp
+     * \param egressSpec set to the egress port, or 511 to drop
+     * \param mcastGrp set to the multicast group, 0 for unicast
+     */
+    void Ingress(Headers& hdr,
+                 uint16_t ingressPort,
+                 uint64_t timestamp,
+                 uint16_t& egressSpec,
+                 uint16_t& mcastGrp);
+
+    /**
+     * \brief Assign the flow id and sequence number of a Live-Live packet, as assign_flow_seq_n
+     * \param hdr the parsed headers
+     * \param timestamp the ingress timestamp
+     * \param mcastGrp set to the multicast group of the flow slot, if any
+     */
+    void AssignFlowSeqN(Headers& hdr, uint64_t timestamp, uint16_t& mcastGrp);
+
+    /**
+     * \brief Check a Live-Live packet against the window of its flow, as the srv6_ll_deduplicate
+     *        branch of IngressPipe
+     * \param hdr the parsed headers
+     * \param ingressPort the ingress port, whose per-path counters are updated
+     * \param timestamp the ingress timestamp
+     * \return true if the packet must be delivered
+     */
+    bool Deduplicate(const Headers& hdr, uint16_t ingressPort, uint64_t timestamp);
+
+    /**
+     * \brief Decapsulate and forward by the inner destination, as decap_srv6 and ipv6_forward
+     * \param hdr the parsed headers
+     * \param egressSpec set to the egress port on a hit
+     */
+    void DecapForward(Headers& hdr, uint16_t& egressSpec);
+
+    /**
+     * \brief Run the egress control, as EgressPipe, and append the deparsed frame
+     * \param hdr the headers of the replica
+     * \param egressPort the egress port
+     * \param rid the replication id
+     * \param payload the bytes after the parsed headers
+     * \param payloadLen the number of bytes after the parsed headers
+     * \param outputs where the frame is appended
+     */
+    void Egress(Headers& hdr,
+                uint16_t egressPort,
+                uint16_t rid,
+                const uint8_t* payload,
+                size_t payloadLen,
+                std::vector<Output>& outputs);
+
+    NetDevice::ReceiveCallback m_rxCallback;               //!< receive callback
+    NetDevice::PromiscReceiveCallback m_promiscRxCallback; //!< promiscuous receive callback
+
+    Mac48Address m_address; //!< MAC address of the NetDevice, this is the MAC Address of the first
+                            //!< interface added
+
+    bool m_initialized;                  //!< Whether the registers are sized and commands run
+    std::string m_pipeline_commands;     //!< The CLI commands to run
+    uint32_t m_flow_table_bits;          //!< log2 of the flow table slots, as FLOW_TABLE_BITS
+    uint32_t m_window_word_bits;         //!< log2 of the window words per flow
+    uint32_t m_path_port_bits;           //!< log2 of the ports with per-path state per slot
+    uint32_t m_gap_ring_bits;            //!< log2 of the first arrival times kept per slot
+    uint32_t m_gap_ewma_shift;           //!< Weight of a gap sample, as 1 / 2^shift
+    Time m_flow_idle_timeout;            //!< Idle time before a slot is reused
+    Ptr<UniformRandomVariable> m_random; //!< Ports of ipv6_encap_forward_random
+
+    std::vector<SpreaderEntry> m_check_live_live_enabled; //!< Entries, longest prefix first
+    SpreaderEntry m_check_live_live_enabled_default;      //!< Default action
+    std::map<uint16_t, SegmentEntry> m_srv6_forward;           //!< Entries by egress port
+    std::map<uint16_t, SegmentEntry> m_srv6_live_live_forward; //!< Entries by egress rid
+    std::map<uint64_t, bool> m_srv6_function; //!< Whether the action deduplicates, by function id
+    std::vector<ForwardEntry> m_ipv6_forward; //!< Entries, longest prefix first
+    ForwardEntry m_ipv6_forward_default;      //!< Default action
+    std::map<uint32_t, std::vector<uint32_t>> m_mc_groups; //!< Node handles by group
+    std::vector<McNode> m_mc_nodes;                        //!< Nodes, by handle
+
+    std::vector<uint16_t> m_seq_n;           //!< Last sequence number, by slot
+    std::vector<uint8_t> m_flow_epoch;       //!< Epoch of the flow id, by slot
+    std::vector<uint64_t> m_flow_last_tx;    //!< Time of the last packet sent, by slot
+    std::vector<uint16_t> m_flow_mcast_grp;  //!< Multicast group replacing the entry's, by slot
+    std::vector<uint32_t> m_flow_owner;      //!< Flow id owning the window, by slot
+    std::vector<uint64_t> m_flow_last_rx;    //!< Time of the last packet received, by slot
+    std::vector<uint16_t> m_flow_max_seq_n;  //!< Highest sequence number accepted, by slot
+    std::vector<uint8_t> m_flow_generation;  //!< Generation of the window, by slot
+    std::vector<uint64_t> m_flow_to_bitmap;  //!< Sequence numbers seen, by window word
+    std::vector<uint32_t> m_flow_word_block; //!< Generation ++ block held, by window word
+    std::vector<uint32_t> m_path_wins;       //!< First copies delivered, by slot and port
+    std::vector<uint32_t> m_path_dups;       //!< Duplicates dropped, by slot and port
+    std::vector<uint32_t> m_path_too_old;    //!< Packets behind the window, by slot and port
+    std::vector<uint64_t> m_path_gap_ewma;   //!< Average gap of the second copy, by slot and port
+    std::vector<uint64_t> m_first_rx_ts;     //!< Arrival time of the first copy, by ring cell
+    std::vector<uint32_t> m_first_rx_tag;    //!< Generation ++ seq_n of the first copy, or 0
+
+    std::vector<uint8_t> m_frame;             //!< Buffer of the frame being processed
+    std::vector<uint8_t> m_out_frame;         //!< Buffer of the frame being deparsed
+    std::vector<Output> m_outputs;            //!< Outputs of the received packet, reused
+    std::vector<std::unique_ptr<Tag>> m_tags; //!< Instances used to copy tags, by TypeId uid
+
+    Ptr<Node> m_node;                    //!< node owning this NetDevice
+    std::string m_node_name;             //!< name of the node, cached on first use
+    Ptr<P4SwitchChannel> m_channel;      //!< virtual channel
+    std::vector<Ptr<NetDevice>> m_ports; //!< ports
+    uint32_t m_ifIndex;                  //!< Interface index
+    uint16_t m_mtu;                      //!< MTU of the NetDevice
+};
+} // namespace ns3
+
+#endif /* LIVE_LIVE_NET_DEVICE_H */
@@ -0,0 +1,186 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "live-live-path-monitor.h"
+
+#include "live-live-registers.h"
+
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::LiveLivePathMonitor implementation.
+ */
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("LiveLivePathMonitor");
+
+NS_OBJECT_ENSURE_REGISTERED(LiveLivePathMonitor);
+
+TypeId
+LiveLivePathMonitor::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::LiveLivePathMonitor")
+            .SetParent<Object>()
+            .SetGroupName("P4Switch")
+            .AddConstructor<LiveLivePathMonitor>()
+            .AddAttribute("Interval",
+                          "Time between two reports",
+                          TimeValue(MilliSeconds(100)),
+                          MakeTimeAccessor(&LiveLivePathMonitor::m_interval),
+                          MakeTimeChecker(NanoSeconds(1)))
+            .AddAttribute("FlowTableBits",
+                          "log2 of the number of flow slots of the merger, as FLOW_TABLE_BITS",
+                          UintegerValue(10),
+                          MakeUintegerAccessor(&LiveLivePathMonitor::m_flow_table_bits),
+                          MakeUintegerChecker<uint32_t>(1, 24))
+            .AddAttribute("PathPortBits",
+                          "log2 of the number of ports with per-path state in each flow slot, "
+                          "as PATH_PORT_BITS",
+                          UintegerValue(7),
+                          MakeUintegerAccessor(&LiveLivePathMonitor::m_path_port_bits),
+                          MakeUintegerChecker<uint32_t>(0, 9))
+            .AddTraceSource("PathStats",
+                            "Statistics of a path of a flow slot that received packets since "
+                            "the previous report",
+                            MakeTraceSourceAccessor(&LiveLivePathMonitor::m_path_stats_trace),
+                            "ns3::LiveLivePathMonitor::PathStatsTracedCallback");
+
+    return tid;
+}
+
+LiveLivePathMonitor::LiveLivePathMonitor()
+{
+    NS_LOG_FUNCTION_NOARGS();
+}
+
+LiveLivePathMonitor::~LiveLivePathMonitor()
+{
+    NS_LOG_FUNCTION_NOARGS();
+}
+
+void
+LiveLivePathMonitor::DoDispose()
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_event.Cancel();
+    m_merger = nullptr;
+    m_last.clear();
+    Object::DoDispose();
+}
+
+void
+LiveLivePathMonitor::SetMerger(Ptr<NetDevice> merger)
+{
+    m_merger = merger;
+}
+
+void
+LiveLivePathMonitor::AddPort(uint32_t port)
+{
+    NS_ABORT_MSG_IF(port >= (1U << m_path_port_bits), "Ports must be lower than 2^PathPortBits");
+    NS_ABORT_MSG_IF(!m_last.empty(), "Ports must be added before the first report");
+    m_ports.push_back(port);
+}
+
+void
+LiveLivePathMonitor::Start(Time delay)
+{
+    m_event.Cancel();
+    m_event = Simulator::Schedule(delay, &LiveLivePathMonitor::Run, this);
+}
+
+void
+LiveLivePathMonitor::Stop()
+{
+    m_event.Cancel();
+}
+
+uint64_t
+LiveLivePathMonitor::ReadRegister(const std::string& name, uint32_t index)
+{
+    uint64_t value = 0;
+    NS_ABORT_MSG_IF(!LiveLiveRegisterRead(m_merger, name, index, value),
+                    "Cannot read register " << name << "[" << index << "]");
+    return value;
+}
+
+void
+LiveLivePathMonitor::Update()
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(!m_merger, "Merger must be set");
+
+    uint32_t slots = 1 << m_flow_table_bits;
+    if (m_last.empty())
+    {
+        m_last.assign(slots * m_ports.size(), {0, 0, 0});
+    }
+
+    for (uint32_t slot = 0; slot < slots; slot++)
+    {
+        uint32_t owner = ReadRegister("flow_owner", slot);
+        if (owner == 0)
+        {
+            // Never used by a flow
+            continue;
+        }
+
+        for (uint32_t i = 0; i < m_ports.size(); i++)
+        {
+            uint32_t index = (slot << m_path_port_bits) | m_ports[i];
+            Counters counters = {static_cast<uint32_t>(ReadRegister("path_wins", index)),
+                                 static_cast<uint32_t>(ReadRegister("path_dups", index)),
+                                 static_cast<uint32_t>(ReadRegister("path_too_old", index))};
+            Counters& last = m_last[slot * m_ports.size() + i];
+            if (counters.wins == last.wins && counters.dups == last.dups &&
+                counters.tooOld == last.tooOld)
+            {
+                continue;
+            }
+
+            // The counters wrap around, the differences stay correct
+            LiveLivePathStats stats;
+            stats.slot = slot;
+            stats.flowId = owner;
+            stats.port = m_ports[i];
+            stats.wins = counters.wins - last.wins;
+            stats.dups = counters.dups - last.dups;
+            stats.tooOld = counters.tooOld - last.tooOld;
+            stats.gap = NanoSeconds(ReadRegister("path_gap_ewma", index));
+            last = counters;
+
+            m_path_stats_trace(stats);
+        }
+    }
+}
+
+void
+LiveLivePathMonitor::Run()
+{
+    Update();
+    m_event = Simulator::Schedule(m_interval, &LiveLivePathMonitor::Run, this);
+}
+
+} // namespace ns3
@@ -0,0 +1,155 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef LIVE_LIVE_PATH_MONITOR_H
+#define LIVE_LIVE_PATH_MONITOR_H
+
+#include "ns3/event-id.h"
+#include "ns3/net-device.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/traced-callback.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::LiveLivePathMonitor declaration.
+ */
+
+namespace ns3
+{
+
+/**
+ * \ingroup p4-switch
+ * First-arrival statistics of a path of a Live-Live flow, at the merger
+ */
+struct LiveLivePathStats
+{
+    uint32_t slot;   //!< Flow slot
+    uint32_t flowId; //!< Flow id owning the slot
+    uint32_t port;   //!< Ingress port of the path
+    uint32_t wins;   //!< First copies delivered since the previous report
+    uint32_t dups;   //!< Duplicates dropped since the previous report
+    uint32_t tooOld; //!< Packets behind the dedup window dropped since the previous report
+    Time gap;        //!< Moving average of the delay of the second copies behind the first ones
+};
+
+/**
+ * \ingroup p4-switch
+ * \brief exports the per-path statistics of a Live-Live merger as a trace
+ *
+ * The merger of srv6_livelive.p4 counts, for each flow slot and ingress port, the first copies
+ * it delivers, the duplicates and the packets behind the dedup window it drops, and averages
+ * how much later than the first copy the port delivers the second one. The monitor reads these
+ * registers every Interval, from a P4SwitchNetDevice or a LiveLiveNetDevice, and reports
+ * through the PathStats trace the ports of each flow slot with new packets.
+ *
+ * The same registers can be read with register_read, or RegisterRead() on the device, as
+ * path_wins, path_dups, path_too_old and path_gap_ewma, at index slot << PATH_PORT_BITS | port.
+ */
+class LiveLivePathMonitor : public Object
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * TracedCallback signature for the statistics of a path.
+     *
+     * \param [in] stats the statistics
+     */
+    typedef void (*PathStatsTracedCallback)(const LiveLivePathStats& stats);
+
+    LiveLivePathMonitor();
+    ~LiveLivePathMonitor() override;
+
+    /**
+     * \brief Set the switch that deduplicates the flows
+     * \param merger a P4SwitchNetDevice running srv6_livelive.p4, or a LiveLiveNetDevice
+     */
+    void SetMerger(Ptr<NetDevice> merger);
+
+    /**
+     * \brief Add an ingress port of the merger to monitor
+     * \param port the port
+     */
+    void AddPort(uint32_t port);
+
+    /**
+     * \brief Start the periodic reports
+     * \param delay when to read the registers the first time
+     */
+    void Start(Time delay);
+
+    /**
+     * \brief Stop the periodic reports
+     */
+    void Stop();
+
+    /**
+     * \brief Read the registers and report the paths with new packets now
+     */
+    void Update();
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * \brief Report and schedule the next report
+     */
+    void Run();
+
+    /**
+     * Counters of a path, as read in the previous report
+     */
+    struct Counters
+    {
+        uint32_t wins;   //!< path_wins
+        uint32_t dups;   //!< path_dups
+        uint32_t tooOld; //!< path_too_old
+    };
+
+    /**
+     * \brief Read a register of the merger
+     * \param name the register name
+     * \param index the cell
+     * \return the value of the cell, the simulation aborts if it cannot be read
+     */
+    uint64_t ReadRegister(const std::string& name, uint32_t index);
+
+    Ptr<NetDevice> m_merger;       //!< Switch deduplicating the flows
+    std::vector<uint32_t> m_ports; //!< Monitored ports
+    std::vector<Counters> m_last;  //!< Counters by slot and port, sized on the first report
+    Time m_interval;               //!< Time between reports
+    uint32_t m_flow_table_bits;    //!< log2 of the flow slots, as FLOW_TABLE_BITS
+    uint32_t m_path_port_bits;     //!< log2 of the ports with per-path state, as PATH_PORT_BITS
+    EventId m_event;               //!< Next report
+
+    TracedCallback<const LiveLivePathStats&> m_path_stats_trace; //!< Statistics of a path
+};
+
+} // namespace ns3
+
+#endif /* LIVE_LIVE_PATH_MONITOR_H */
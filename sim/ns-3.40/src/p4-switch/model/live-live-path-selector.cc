@@ -0,0 +1,368 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "live-live-path-selector.h"
+
+#include "live-live-registers.h"
+
+#include "ns3/abort.h"
+#include "ns3/double.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <numeric>
+#include <sstream>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::LiveLivePathSelector implementation.
+ */
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("LiveLivePathSelector");
+
+NS_OBJECT_ENSURE_REGISTERED(LiveLivePathSelector);
+
+TypeId
+LiveLivePathSelector::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::LiveLivePathSelector")
+            .SetParent<Object>()
+            .SetGroupName("P4Switch")
+            .AddConstructor<LiveLivePathSelector>()
+            .AddAttribute("Interval",
+                          "Time between two selection rounds",
+                          TimeValue(MilliSeconds(100)),
+                          MakeTimeAccessor(&LiveLivePathSelector::m_interval),
+                          MakeTimeChecker(NanoSeconds(1)))
+            .AddAttribute("ActivePaths",
+                          "Number of paths, with the most first copies delivered, on which each "
+                          "flow is replicated",
+                          UintegerValue(2),
+                          MakeUintegerAccessor(&LiveLivePathSelector::m_active_paths),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("ProbePaths",
+                          "Number of other paths on which each flow is replicated in rotation, "
+                          "to keep measuring them",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&LiveLivePathSelector::m_probe_paths),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("Alpha",
+                          "Weight of the last round in the moving average of the share of "
+                          "first copies delivered by each path",
+                          DoubleValue(0.25),
+                          MakeDoubleAccessor(&LiveLivePathSelector::m_alpha),
+                          MakeDoubleChecker<double>(0, 1))
+            .AddAttribute("FlowTableBits",
+                          "log2 of the number of flow slots of the switches, as FLOW_TABLE_BITS",
+                          UintegerValue(10),
+                          MakeUintegerAccessor(&LiveLivePathSelector::m_flow_table_bits),
+                          MakeUintegerChecker<uint32_t>(1, 24))
+            .AddAttribute("PathPortBits",
+                          "log2 of the number of ports with per-path state in each flow slot, "
+                          "as PATH_PORT_BITS",
+                          UintegerValue(7),
+                          MakeUintegerAccessor(&LiveLivePathSelector::m_path_port_bits),
+                          MakeUintegerChecker<uint32_t>(0, 9))
+            .AddAttribute("FirstMulticastGroup",
+                          "Multicast group of flow slot 0 on the spreader, slot i uses this "
+                          "group + i",
+                          UintegerValue(2),
+                          MakeUintegerAccessor(&LiveLivePathSelector::m_first_group),
+                          MakeUintegerChecker<uint32_t>(1, 0xffff))
+            .AddAttribute("ReplicationId",
+                          "Replication id of the multicast nodes of the slots, the one of the "
+                          "srv6_live_live_forward entry of the spreader",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&LiveLivePathSelector::m_rid),
+                          MakeUintegerChecker<uint16_t>())
+            .AddTraceSource("Selection",
+                            "The paths replicating the flow of a slot, when they change",
+                            MakeTraceSourceAccessor(&LiveLivePathSelector::m_selection_trace),
+                            "ns3::LiveLivePathSelector::SelectionTracedCallback");
+
+    return tid;
+}
+
+LiveLivePathSelector::LiveLivePathSelector()
+    : m_round(0)
+{
+    NS_LOG_FUNCTION_NOARGS();
+}
+
+LiveLivePathSelector::~LiveLivePathSelector()
+{
+    NS_LOG_FUNCTION_NOARGS();
+}
+
+void
+LiveLivePathSelector::DoDispose()
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_event.Cancel();
+    m_spreader = nullptr;
+    m_merger = nullptr;
+    m_slots.clear();
+    Object::DoDispose();
+}
+
+void
+LiveLivePathSelector::SetSpreader(Ptr<NetDevice> spreader)
+{
+    m_spreader = spreader;
+}
+
+void
+LiveLivePathSelector::SetMerger(Ptr<NetDevice> merger)
+{
+    m_merger = merger;
+}
+
+void
+LiveLivePathSelector::AddPath(uint32_t spreaderPort, uint32_t mergerPort)
+{
+    NS_ABORT_MSG_IF(spreaderPort >= (1U << m_path_port_bits) ||
+                        mergerPort >= (1U << m_path_port_bits),
+                    "Path ports must be lower than 2^PathPortBits");
+    NS_ABORT_MSG_IF(!m_slots.empty(), "Paths must be added before the first round");
+    m_paths.push_back({spreaderPort, mergerPort});
+}
+
+void
+LiveLivePathSelector::Start(Time delay)
+{
+    m_event.Cancel();
+    m_event = Simulator::Schedule(delay, &LiveLivePathSelector::Run, this);
+}
+
+void
+LiveLivePathSelector::Stop()
+{
+    m_event.Cancel();
+}
+
+uint64_t
+LiveLivePathSelector::ReadRegister(Ptr<NetDevice> device, const std::string& name, uint32_t index)
+{
+    uint64_t value = 0;
+    NS_ABORT_MSG_IF(!LiveLiveRegisterRead(device, name, index, value),
+                    "Cannot read register " << name << "[" << index << "]");
+    return value;
+}
+
+void
+LiveLivePathSelector::WriteRegister(Ptr<NetDevice> device,
+                                    const std::string& name,
+                                    uint32_t index,
+                                    uint64_t value)
+{
+    NS_ABORT_MSG_IF(!LiveLiveRegisterWrite(device, name, index, value),
+                    "Cannot write register " << name << "[" << index << "]");
+}
+
+std::string
+LiveLivePathSelector::RunCommands(const std::string& commands)
+{
+    std::string output = LiveLiveRunCommands(m_spreader, commands);
+    NS_ABORT_MSG_IF(output.empty() || output.find("Invalid") != std::string::npos,
+                    "Cannot run on the spreader:\n"
+                        << commands << output);
+    return output;
+}
+
+void
+LiveLivePathSelector::Select(uint32_t slotIdx, const std::vector<bool>& selected)
+{
+    Slot& slot = m_slots[slotIdx];
+    if (slot.selected == selected)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> paths;
+    std::ostringstream ports;
+    for (uint32_t i = 0; i < m_paths.size(); i++)
+    {
+        if (selected[i])
+        {
+            paths.push_back(i);
+            ports << " " << m_paths[i].spreaderPort;
+        }
+        // The first copies of a path that did not replicate are counted from now
+        if (selected[i] && !slot.selected[i])
+        {
+            slot.wins[i] = ReadRegister(m_merger,
+                                        "path_wins",
+                                        (slotIdx << m_path_port_bits) | m_paths[i].mergerPort);
+        }
+    }
+    slot.selected = selected;
+
+    uint32_t group = m_first_group + slotIdx;
+    std::ostringstream commands;
+    if (slot.grouped)
+    {
+        commands << "mc_node_update " << slot.node << ports.str() << std::endl;
+        RunCommands(commands.str());
+    }
+    else
+    {
+        // The group gets its node before the slot uses it
+        commands << "mc_mgrp_create " << group << std::endl
+                 << "mc_node_create " << m_rid << ports.str() << std::endl;
+        std::string output = RunCommands(commands.str());
+        const std::string created = "node was created with handle ";
+        size_t pos = output.find(created);
+        NS_ABORT_MSG_IF(pos == std::string::npos, "No node created for slot " << slotIdx);
+        slot.node = std::stoul(output.substr(pos + created.size()));
+
+        std::ostringstream associate;
+        associate << "mc_node_associate " << group << " " << slot.node << std::endl;
+        RunCommands(associate.str());
+        WriteRegister(m_spreader, "flow_mcast_grp", slotIdx, group);
+        slot.grouped = true;
+    }
+
+    NS_LOG_DEBUG("Slot " << slotIdx << " replicates on " << paths.size() << " of "
+                         << m_paths.size() << " paths");
+    m_selection_trace(slotIdx, paths);
+}
+
+void
+LiveLivePathSelector::Update()
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(!m_spreader || !m_merger, "Spreader and merger must be set");
+
+    uint32_t nPaths = m_paths.size();
+    if (m_slots.empty())
+    {
+        NS_ABORT_MSG_IF(m_first_group + (1U << m_flow_table_bits) - 1 > 0xffff,
+                        "The multicast groups of the slots do not fit in 16 bits");
+        m_slots.assign(1 << m_flow_table_bits,
+                       {0,
+                        std::vector<uint32_t>(nPaths, 0),
+                        std::vector<double>(nPaths, 0),
+                        std::vector<bool>(nPaths, true),
+                        false,
+                        0});
+    }
+
+    std::vector<uint64_t> delta(nPaths);
+    std::vector<uint32_t> order(nPaths);
+    std::vector<uint32_t> others;
+    std::vector<bool> selected(nPaths);
+    for (uint32_t slotIdx = 0; slotIdx < m_slots.size(); slotIdx++)
+    {
+        Slot& slot = m_slots[slotIdx];
+        uint32_t owner = ReadRegister(m_merger, "flow_owner", slotIdx);
+        if (owner == 0 && slot.owner == 0)
+        {
+            // Never used by a flow
+            continue;
+        }
+
+        // Only the replicating paths can deliver first copies
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < nPaths; i++)
+        {
+            delta[i] = 0;
+            if (!slot.selected[i])
+            {
+                continue;
+            }
+            uint32_t wins = ReadRegister(m_merger,
+                                         "path_wins",
+                                         (slotIdx << m_path_port_bits) | m_paths[i].mergerPort);
+            delta[i] = static_cast<uint32_t>(wins - slot.wins[i]);
+            slot.wins[i] = wins;
+            total += delta[i];
+        }
+
+        // A new flow, or a slot that delivered nothing, replicates on all the paths
+        if (owner != slot.owner || total == 0)
+        {
+            if (owner != slot.owner)
+            {
+                slot.owner = owner;
+                std::fill(slot.share.begin(), slot.share.end(), 0);
+            }
+            Select(slotIdx, std::vector<bool>(nPaths, true));
+            continue;
+        }
+
+        // Only the replicating paths were measured in this round
+        for (uint32_t i = 0; i < nPaths; i++)
+        {
+            if (slot.selected[i])
+            {
+                slot.share[i] = m_alpha * delta[i] / total + (1 - m_alpha) * slot.share[i];
+            }
+        }
+
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&slot](uint32_t a, uint32_t b) {
+            return slot.share[a] > slot.share[b];
+        });
+
+        std::fill(selected.begin(), selected.end(), false);
+        uint32_t active = std::min(m_active_paths, nPaths);
+        for (uint32_t i = 0; i < active; i++)
+        {
+            selected[order[i]] = true;
+        }
+        // The probed paths rotate over the others in path order, whatever their average
+        others.assign(order.begin() + active, order.end());
+        std::sort(others.begin(), others.end());
+        for (uint32_t i = 0; i < std::min<size_t>(m_probe_paths, others.size()); i++)
+        {
+            selected[others[(m_round * m_probe_paths + i) % others.size()]] = true;
+        }
+        Select(slotIdx, selected);
+    }
+
+    m_round++;
+}
+
+void
+LiveLivePathSelector::Run()
+{
+    Update();
+    m_event = Simulator::Schedule(m_interval, &LiveLivePathSelector::Run, this);
+}
+
+std::vector<uint32_t>
+LiveLivePathSelector::GetSelectedPaths(uint32_t slot) const
+{
+    std::vector<uint32_t> paths;
+    for (uint32_t i = 0; i < m_paths.size(); i++)
+    {
+        if (slot >= m_slots.size() || m_slots[slot].selected[i])
+        {
+            paths.push_back(i);
+        }
+    }
+    return paths;
+}
+
+} // namespace ns3
@@ -0,0 +1,217 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef LIVE_LIVE_PATH_SELECTOR_H
+#define LIVE_LIVE_PATH_SELECTOR_H
+
+#include "ns3/event-id.h"
+#include "ns3/net-device.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/traced-callback.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::LiveLivePathSelector declaration.
+ */
+
+namespace ns3
+{
+
+/**
+ * \ingroup p4-switch
+ * \brief replicates each Live-Live flow only on the paths that deliver it first
+ *
+ * The selector connects a spreader and a merger running srv6_livelive.p4, either as
+ * P4SwitchNetDevice or as LiveLiveNetDevice, with no table changes:
+ *
+ * - every Interval, it reads from the merger the first copies delivered by each replicating
+ *   path of each flow slot in use (path_wins) since the previous round, and updates an
+ *   exponentially weighted moving average of the share of the flow won by each of them;
+ * - it then keeps the ActivePaths paths with the highest average, plus ProbePaths of the
+ *   others in rotation so that their average stays current. The first time a slot leaves all
+ *   the paths, the selector gives it a multicast group of its own on the spreader
+ *   (FirstMulticastGroup + slot, with a node of ReplicationId) and sets it in flow_mcast_grp;
+ *   from then on only the ports of the node are updated. The spreader thus only replicates
+ *   the packets of the flow on the selected paths.
+ *
+ * A path that loses packets or is slower than the others wins fewer first copies, so the
+ * selection follows both loss and delay. Slots that deliver nothing in a round, e.g. because
+ * all the selected paths failed, replicate again on all the paths, and the averages of a slot
+ * are reset when the merger assigns it to a new flow.
+ *
+ * Both switches must be built with the same FLOW_TABLE_BITS and PATH_PORT_BITS, set in the
+ * FlowTableBits and PathPortBits attributes. ReplicationId must be the rid of the
+ * srv6_live_live_forward entry of the spreader, and the groups of the slots must not be used
+ * by the commands of the spreader.
+ */
+class LiveLivePathSelector : public Object
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * TracedCallback signature for the paths selected for a flow slot.
+     *
+     * \param [in] slot the flow slot
+     * \param [in] paths the indexes of the paths replicating the flow, in AddPath() order
+     */
+    typedef void (*SelectionTracedCallback)(uint32_t slot, const std::vector<uint32_t>& paths);
+
+    LiveLivePathSelector();
+    ~LiveLivePathSelector() override;
+
+    /**
+     * \brief Set the switch that replicates the flows
+     * \param spreader a P4SwitchNetDevice running srv6_livelive.p4, or a LiveLiveNetDevice
+     */
+    void SetSpreader(Ptr<NetDevice> spreader);
+
+    /**
+     * \brief Set the switch that deduplicates the flows
+     * \param merger a P4SwitchNetDevice running srv6_livelive.p4, or a LiveLiveNetDevice
+     */
+    void SetMerger(Ptr<NetDevice> merger);
+
+    /**
+     * \brief Add a path between the spreader and the merger
+     * \param spreaderPort the port of the spreader where the replicas of the path are sent
+     * \param mergerPort the port of the merger where the path arrives
+     */
+    void AddPath(uint32_t spreaderPort, uint32_t mergerPort);
+
+    /**
+     * \brief Start the periodic selection
+     * \param delay when to run the first round
+     */
+    void Start(Time delay);
+
+    /**
+     * \brief Stop the periodic selection, the paths disabled so far stay disabled
+     */
+    void Stop();
+
+    /**
+     * \brief Run a selection round now, independently of the periodic ones
+     */
+    void Update();
+
+    /**
+     * \brief Get the paths replicating the flow of a slot
+     * \param slot the flow slot
+     * \return the indexes of the paths, in AddPath() order
+     */
+    std::vector<uint32_t> GetSelectedPaths(uint32_t slot) const;
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * \brief Run a selection round and schedule the next one
+     */
+    void Run();
+
+    /**
+     * A path between the spreader and the merger
+     */
+    struct Path
+    {
+        uint32_t spreaderPort; //!< Egress port of the spreader
+        uint32_t mergerPort;   //!< Ingress port of the merger
+    };
+
+    /**
+     * Selection state of a flow slot
+     */
+    struct Slot
+    {
+        uint32_t owner;             //!< Flow id owning the slot on the merger, 0 if none
+        std::vector<uint32_t> wins; //!< path_wins read in the previous round, by path
+        std::vector<double> share;  //!< Average share of the first copies, by path
+        std::vector<bool> selected; //!< Whether the path replicates the flow, by path
+        bool grouped;               //!< Whether the slot has its multicast group
+        uint32_t node;              //!< Multicast node of the group of the slot
+    };
+
+    /**
+     * \brief Read a register of a switch
+     * \param device the switch
+     * \param name the register name
+     * \param index the cell
+     * \return the value of the cell, the simulation aborts if it cannot be read
+     */
+    uint64_t ReadRegister(Ptr<NetDevice> device, const std::string& name, uint32_t index);
+
+    /**
+     * \brief Write a register of a switch
+     * \param device the switch
+     * \param name the register name
+     * \param index the cell
+     * \param value the value
+     */
+    void WriteRegister(Ptr<NetDevice> device,
+                       const std::string& name,
+                       uint32_t index,
+                       uint64_t value);
+
+    /**
+     * \brief Run commands on the spreader
+     * \param commands the commands, one per line
+     * \return the output of the commands, the simulation aborts if one fails
+     */
+    std::string RunCommands(const std::string& commands);
+
+    /**
+     * \brief Set the ports of the multicast group of a slot, creating it on first use
+     * \param slotIdx the flow slot
+     * \param selected whether each path replicates the flow
+     */
+    void Select(uint32_t slotIdx, const std::vector<bool>& selected);
+
+    Ptr<NetDevice> m_spreader; //!< Switch replicating the flows
+    Ptr<NetDevice> m_merger;   //!< Switch deduplicating the flows
+    std::vector<Path> m_paths; //!< Paths, in AddPath() order
+    std::vector<Slot> m_slots; //!< State of the flow slots, sized on the first round
+
+    Time m_interval;            //!< Time between rounds
+    uint32_t m_active_paths;    //!< Paths kept for each flow
+    uint32_t m_probe_paths;     //!< Other paths replicating each flow in rotation
+    double m_alpha;             //!< Weight of the last round in the averages
+    uint32_t m_flow_table_bits; //!< log2 of the flow slots, as FLOW_TABLE_BITS
+    uint32_t m_path_port_bits;  //!< log2 of the ports with per-path state, as PATH_PORT_BITS
+    uint32_t m_first_group;     //!< Multicast group of slot 0
+    uint16_t m_rid;             //!< Replication id of the nodes of the groups
+    uint32_t m_round;           //!< Rounds run so far, rotates the probed paths
+    EventId m_event;            //!< Next round
+
+    TracedCallback<uint32_t, const std::vector<uint32_t>&>
+        m_selection_trace; //!< Paths of a slot, when they change
+};
+
+} // namespace ns3
+
+#endif /* LIVE_LIVE_PATH_SELECTOR_H */
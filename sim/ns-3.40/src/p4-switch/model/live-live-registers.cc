@@ -0,0 +1,80 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "live-live-registers.h"
+
+#include "live-live-net-device.h"
+#include "p4-switch-net-device.h"
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * Register and multicast access to the switches running srv6_livelive.p4, implementation.
+ */
+
+namespace ns3
+{
+
+bool
+LiveLiveRegisterRead(Ptr<NetDevice> device,
+                     const std::string& name,
+                     uint32_t index,
+                     uint64_t& value)
+{
+    if (Ptr<P4SwitchNetDevice> p4Device = DynamicCast<P4SwitchNetDevice>(device))
+    {
+        return p4Device->RegisterRead(name, index, value);
+    }
+    if (Ptr<LiveLiveNetDevice> llDevice = DynamicCast<LiveLiveNetDevice>(device))
+    {
+        return llDevice->RegisterRead(name, index, value);
+    }
+    return false;
+}
+
+bool
+LiveLiveRegisterWrite(Ptr<NetDevice> device,
+                      const std::string& name,
+                      uint32_t index,
+                      uint64_t value)
+{
+    if (Ptr<P4SwitchNetDevice> p4Device = DynamicCast<P4SwitchNetDevice>(device))
+    {
+        return p4Device->RegisterWrite(name, index, value);
+    }
+    if (Ptr<LiveLiveNetDevice> llDevice = DynamicCast<LiveLiveNetDevice>(device))
+    {
+        return llDevice->RegisterWrite(name, index, value);
+    }
+    return false;
+}
+
+std::string
+LiveLiveRunCommands(Ptr<NetDevice> device, const std::string& commands)
+{
+    if (Ptr<P4SwitchNetDevice> p4Device = DynamicCast<P4SwitchNetDevice>(device))
+    {
+        return p4Device->RunPipelineCommands(commands);
+    }
+    if (Ptr<LiveLiveNetDevice> llDevice = DynamicCast<LiveLiveNetDevice>(device))
+    {
+        return llDevice->RunPipelineCommands(commands);
+    }
+    return "";
+}
+
+} // namespace ns3
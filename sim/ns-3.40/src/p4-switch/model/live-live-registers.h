@@ -0,0 +1,76 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef LIVE_LIVE_REGISTERS_H
+#define LIVE_LIVE_REGISTERS_H
+
+#include "ns3/net-device.h"
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * Register and multicast access to the switches running srv6_livelive.p4.
+ */
+
+namespace ns3
+{
+
+/**
+ * \ingroup p4-switch
+ * \brief Read a register cell of a switch running srv6_livelive.p4
+ * \param device a P4SwitchNetDevice or a LiveLiveNetDevice
+ * \param name the register name, can be abbreviated to any unique suffix
+ * \param index the cell
+ * \param value set to the value of the cell
+ * \return false if the device is not a switch, the register does not exist or the index is out
+ *         of range
+ */
+bool LiveLiveRegisterRead(Ptr<NetDevice> device,
+                          const std::string& name,
+                          uint32_t index,
+                          uint64_t& value);
+
+/**
+ * \ingroup p4-switch
+ * \brief Write a register cell of a switch running srv6_livelive.p4
+ * \param device a P4SwitchNetDevice or a LiveLiveNetDevice
+ * \param name the register name, can be abbreviated to any unique suffix
+ * \param index the cell
+ * \param value the value
+ * \return false if the device is not a switch, the register does not exist or the index is out
+ *         of range
+ */
+bool LiveLiveRegisterWrite(Ptr<NetDevice> device,
+                           const std::string& name,
+                           uint32_t index,
+                           uint64_t value);
+
+/**
+ * \ingroup p4-switch
+ * \brief Run simple_switch_CLI commands on a switch running srv6_livelive.p4
+ * \param device a P4SwitchNetDevice or a LiveLiveNetDevice
+ * \param commands the commands, one per line
+ * \return the output of the commands, empty if the device is not a switch
+ */
+std::string LiveLiveRunCommands(Ptr<NetDevice> device, const std::string& commands);
+
+} // namespace ns3
+
+#endif /* LIVE_LIVE_REGISTERS_H */
@@ -0,0 +1,147 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "live-live-tlv-header.h"
+
+#include "ns3/log.h"
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::LiveLiveTlvHeader implementation.
+ */
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("LiveLiveTlvHeader");
+
+NS_OBJECT_ENSURE_REGISTERED(LiveLiveTlvHeader);
+
+TypeId
+LiveLiveTlvHeader::GetTypeId()
+{
+    static TypeId tid = TypeId("ns3::LiveLiveTlvHeader")
+                            .SetParent<Header>()
+                            .SetGroupName("P4Switch")
+                            .AddConstructor<LiveLiveTlvHeader>();
+    return tid;
+}
+
+TypeId
+LiveLiveTlvHeader::GetInstanceTypeId() const
+{
+    return GetTypeId();
+}
+
+LiveLiveTlvHeader::LiveLiveTlvHeader()
+    : m_type(TLV_TYPE),
+      m_length(TLV_LENGTH),
+      m_seqN(0),
+      m_flowId(0)
+{
+}
+
+LiveLiveTlvHeader::~LiveLiveTlvHeader()
+{
+}
+
+void
+LiveLiveTlvHeader::SetType(uint8_t type)
+{
+    m_type = type;
+}
+
+uint8_t
+LiveLiveTlvHeader::GetType() const
+{
+    return m_type;
+}
+
+void
+LiveLiveTlvHeader::SetLength(uint8_t length)
+{
+    m_length = length;
+}
+
+uint8_t
+LiveLiveTlvHeader::GetLength() const
+{
+    return m_length;
+}
+
+void
+LiveLiveTlvHeader::SetSeqN(uint16_t seqN)
+{
+    m_seqN = seqN;
+}
+
+uint16_t
+LiveLiveTlvHeader::GetSeqN() const
+{
+    return m_seqN;
+}
+
+void
+LiveLiveTlvHeader::SetFlowId(uint32_t flowId)
+{
+    m_flowId = flowId;
+}
+
+uint32_t
+LiveLiveTlvHeader::GetFlowId() const
+{
+    return m_flowId;
+}
+
+void
+LiveLiveTlvHeader::Print(std::ostream& os) const
+{
+    os << "type=" << (uint32_t)m_type << ", length=" << (uint32_t)m_length << ", seq_n=" << m_seqN
+       << ", flow_id=" << m_flowId;
+}
+
+uint32_t
+LiveLiveTlvHeader::GetSerializedSize() const
+{
+    return 8;
+}
+
+void
+LiveLiveTlvHeader::Serialize(Buffer::Iterator start) const
+{
+    Buffer::Iterator i = start;
+
+    i.WriteU8(m_type);
+    i.WriteU8(m_length);
+    i.WriteHtonU16(m_seqN);
+    i.WriteHtonU32(m_flowId);
+}
+
+uint32_t
+LiveLiveTlvHeader::Deserialize(Buffer::Iterator start)
+{
+    Buffer::Iterator i = start;
+
+    m_type = i.ReadU8();
+    m_length = i.ReadU8();
+    m_seqN = i.ReadNtohU16();
+    m_flowId = i.ReadNtohU32();
+
+    return GetSerializedSize();
+}
+
+} // namespace ns3
@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef LIVE_LIVE_TLV_HEADER_H
+#define LIVE_LIVE_TLV_HEADER_H
+
+#include "ns3/header.h"
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::LiveLiveTlvHeader declaration.
+ */
+
+namespace ns3
+{
+
+/**
+ * \ingroup p4-switch
+ * \brief The Live-Live SRH TLV (srv6_ll_tlv_h)
+ *
+ * Carries the sequence number and the flow id used by the merger to deduplicate
+ * the copies of a packet received from different paths.
+ */
+class LiveLiveTlvHeader : public Header
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+    TypeId GetInstanceTypeId() const override;
+
+    LiveLiveTlvHeader();
+    ~LiveLiveTlvHeader() override;
+
+    static constexpr uint8_t TLV_TYPE = 0xff; //!< TLV type used by the P4 programs
+    static constexpr uint8_t TLV_LENGTH = 6;  //!< TLV length, excluding type and length
+
+    void SetType(uint8_t type);
+    uint8_t GetType() const;
+    void SetLength(uint8_t length);
+    uint8_t GetLength() const;
+    void SetSeqN(uint16_t seqN);
+    uint16_t GetSeqN() const;
+    void SetFlowId(uint32_t flowId);
+    uint32_t GetFlowId() const;
+
+    void Print(std::ostream& os) const override;
+    uint32_t GetSerializedSize() const override;
+    void Serialize(Buffer::Iterator start) const override;
+    uint32_t Deserialize(Buffer::Iterator start) override;
+
+  private:
+    uint8_t m_type;    //!< TLV type
+    uint8_t m_length;  //!< TLV length
+    uint16_t m_seqN;   //!< Sequence number
+    uint32_t m_flowId; //!< Flow id
+};
+
+} // namespace ns3
+
+#endif /* LIVE_LIVE_TLV_HEADER_H */
@@ -0,0 +1,171 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "p4-event-sink.h"
+
+#include "ns3/log.h"
+
+#include <algorithm>
+#include <chrono>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::P4EventSink implementation.
+ */
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("P4EventSink");
+
+P4EventSink::P4EventSink(const std::string& path, uint32_t capacity)
+    : m_head(0),
+      m_tail(0),
+      m_closing(false)
+{
+    NS_LOG_FUNCTION(this << path << capacity);
+
+    uint64_t size = 16;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    m_ring.resize(size);
+    m_mask = size - 1;
+    m_chunkMask = size / 4 - 1;
+
+    m_file = std::fopen(path.c_str(), "wb");
+    if (m_file == nullptr)
+    {
+        NS_LOG_ERROR("Cannot open event file " << path);
+        m_closing = true;
+        return;
+    }
+
+    uint32_t version = VERSION;
+    std::fwrite("P4EV", 1, 4, m_file);
+    std::fwrite(&version, sizeof(version), 1, m_file);
+
+    m_flusher = std::thread(&P4EventSink::FlushLoop, this);
+}
+
+P4EventSink::~P4EventSink()
+{
+    Close();
+}
+
+bool
+P4EventSink::IsOpen() const
+{
+    return m_file != nullptr;
+}
+
+uint64_t
+P4EventSink::GetEvents() const
+{
+    return m_head.load(std::memory_order_acquire);
+}
+
+void
+P4EventSink::Close()
+{
+    NS_LOG_FUNCTION(this);
+
+    if (!m_flusher.joinable())
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_flush.notify_one();
+    m_flusher.join();
+
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void
+P4EventSink::WaitForSpace(uint64_t head)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_closing)
+    {
+        // Closed, or the file could not be opened: drop the oldest events
+        m_tail.store(head + 1 - m_ring.size(), std::memory_order_release);
+        return;
+    }
+    m_flush.notify_one();
+    m_space.wait(lock, [this, head]() {
+        return head - m_tail.load(std::memory_order_acquire) < m_ring.size();
+    });
+}
+
+void
+P4EventSink::WakeFlusher()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_flush.notify_one();
+}
+
+void
+P4EventSink::FlushLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        // The timeout bounds how stale the file is when events are rare
+        m_flush.wait_for(lock, std::chrono::milliseconds(100), [this]() {
+            return m_closing || m_head.load(std::memory_order_acquire) -
+                                        m_tail.load(std::memory_order_relaxed) >
+                                    m_chunkMask;
+        });
+        bool closing = m_closing;
+
+        lock.unlock();
+        Write();
+        lock.lock();
+
+        m_space.notify_one();
+        if (closing)
+        {
+            break;
+        }
+    }
+    std::fflush(m_file);
+}
+
+void
+P4EventSink::Write()
+{
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    uint64_t head = m_head.load(std::memory_order_acquire);
+
+    while (tail != head)
+    {
+        // Write up to the end of the ring, then wrap around
+        uint64_t start = tail & m_mask;
+        uint64_t count = std::min(head - tail, m_ring.size() - start);
+        std::fwrite(&m_ring[start], sizeof(Record), count, m_file);
+        tail += count;
+    }
+    m_tail.store(tail, std::memory_order_release);
+}
+
+} // namespace ns3
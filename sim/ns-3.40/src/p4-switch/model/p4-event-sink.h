@@ -0,0 +1,155 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef P4_EVENT_SINK_H
+#define P4_EVENT_SINK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::P4EventSink declaration.
+ */
+
+namespace ns3
+{
+
+/**
+ * \ingroup p4-switch
+ * \brief Binary log of per-packet events, written by a background thread
+ *
+ * This replaces log_msg() calls scraped from the console for per-packet analyses (e.g. the
+ * Live-Live sequence numbers seen on each port). Events are stored in a preallocated ring and
+ * written to the file in large chunks by a flusher thread, so recording an event costs a few
+ * stores and no string formatting. When the ring is full, the producer waits for the flusher
+ * rather than losing events.
+ *
+ * The file starts with the 4-byte magic "P4EV" and a 32-bit version, followed by one
+ * 16-byte Record per event, in host byte order. There must be a single producer thread at
+ * a time.
+ */
+class P4EventSink
+{
+  public:
+    /**
+     * An event, as written to the file
+     */
+    struct Record
+    {
+        uint64_t timestamp; //!< Simulation time, in nanoseconds
+        uint32_t value;     //!< Recorded field value (e.g. a sequence number)
+        uint32_t port;      //!< Ingress port
+    };
+
+    static_assert(sizeof(Record) == 16, "Records are written as 16-byte blocks");
+
+    static constexpr uint32_t VERSION = 1; //!< File format version
+
+    /**
+     * \brief Open the file and start the flusher thread
+     * \param path the file to write
+     * \param capacity the number of records of the ring, rounded up to a power of two
+     */
+    P4EventSink(const std::string& path, uint32_t capacity = 1 << 16);
+    ~P4EventSink();
+
+    P4EventSink(const P4EventSink&) = delete;
+    P4EventSink& operator=(const P4EventSink&) = delete;
+
+    /**
+     * \return whether the file could be opened
+     */
+    bool IsOpen() const;
+
+    /**
+     * \brief Record an event
+     * \param timestamp the simulation time, in nanoseconds
+     * \param value the recorded value
+     * \param port the ingress port
+     */
+    void Add(uint64_t timestamp, uint32_t value, uint32_t port)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) == m_ring.size())
+        {
+            WaitForSpace(head);
+        }
+        m_ring[head & m_mask] = {timestamp, value, port};
+        m_head.store(head + 1, std::memory_order_release);
+        if (((head + 1) & m_chunkMask) == 0)
+        {
+            WakeFlusher();
+        }
+    }
+
+    /**
+     * \brief Write the pending events, stop the flusher and close the file
+     */
+    void Close();
+
+    /**
+     * \return the number of events recorded so far
+     */
+    uint64_t GetEvents() const;
+
+  private:
+    /**
+     * \brief Wait until the flusher frees a slot of the ring
+     * \param head the index of the event to store
+     */
+    void WaitForSpace(uint64_t head);
+
+    /**
+     * \brief Ask the flusher to write the pending events
+     */
+    void WakeFlusher();
+
+    /**
+     * \brief Main loop of the flusher thread
+     */
+    void FlushLoop();
+
+    /**
+     * \brief Write the events published so far
+     */
+    void Write();
+
+    std::vector<Record> m_ring;   //!< Preallocated events
+    uint64_t m_mask;              //!< Ring index mask
+    uint64_t m_chunkMask;         //!< The flusher is woken every (m_chunkMask + 1) events
+    std::atomic<uint64_t> m_head; //!< Events recorded, written by the producer
+    std::atomic<uint64_t> m_tail; //!< Events written, updated by the flusher
+
+    std::FILE* m_file;               //!< Output file
+    std::thread m_flusher;           //!< Flusher thread
+    std::mutex m_mutex;              //!< Protects m_closing and the waits below
+    std::condition_variable m_flush; //!< Signals the flusher that events are pending
+    std::condition_variable m_space; //!< Signals the producer that slots were freed
+    bool m_closing;                  //!< Whether the flusher must exit
+};
+
+} // namespace ns3
+
+#endif /* P4_EVENT_SINK_H */
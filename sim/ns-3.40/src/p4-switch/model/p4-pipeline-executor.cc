@@ -0,0 +1,185 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "p4-pipeline-executor.h"
+
+#include "ns3/global-value.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+
+#include <memory>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::P4PipelineExecutor implementation.
+ */
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("P4PipelineExecutor");
+
+/**
+ * \relates P4PipelineExecutor
+ * The number of threads running P4 pipelines, including the simulation one.
+ *
+ * This is accessible as "--P4WorkerThreads" from CommandLine.
+ */
+static GlobalValue g_p4WorkerThreads("P4WorkerThreads",
+                                     "Number of threads running the P4 pipelines of different "
+                                     "switches in parallel, 0 runs them inline",
+                                     UintegerValue(0),
+                                     MakeUintegerChecker<uint32_t>());
+
+P4PipelineExecutor*
+P4PipelineExecutor::Get()
+{
+    static std::unique_ptr<P4PipelineExecutor> executor;
+    static bool initialized = false;
+    if (!initialized)
+    {
+        initialized = true;
+        UintegerValue n_threads;
+        g_p4WorkerThreads.GetValue(n_threads);
+        if (n_threads.Get() > 0)
+        {
+            executor.reset(new P4PipelineExecutor(n_threads.Get()));
+        }
+    }
+    return executor.get();
+}
+
+P4PipelineExecutor::P4PipelineExecutor(uint32_t n_threads)
+    : m_nThreads(n_threads),
+      m_round(0),
+      m_busy(0),
+      m_stop(false)
+{
+    NS_LOG_FUNCTION(this << n_threads);
+    // Thread 0 is the simulation thread
+    for (uint32_t i = 1; i < m_nThreads; i++)
+    {
+        m_workers.emplace_back(&P4PipelineExecutor::WorkerLoop, this, i);
+    }
+}
+
+P4PipelineExecutor::~P4PipelineExecutor()
+{
+    NS_LOG_FUNCTION(this);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_start.notify_all();
+    for (auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void
+P4PipelineExecutor::Submit(Job job)
+{
+    m_pending.push_back(std::move(job));
+    if (!m_flushEvent.IsRunning())
+    {
+        // Runs after the events already scheduled for now, e.g. other switches receiving
+        m_flushEvent = Simulator::ScheduleNow(&P4PipelineExecutor::Flush, this);
+    }
+}
+
+void
+P4PipelineExecutor::Flush()
+{
+    // Jobs submitted while finishing this round (e.g. by a switch receiving from another one
+    // through a zero delay channel) go to the next round
+    m_running.swap(m_pending);
+    m_pending.clear();
+
+    NS_LOG_LOGIC("Running " << m_running.size() << " P4 pipeline jobs");
+
+    for (auto& job : m_running)
+    {
+        job.prepare();
+    }
+
+    if (m_running.size() == 1 || m_workers.empty())
+    {
+        for (auto& job : m_running)
+        {
+            job.run();
+        }
+    }
+    else
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_round++;
+            m_busy = m_workers.size();
+        }
+        m_start.notify_all();
+
+        RunJobs(0);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_busy == 0; });
+    }
+
+    for (auto& job : m_running)
+    {
+        job.finish();
+    }
+    m_running.clear();
+}
+
+void
+P4PipelineExecutor::RunJobs(uint32_t thread)
+{
+    for (size_t i = thread; i < m_running.size(); i += m_nThreads)
+    {
+        m_running[i].run();
+    }
+}
+
+void
+P4PipelineExecutor::WorkerLoop(uint32_t thread)
+{
+    uint64_t round = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this, round] { return m_stop || m_round != round; });
+            if (m_stop)
+            {
+                return;
+            }
+            round = m_round;
+        }
+
+        RunJobs(thread);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busy--;
+        }
+        m_done.notify_one();
+    }
+}
+
+} // namespace ns3
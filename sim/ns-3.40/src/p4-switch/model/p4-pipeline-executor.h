@@ -0,0 +1,120 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef P4_PIPELINE_EXECUTOR_H
+#define P4_PIPELINE_EXECUTOR_H
+
+#include "ns3/event-id.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::P4PipelineExecutor declaration.
+ */
+
+namespace ns3
+{
+
+/**
+ * \ingroup p4-switch
+ * \brief Runs the P4 pipelines of different switches in parallel
+ *
+ * Switches submit a job when they have packets to process. All the jobs submitted at the
+ * same simulation time are run together in a single event, scheduled after the events that
+ * were already pending for that time. Each job has three parts:
+ * - prepare, run in submission order on the simulation thread (e.g. ns-3 to bmv2 packets);
+ * - run, spread over the worker threads, which must not touch any ns-3 object;
+ * - finish, run in submission order on the simulation thread once all jobs ran (e.g. sending
+ *   the output packets).
+ *
+ * Jobs are statically assigned to threads in submission order, so the outcome does not depend
+ * on thread scheduling. The number of threads is set with the "P4WorkerThreads" global value,
+ * 0 (the default) disables the executor and pipelines run inline.
+ */
+class P4PipelineExecutor
+{
+  public:
+    /**
+     * A unit of work submitted by a switch
+     */
+    struct Job
+    {
+        std::function<void()> prepare; //!< Run on the simulation thread, before run
+        std::function<void()> run;     //!< Run on a worker thread
+        std::function<void()> finish;  //!< Run on the simulation thread, after all jobs ran
+    };
+
+    /**
+     * \return the executor, or nullptr if P4WorkerThreads is 0
+     */
+    static P4PipelineExecutor* Get();
+
+    /**
+     * \brief Submit a job, to be run at the current simulation time
+     * \param job the job
+     */
+    void Submit(Job job);
+
+    ~P4PipelineExecutor();
+
+  private:
+    /**
+     * \brief Start the worker threads
+     * \param n_threads the total number of threads, including the simulation one
+     */
+    P4PipelineExecutor(uint32_t n_threads);
+
+    /**
+     * \brief Run all the submitted jobs
+     */
+    void Flush();
+
+    /**
+     * \brief Run the jobs assigned to a thread in the current round
+     * \param thread the thread index
+     */
+    void RunJobs(uint32_t thread);
+
+    /**
+     * \brief Main loop of a worker thread
+     * \param thread the thread index
+     */
+    void WorkerLoop(uint32_t thread);
+
+    uint32_t m_nThreads;                //!< Number of threads, including the simulation one
+    std::vector<std::thread> m_workers; //!< Worker threads
+    std::vector<Job> m_pending;         //!< Jobs submitted for the next round
+    std::vector<Job> m_running;         //!< Jobs of the current round
+    EventId m_flushEvent;               //!< Event running the next round
+
+    std::mutex m_mutex;              //!< Protects the round state below
+    std::condition_variable m_start; //!< Signals the workers that a round started
+    std::condition_variable m_done;  //!< Signals the simulation thread that a worker finished
+    uint64_t m_round;                //!< Current round number
+    uint32_t m_busy;                 //!< Workers still running jobs of the current round
+    bool m_stop;                     //!< Whether the workers must exit
+};
+
+} // namespace ns3
+
+#endif /* P4_PIPELINE_EXECUTOR_H */
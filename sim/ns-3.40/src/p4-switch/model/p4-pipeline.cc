@@ -20,29 +20,39 @@
  */
 #include "p4-pipeline.h"
 
-#include "ns3/ethernet-header.h"
-#include "ns3/ipv4-header.h"
-#include "ns3/ipv6-header.h"
+#include "register_access.h"
+
 #include "ns3/log.h"
-#include "ns3/tcp-header.h"
-#include "ns3/udp-header.h"
 
 #include <bm/bm_runtime/bm_runtime.h>
 #include <bm/bm_sim/event_logger.h>
 #include <bm/bm_sim/logger.h>
+#include <bm/bm_sim/lookup_structures.h>
 #include <bm/bm_sim/options_parse.h>
 #include <bm/bm_sim/parser.h>
 #include <bm/bm_sim/tables.h>
+#include <bm/bm_sim/transport.h>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <unordered_map>
 
 extern int import_primitives();
 
 namespace ns3
 {
+NS_LOG_COMPONENT_DEFINE("P4Pipeline");
 
 namespace
 {
@@ -74,342 +84,2818 @@ struct bmv2_hash
     }
 };
 
-} // namespace
-
-// if REGISTER_HASH calls placed in the anonymous namespace, some compiler can
-// give an unused variable warning
-REGISTER_HASH(hash_ex);
-REGISTER_HASH(bmv2_hash);
-
-// initialize static attributes
-int P4Pipeline::thrift_port = 9090;
-bm::packet_id_t P4Pipeline::packet_id = 0;
-uint8_t P4Pipeline::ns2bm_buf[MAX_PKT_SIZE] = {};
-
-P4Pipeline::P4Pipeline(std::string jsonFile, std::string name)
-    : pre(new bm::McSimplePreLAG())
+/**
+ * Convert a CLI value to a big-endian byte string of (bitwidth + 7) / 8 bytes.
+ * Like parse_param in bmv2's runtime_CLI, 32, 48 and 128 bit values can also be
+ * given as IPv4, MAC and IPv6 addresses respectively.
+ */
+bool
+parse_param(const std::string& str, uint32_t bitwidth, std::string& bytes)
 {
-    add_component<bm::McSimplePreLAG>(pre);
-
-    // Fields taken from simple_switch
-    add_required_field("standard_metadata", "ingress_port");
-    add_required_field("standard_metadata", "packet_length");
-    add_required_field("standard_metadata", "instance_type");
-    add_required_field("standard_metadata", "egress_spec");
-    add_required_field("standard_metadata", "egress_port");
-
-    force_arith_header("standard_metadata");
-    force_arith_header("queueing_metadata");
-    force_arith_header("intrinsic_metadata");
+    size_t nbytes = (bitwidth + 7) / 8;
 
-    import_primitives();
+    if (bitwidth == 32)
+    {
+        struct in_addr addr;
+        if (inet_pton(AF_INET, str.c_str(), &addr) == 1)
+        {
+            bytes.assign(reinterpret_cast<const char*>(&addr), 4);
+            return true;
+        }
+    }
+    else if (bitwidth == 48)
+    {
+        unsigned int mac[6];
+        char end;
+        if (sscanf(str.c_str(),
+                   "%2x:%2x:%2x:%2x:%2x:%2x%c",
+                   &mac[0],
+                   &mac[1],
+                   &mac[2],
+                   &mac[3],
+                   &mac[4],
+                   &mac[5],
+                   &end) == 6)
+        {
+            bytes.clear();
+            for (unsigned int b : mac)
+            {
+                bytes.push_back(static_cast<char>(b));
+            }
+            return true;
+        }
+    }
+    else if (bitwidth == 128)
+    {
+        struct in6_addr addr;
+        if (inet_pton(AF_INET6, str.c_str(), &addr) == 1)
+        {
+            bytes.assign(reinterpret_cast<const char*>(&addr), 16);
+            return true;
+        }
+    }
 
-    std::string node_id = (name.empty()) ? std::to_string(thrift_port) : name;
+    // Integer with an optional base prefix, as Python's int(str, 0)
+    size_t pos = 0;
+    unsigned int base = 10;
+    if (str.size() > 2 && str[0] == '0')
+    {
+        char prefix = std::tolower(str[1]);
+        base = (prefix == 'x') ? 16 : (prefix == 'o') ? 8 : (prefix == 'b') ? 2 : 10;
+        pos = (base == 10) ? 0 : 2;
+    }
+    if (pos >= str.size())
+    {
+        return false;
+    }
 
-    // Initialize the switch
-    bm::OptionsParser opt_parser;
-    opt_parser.config_file_path = jsonFile;
-    opt_parser.debugger_addr =
-        std::string("ipc:///tmp/bmv2-") + node_id + std::string("-debug.ipc");
-    opt_parser.notifications_addr =
-        std::string("ipc:///tmp/bmv2-") + node_id + std::string("-notifications.ipc");
-    opt_parser.thrift_port = thrift_port++;
-    opt_parser.console_logging = true;
-    opt_parser.log_level = bm::Logger::LogLevel::INFO;
-
-    int status = init_from_options_parser(opt_parser);
-    if (status != 0)
+    bytes.assign(nbytes, '\0');
+    for (; pos < str.size(); pos++)
     {
-        BMLOG_DEBUG("Failed to initialize the P4 pipeline");
-        std::exit(status);
+        char c = std::tolower(str[pos]);
+        unsigned int digit;
+        if (c >= '0' && c <= '9')
+        {
+            digit = c - '0';
+        }
+        else if (c >= 'a' && c <= 'f')
+        {
+            digit = c - 'a' + 10;
+        }
+        else
+        {
+            return false;
+        }
+        if (digit >= base)
+        {
+            return false;
+        }
+
+        unsigned int carry = digit;
+        for (size_t i = nbytes; i-- > 0;)
+        {
+            unsigned int v = static_cast<uint8_t>(bytes[i]) * base + carry;
+            bytes[i] = static_cast<char>(v & 0xff);
+            carry = v >> 8;
+        }
+        if (carry != 0)
+        {
+            // Value does not fit
+            return false;
+        }
     }
 
-    int port = get_runtime_port();
-    bm_runtime::start_server(this, port);
-    start_and_return();
+    return true;
 }
 
-std::string
-P4Pipeline::run_cli_commands(std::string commands)
+std::vector<std::string>
+split_tokens(const std::string& line)
 {
-    // Run the CLI commands to populate table entries
-    int port = get_runtime_port();
-    std::string cmd =
-        "run_bmv2_CLI --thrift_port " + std::to_string(port) + " \"" + commands + "\"";
-
-    std::string result = "";
-
-    std::shared_ptr<FILE> pipe(popen(cmd.c_str(), "r"), pclose);
-    if (!pipe)
-        return result;
-
-    char buffer[128];
-    while (!feof(pipe.get()))
+    std::vector<std::string> tokens;
+    std::istringstream iss(line);
+    std::string token;
+    while (iss >> token)
     {
-        if (fgets(buffer, 128, pipe.get()) != NULL)
-            result += buffer;
+        tokens.push_back(token);
     }
-
-    return result;
+    return tokens;
 }
 
-void
-P4Pipeline::start_and_return_()
+bool
+parse_uint(const std::string& str, uint64_t& value)
 {
+    if (str.empty())
+    {
+        return false;
+    }
+    char* end = nullptr;
+    value = std::strtoull(str.c_str(), &end, 0);
+    return *end == '\0';
 }
 
-int
-P4Pipeline::receive_(bm::DevMgr::port_t, const char* buffer, int len)
+std::string
+match_error_to_string(bm::MatchErrorCode rc)
 {
-    return 0;
+    switch (rc)
+    {
+    case bm::MatchErrorCode::TABLE_FULL:
+        return "TABLE_FULL";
+    case bm::MatchErrorCode::INVALID_HANDLE:
+        return "INVALID_HANDLE";
+    case bm::MatchErrorCode::INVALID_TABLE_NAME:
+        return "INVALID_TABLE_NAME";
+    case bm::MatchErrorCode::INVALID_ACTION_NAME:
+        return "INVALID_ACTION_NAME";
+    case bm::MatchErrorCode::DUPLICATE_ENTRY:
+        return "DUPLICATE_ENTRY";
+    case bm::MatchErrorCode::BAD_MATCH_KEY:
+        return "BAD_MATCH_KEY";
+    case bm::MatchErrorCode::BAD_ACTION_DATA:
+        return "BAD_ACTION_DATA";
+    default:
+        return "ERROR " + std::to_string(static_cast<int>(rc));
+    }
 }
 
-std::list<std::pair<uint16_t, Ptr<Packet>>>*
-P4Pipeline::process(Ptr<const Packet> ns3_packet, uint32_t ingress_port)
+/**
+ * Table snapshot file layout, all integers in host byte order:
+ *   "P4TS" u32:version u32:n_tables
+ *   per table: str:name u8:has_default [str:action u32:n_params str:param...]
+ *              u32:n_entries u32:n_key_fields
+ *   per entry: str:action i32:priority
+ *              per key field: u8:type str:key str:mask i32:prefix_length
+ *              u32:n_params str:param...
+ * where str is u32:length followed by the bytes.
+ */
+const char SNAPSHOT_MAGIC[4] = {'P', '4', 'T', 'S'};
+const uint32_t SNAPSHOT_VERSION = 1;
+
+/**
+ * Append-only encoder of a table snapshot
+ */
+struct snapshot_writer
 {
-    bm::Parser* parser = this->get_parser("parser");
-    bm::Deparser* deparser = this->get_deparser("deparser");
+    std::string buffer;
 
-    std::list<std::pair<uint16_t, std::unique_ptr<bm::Packet>>>* pkts_to_egress =
-        new std::list<std::pair<uint16_t, std::unique_ptr<bm::Packet>>>();
-    std::list<std::pair<uint16_t, Ptr<Packet>>>* output_pkts =
-        new std::list<std::pair<uint16_t, Ptr<Packet>>>();
+    void put_u8(uint8_t value)
+    {
+        buffer.push_back(static_cast<char>(value));
+    }
 
-    int len = ns3_packet->GetSize();
-    auto packet = get_bm_packet(ns3_packet, ingress_port);
+    void put_u32(uint32_t value)
+    {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
 
-    BMELOG(packet_in, *packet);
+    void put_i32(int32_t value)
+    {
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
 
-    bm::PHV* phv = packet->get_phv();
-    phv->reset_metadata();
-    phv->get_field("standard_metadata.packet_length").set(len);
+    void put_string(const std::string& value)
+    {
+        put_u32(value.size());
+        buffer.append(value);
+    }
 
-    bm::Field& f_instance_type = phv->get_field("standard_metadata.instance_type");
-    f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
+    void put_action_data(const bm::ActionData& action_data)
+    {
+        put_u32(action_data.size());
+        for (size_t i = 0; i < action_data.size(); i++)
+        {
+            put_string(action_data.get(i).get_string());
+        }
+    }
+};
 
-    if (phv->has_field("intrinsic_metadata.ingress_global_timestamp"))
+/**
+ * Decoder of a table snapshot, reading from memory. Reads past the end set ok to false.
+ */
+struct snapshot_reader
+{
+    const char* pos;
+    const char* end;
+    bool ok = true;
+
+    bool has(size_t n)
     {
-        phv->get_field("intrinsic_metadata.ingress_global_timestamp")
-            .set(Simulator::Now().GetNanoSeconds());
+        ok = ok && static_cast<size_t>(end - pos) >= n;
+        return ok;
     }
 
-    phv->get_field("standard_metadata.ingress_port").set(ingress_port);
+    uint8_t get_u8()
+    {
+        return has(1) ? static_cast<uint8_t>(*pos++) : 0;
+    }
 
-    const bm::Packet::buffer_state_t packet_in_state = packet->save_buffer_state();
-    parser->parse(packet.get());
+    uint32_t get_u32()
+    {
+        uint32_t value = 0;
+        if (has(sizeof(value)))
+        {
+            std::memcpy(&value, pos, sizeof(value));
+            pos += sizeof(value);
+        }
+        return value;
+    }
 
-    if (phv->has_field("standard_metadata.parser_error"))
+    int32_t get_i32()
     {
-        phv->get_field("standard_metadata.parser_error").set(packet->get_error_code().get());
+        return static_cast<int32_t>(get_u32());
     }
 
-    if (phv->has_field("standard_metadata.checksum_error"))
+    void get_string(std::string& value)
     {
-        phv->get_field("standard_metadata.checksum_error")
-            .set(packet->get_checksum_error() ? 1 : 0);
+        uint32_t size = get_u32();
+        if (has(size))
+        {
+            value.assign(pos, size);
+            pos += size;
+        }
     }
 
-    this->process_ingress(packet);
+    void get_action_data(bm::ActionData& action_data, std::string& bytes)
+    {
+        action_data = bm::ActionData();
+        uint32_t n_params = get_u32();
+        for (uint32_t i = 0; i < n_params && ok; i++)
+        {
+            get_string(bytes);
+            action_data.push_back_action_data(bytes.data(), bytes.size());
+        }
+    }
+};
 
-    // Handle Traffic Management, for now only implements multicast
-    bm::Field& f_egress_spec_ig = phv->get_field("standard_metadata.egress_spec");
-    uint16_t egress_spec_ig = f_egress_spec_ig.get_uint();
+/**
+ * Header of the bmv2 event logger messages, as laid out by bm_sim/event_logger.cpp. Table hit,
+ * table miss and action execute messages follow it with the table or action id.
+ */
+struct event_msg_hdr
+{
+    int type;
+    int switch_id;
+    int cxt_id;
+    uint64_t sig;
+    uint64_t id;
+    uint64_t copy_id;
+} __attribute__((packed));
+
+/**
+ * Types of the bmv2 event logger messages that are counted
+ */
+enum event_type
+{
+    EVENT_TABLE_HIT = 12,
+    EVENT_TABLE_MISS = 13,
+    EVENT_ACTION_EXECUTE = 14,
+};
 
-    unsigned int mgid = 0u;
-    if (phv->has_field("intrinsic_metadata.mcast_grp"))
+/**
+ * Transport of the bmv2 event logger, counting the events instead of sending them
+ */
+class stats_transport : public bm::TransportIface
+{
+  private:
+    int open_() override
     {
-        bm::Field& f_mgid = phv->get_field("intrinsic_metadata.mcast_grp");
-        mgid = f_mgid.get_uint();
+        return 0;
     }
-    if (mgid != 0)
+
+    int send_(const std::string& msg) const override
     {
-        BMLOG_DEBUG_PKT(*packet, "Multicast requested for packet");
-        auto& f_instance_type = phv->get_field("standard_metadata.instance_type");
-        f_instance_type.set(PKT_INSTANCE_TYPE_REPLICATION);
-        this->process_multicast(pkts_to_egress, packet.get(), mgid);
+        return send_(msg.data(), msg.size());
     }
-    else
+
+    int send_(const char* msg, int len) const override
     {
-        BMLOG_DEBUG_PKT(*packet, "Egress port is {}", egress_spec_ig);
-        if (egress_spec_ig == drop_port)
+        P4Pipeline::count_event(msg, len);
+        return 0;
+    }
+
+    int send_msgs_(const std::initializer_list<std::string>& msgs) const override
+    {
+        for (const auto& msg : msgs)
         {
-            BMLOG_DEBUG_PKT(*packet, "Dropping packet at ingress");
-            packet.release();
+            send_(msg.data(), msg.size());
         }
-        else
-        {
-            auto& f_instance_type = phv->get_field("standard_metadata.instance_type");
-            f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
+        return 0;
+    }
 
-            pkts_to_egress->push_back(std::make_pair(egress_spec_ig, std::move(packet)));
+    int send_msgs_(const std::initializer_list<bm::TransportIface::MsgBuf>& msgs) const override
+    {
+        for (const auto& msg : msgs)
+        {
+            send_(msg.buf, msg.len);
         }
+        return 0;
     }
+};
+
+/**
+ * Pipeline with counters enabled that is processing packets in this thread, if any
+ */
+thread_local P4Pipeline* stats_pipeline = nullptr;
 
-    for (auto& item : *pkts_to_egress)
+/**
+ * Lookup structure remembering the result of the lookups of a table, by key bytes
+ *
+ * The result is the handle of the matching entry, which bmv2 resolves to the current action and
+ * parameters of the entry, so modifying an entry or the default action keeps the cache valid.
+ * Adding and deleting entries clears it. When full, the cache is cleared too.
+ */
+template <typename K>
+class cached_lookup_structure : public bm::LookupStructure<K>
+{
+  public:
+    cached_lookup_structure(std::unique_ptr<bm::LookupStructure<K>> lookup,
+                            size_t capacity,
+                            P4PipelineStats* stats)
+        : lookup_structure(std::move(lookup)),
+          capacity(capacity),
+          stats(stats)
     {
-        std::unique_ptr<bm::Packet> eg_pkt = std::move(item.second);
-        this->process_egress(eg_pkt, len, item.first);
+        cache.reserve(capacity);
+    }
 
-        bm::Field& f_egress_spec_eg = phv->get_field("standard_metadata.egress_spec");
-        uint16_t egress_spec_eg = f_egress_spec_eg.get_uint();
-        if (egress_spec_eg == drop_port)
+    bool lookup(const bm::ByteContainer& key_data, bm::internal_handle_t* handle) const override
+    {
+        key.assign(key_data.data(), key_data.size());
+        auto it = cache.find(key);
+        if (it != cache.end())
         {
-            BMLOG_DEBUG_PKT(*packet, "Dropping packet at the end of egress");
-            eg_pkt.release();
+            stats->lookup_cache_hits++;
+            *handle = it->second.handle;
+            return it->second.hit;
         }
-        else
+
+        stats->lookup_cache_misses++;
+        if (cache.size() >= capacity)
         {
-            deparser->deparse(eg_pkt.get());
-            output_pkts->push_back(std::make_pair(item.first, get_ns3_packet(std::move(eg_pkt))));
+            cache.clear();
         }
+        cached_result& result = cache[key];
+        result.hit = lookup_structure->lookup(key_data, &result.handle);
+        *handle = result.handle;
+        return result.hit;
     }
 
-    delete (pkts_to_egress);
+    bool entry_exists(const K& key) const override
+    {
+        return lookup_structure->entry_exists(key);
+    }
 
-    return output_pkts;
-}
+    void add_entry(const K& key, bm::internal_handle_t handle) override
+    {
+        lookup_structure->add_entry(key, handle);
+        cache.clear();
+    }
 
-void
-P4Pipeline::process_ingress(std::unique_ptr<bm::Packet>& packet)
-{
-    // The following is similar to what happens in bmv2 simple_switch ingress thread.
-    bm::Pipeline* ingress_mau = this->get_pipeline("ingress");
+    void delete_entry(const K& key) override
+    {
+        lookup_structure->delete_entry(key);
+        cache.clear();
+    }
 
-    BMLOG_DEBUG_PKT(*packet, "Processing packet");
+    void clear() override
+    {
+        lookup_structure->clear();
+        cache.clear();
+    }
 
-    ingress_mau->apply(packet.get());
-    packet->reset_exit();
-}
+  private:
+    /**
+     * Result of a lookup
+     */
+    struct cached_result
+    {
+        bool hit = false;               //!< Whether an entry matched
+        bm::internal_handle_t handle{}; //!< Handle of the entry
+    };
+
+    std::unique_ptr<bm::LookupStructure<K>> lookup_structure;
+    size_t capacity;
+    P4PipelineStats* stats;
+    mutable std::unordered_map<std::string, cached_result> cache;
+    mutable std::string key; //!< Key of the current lookup, reused to avoid allocations
+};
 
-void
-P4Pipeline::process_egress(std::unique_ptr<bm::Packet>& packet, int pkt_len, uint16_t egress_port)
+/**
+ * Factory wrapping the bmv2 exact and LPM lookup structures in a cache
+ */
+class cached_lookup_factory : public bm::LookupStructureFactory
 {
-    // The following is similar to what happens in bmv2 simple_switch egress thread.
-    bm::Pipeline* egress_mau = this->get_pipeline("egress");
-
-    bm::PHV* phv = packet->get_phv();
+  public:
+    cached_lookup_factory(size_t capacity, P4PipelineStats* stats)
+        : capacity(capacity),
+          stats(stats)
+    {
+    }
 
-    if (phv->has_field("intrinsic_metadata.egress_global_timestamp"))
+    std::unique_ptr<bm::ExactLookupStructure> create_for_exact(size_t size,
+                                                               size_t nbytes_key) override
     {
-        phv->get_field("intrinsic_metadata.egress_global_timestamp")
-            .set(Simulator::Now().GetNanoSeconds());
+        return std::unique_ptr<bm::ExactLookupStructure>(
+            new cached_lookup_structure<bm::ExactMatchKey>(
+                bm::LookupStructureFactory::create_for_exact(size, nbytes_key),
+                capacity,
+                stats));
     }
 
-    phv->get_field("standard_metadata.egress_port").set(egress_port);
+    std::unique_ptr<bm::LPMLookupStructure> create_for_LPM(size_t size,
+                                                           size_t nbytes_key) override
+    {
+        return std::unique_ptr<bm::LPMLookupStructure>(new cached_lookup_structure<bm::LPMMatchKey>(
+            bm::LookupStructureFactory::create_for_LPM(size, nbytes_key),
+            capacity,
+            stats));
+    }
 
-    bm::Field& f_egress_spec = phv->get_field("standard_metadata.egress_spec");
-    f_egress_spec.set(drop_port + 1);
+  private:
+    size_t capacity;
+    P4PipelineStats* stats;
+};
 
-    phv->get_field("standard_metadata.packet_length").set(pkt_len);
+} // namespace
 
-    egress_mau->apply(packet.get());
-}
+// if REGISTER_HASH calls placed in the anonymous namespace, some compiler can
+// give an unused variable warning
+REGISTER_HASH(hash_ex);
+REGISTER_HASH(bmv2_hash);
 
-void
-P4Pipeline::process_multicast(
-    std::list<std::pair<uint16_t, std::unique_ptr<bm::Packet>>>* pkts_to_egress,
-    bm::Packet* packet,
-    unsigned int mgid)
-{
-    auto* phv = packet->get_phv();
-    auto& f_rid = phv->get_field("intrinsic_metadata.egress_rid");
-    const auto pre_out = pre->replicate({mgid});
-    for (const auto& out : pre_out)
-    {
-        auto egress_port = out.egress_port;
-        BMLOG_DEBUG_PKT(*packet, "Replicating packet on port {}", egress_port);
-        f_rid.set(out.rid);
-        std::unique_ptr<bm::Packet> packet_copy = packet->clone_with_phv_ptr();
-        pkts_to_egress->push_back(std::make_pair(egress_port, std::move(packet_copy)));
-    }
-}
+// initialize static attributes
+int P4Pipeline::thrift_port = 9090;
+bm::packet_id_t P4Pipeline::packet_id = 0;
 
-std::unique_ptr<bm::Packet>
-P4Pipeline::get_bm_packet(Ptr<const Packet> ns3_packet, uint32_t ingress_port)
+P4Pipeline::P4Pipeline(std::string jsonFile,
+                       std::string name,
+                       bool enableThrift,
+                       bm::Logger::LogLevel logLevel,
+                       size_t lookupCacheSize)
+    : pre(new bm::McSimplePreLAG())
 {
-    int len = ns3_packet->GetSize();
+    add_component<bm::McSimplePreLAG>(pre);
 
-    if (len > MAX_PKT_SIZE)
+    // The tables get their lookup structures when the program is loaded
+    if (lookupCacheSize > 0)
     {
-        BMLOG_DEBUG("Packet length {} exceeds MAX_PKT_SIZE", len);
-        std::exit(1);
+        set_lookup_factory(std::make_shared<cached_lookup_factory>(lookupCacheSize, &stats));
     }
-    ns3_packet->CopyData(ns2bm_buf, len);
-    auto bm_packet = new_packet_ptr(ingress_port,
-                                    packet_id++,
-                                    len,
-                                    bm::PacketBuffer(MAX_PKT_SIZE, (char*)(ns2bm_buf), len));
 
-    return bm_packet;
-}
+    // Fields taken from simple_switch
+    add_required_field("standard_metadata", "ingress_port");
+    add_required_field("standard_metadata", "packet_length");
+    add_required_field("standard_metadata", "instance_type");
+    add_required_field("standard_metadata", "egress_spec");
+    add_required_field("standard_metadata", "egress_port");
 
-Ptr<Packet>
-P4Pipeline::get_ns3_packet(std::unique_ptr<bm::Packet> bm_packet)
-{
-    uint8_t* bm_buf = (uint8_t*)bm_packet.get()->data();
-    size_t len = bm_packet.get()->get_data_size();
+    force_arith_header("standard_metadata");
+    force_arith_header("queueing_metadata");
+    force_arith_header("intrinsic_metadata");
 
-    Buffer b;
-    b.AddAtStart(len);
-    b.Begin().Write(bm_buf, len);
+    import_primitives();
 
-    Buffer::Iterator it = b.Begin();
-    EthernetHeader eth;
-    eth.Deserialize(it);
-    it.Next(eth.GetSerializedSize());
-    size_t offset = eth.GetSerializedSize();
+    std::string node_id = (name.empty()) ? std::to_string(thrift_port) : name;
 
-    uint16_t ether_type = eth.GetLengthType();
+    // Initialize the switch
+    bm::OptionsParser opt_parser;
+    opt_parser.config_file_path = jsonFile;
+    opt_parser.console_logging = (logLevel != bm::Logger::LogLevel::OFF);
+    opt_parser.log_level = logLevel;
 
-    Ipv4Header ipv4;
-    Ipv6Header ipv6;
-    TcpHeader tcp;
-    UdpHeader udp;
-    uint8_t next_hdr = 0;
-    if (ether_type == 0x0800)
+    // Without Thrift, notifications go to a dummy transport instead of a nanomsg socket
+    std::shared_ptr<bm::TransportIface> notifications_transport;
+    if (enableThrift)
     {
-        ipv4.Deserialize(it);
-        it.Next(ipv4.GetSerializedSize());
-        offset += ipv4.GetSerializedSize();
-
-        next_hdr = ipv4.GetProtocol();
+        opt_parser.debugger_addr =
+            std::string("ipc:///tmp/bmv2-") + node_id + std::string("-debug.ipc");
+        opt_parser.notifications_addr =
+            std::string("ipc:///tmp/bmv2-") + node_id + std::string("-notifications.ipc");
+        opt_parser.thrift_port = thrift_port++;
     }
-    else if (ether_type == 0x86dd)
+    else
     {
-        ipv6.Deserialize(it);
-        it.Next(ipv6.GetSerializedSize());
-        offset += ipv6.GetSerializedSize();
-
-        next_hdr = ipv6.GetNextHeader();
+        notifications_transport = bm::TransportIface::make_dummy();
     }
 
-    if (next_hdr == 6)
+    // Program description used by the in-process control plane, shared by the switches
+    // running the same program
+    std::string error;
+    program_info = P4ProgramInfo::Load(jsonFile, error);
+    if (!program_info)
     {
-        tcp.Deserialize(it);
-        it.Next(tcp.GetSerializedSize());
-        offset += tcp.GetSerializedSize();
+        NS_LOG_ERROR(node_id << " Cannot read P4 program description: " << error);
+        program_info = std::make_shared<P4ProgramInfo>();
     }
-    else if (next_hdr == 17)
+    else if (!enableThrift)
     {
-        udp.Deserialize(it);
-        it.Next(udp.GetSerializedSize());
-        offset += udp.GetSerializedSize();
+        // bmv2 builds its objects from the content read once for all the switches, instead
+        // of reading the file again. With Thrift it must open its own notification socket.
+        opt_parser.no_p4 = true;
     }
 
-    Ptr<Packet> p = Create<Packet>(bm_buf + offset, len - offset);
-    /* Headers are added in reverse order */
-    if (next_hdr == 6)
-        p->AddHeader(tcp);
-    else if (next_hdr == 17)
-        p->AddHeader(udp);
+    int status = init_from_options_parser(opt_parser, notifications_transport);
+    if (status == 0 && opt_parser.no_p4)
+    {
+        std::istringstream json(program_info->GetJson());
+        status = init_objects(&json, opt_parser.device_id, notifications_transport);
+    }
+    if (status != 0)
+    {
+        BMLOG_DEBUG("Failed to initialize the P4 pipeline");
+        std::exit(status);
+    }
 
-    if (ether_type == 0x0800)
-        p->AddHeader(ipv4);
-    else if (ether_type == 0x86dd)
-        p->AddHeader(ipv6);
+    // ns-3 Headers of the SRv6 programs, looked up by name so that the module does not need
+    // to link against the modules defining them
+    add_header_mapping("ethernet_h", "ns3::EthernetHeader");
+    add_header_mapping("ipv6_h", "ns3::Ipv6Header");
+    add_header_mapping("srv6_h", "ns3::Ipv6SegmentRoutingHeader");
+    add_header_mapping("srv6_ll_tlv_h", "ns3::LiveLiveTlvHeader");
+    add_header_mapping("tcp_h", "ns3::TcpHeader");
+    add_header_mapping("udp_h", "ns3::UdpHeader");
+
+    parser = this->get_parser("parser");
+    deparser = this->get_deparser("deparser");
+    ingress_mau = this->get_pipeline("ingress");
+    egress_mau = this->get_pipeline("egress");
+
+    if (enableThrift)
+    {
+        int port = get_runtime_port();
+        bm_runtime::start_server(this, port);
+    }
+    start_and_return();
+}
+
+std::string
+P4Pipeline::run_cli_commands(std::string commands)
+{
+    std::ostringstream out;
+
+    std::istringstream lines(commands);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        run_cli_command(line, out);
+    }
+
+    return out.str();
+}
+
+void
+P4Pipeline::run_cli_command(const std::string& line, std::ostringstream& out)
+{
+    std::vector<std::string> args = split_tokens(line);
+    if (args.empty() || args[0][0] == '#')
+    {
+        return;
+    }
+
+    std::string cmd = args[0];
+    args.erase(args.begin());
+
+    if (cmd == "table_add" && args.size() >= 2)
+    {
+        const P4ProgramInfo::Table* table = program_info->GetTable(args[0]);
+        int priority = -1;
+        if (table && (table->matchType == P4ProgramInfo::MATCH_TERNARY ||
+                      table->matchType == P4ProgramInfo::MATCH_RANGE))
+        {
+            uint64_t value;
+            if (args.size() < 3 || !parse_uint(args.back(), value))
+            {
+                out << "Error: Table " << args[0] << " requires a priority" << std::endl;
+                return;
+            }
+            priority = static_cast<int>(value);
+            args.pop_back();
+        }
+
+        auto sep = std::find(args.begin() + 2, args.end(), "=>");
+        std::vector<std::string> match_key(args.begin() + 2, sep);
+        std::vector<std::string> action_params;
+        if (sep != args.end())
+        {
+            action_params.assign(sep + 1, args.end());
+        }
+
+        if (table)
+        {
+            out << "Adding entry to " << P4ProgramInfo::MatchTypeToString(table->matchType)
+                << " match table " << table->name << std::endl;
+        }
+
+        bm::entry_handle_t handle;
+        bm::MatchErrorCode rc =
+            table_add(args[0], args[1], match_key, action_params, &handle, priority);
+        if (rc == bm::MatchErrorCode::SUCCESS)
+        {
+            out << "Entry has been added with handle " << handle << std::endl;
+        }
+        else
+        {
+            out << "Invalid table operation (" << match_error_to_string(rc) << ")" << std::endl;
+        }
+    }
+    else if (cmd == "table_modify" && args.size() >= 3)
+    {
+        uint64_t handle;
+        if (!parse_uint(args[2], handle))
+        {
+            out << "Error: Bad format for entry handle " << args[2] << std::endl;
+            return;
+        }
+
+        out << "Modifying entry " << handle << " for table " << args[0] << std::endl;
+        std::vector<std::string> action_params(args.begin() + 3, args.end());
+        bm::MatchErrorCode rc = table_modify(args[0], args[1], handle, action_params);
+        if (rc != bm::MatchErrorCode::SUCCESS)
+        {
+            out << "Invalid table operation (" << match_error_to_string(rc) << ")" << std::endl;
+        }
+    }
+    else if (cmd == "table_delete" && args.size() == 2)
+    {
+        uint64_t handle;
+        if (!parse_uint(args[1], handle))
+        {
+            out << "Error: Bad format for entry handle " << args[1] << std::endl;
+            return;
+        }
+
+        out << "Deleting entry " << handle << " from " << args[0] << std::endl;
+        bm::MatchErrorCode rc = table_delete(args[0], handle);
+        if (rc != bm::MatchErrorCode::SUCCESS)
+        {
+            out << "Invalid table operation (" << match_error_to_string(rc) << ")" << std::endl;
+        }
+    }
+    else if (cmd == "table_set_default" && args.size() >= 2)
+    {
+        out << "Setting default action of " << args[0] << std::endl;
+        std::vector<std::string> action_params(args.begin() + 2, args.end());
+        bm::MatchErrorCode rc = table_set_default(args[0], args[1], action_params);
+        if (rc != bm::MatchErrorCode::SUCCESS)
+        {
+            out << "Invalid table operation (" << match_error_to_string(rc) << ")" << std::endl;
+        }
+    }
+    else if (cmd == "mc_mgrp_create" && args.size() == 1)
+    {
+        uint64_t mgid;
+        bm::McSimplePre::mgrp_hdl_t handle;
+        out << "Creating multicast group " << args[0] << std::endl;
+        if (!parse_uint(args[0], mgid) || mc_mgrp_create(mgid, &handle) != bm::McSimplePre::SUCCESS)
+        {
+            out << "Invalid PRE operation" << std::endl;
+        }
+    }
+    else if (cmd == "mc_mgrp_destroy" && args.size() == 1)
+    {
+        uint64_t handle;
+        out << "Destroying multicast group " << args[0] << std::endl;
+        if (!parse_uint(args[0], handle) || mc_mgrp_destroy(handle) != bm::McSimplePre::SUCCESS)
+        {
+            out << "Invalid PRE operation" << std::endl;
+        }
+    }
+    else if (cmd == "mc_node_create" && args.size() >= 1)
+    {
+        // Ports after a "|" are LAG indexes, LAGs are not supported
+        uint64_t rid;
+        std::vector<uint32_t> ports;
+        bool valid = parse_uint(args[0], rid);
+        for (auto it = args.begin() + 1; valid && it != args.end() && *it != "|"; it++)
+        {
+            uint64_t port;
+            valid = parse_uint(*it, port);
+            ports.push_back(port);
+        }
+
+        bm::McSimplePre::l1_hdl_t handle;
+        out << "Creating node with rid " << args[0] << std::endl;
+        if (valid && mc_node_create(rid, ports, &handle) == bm::McSimplePre::SUCCESS)
+        {
+            out << "node was created with handle " << handle << std::endl;
+        }
+        else
+        {
+            out << "Invalid PRE operation" << std::endl;
+        }
+    }
+    else if (cmd == "mc_node_destroy" && args.size() == 1)
+    {
+        uint64_t handle;
+        out << "Destroying node " << args[0] << std::endl;
+        if (!parse_uint(args[0], handle) || mc_node_destroy(handle) != bm::McSimplePre::SUCCESS)
+        {
+            out << "Invalid PRE operation" << std::endl;
+        }
+    }
+    else if (cmd == "mc_node_update" && args.size() >= 1)
+    {
+        uint64_t handle;
+        std::vector<uint32_t> ports;
+        bool valid = parse_uint(args[0], handle);
+        for (auto it = args.begin() + 1; valid && it != args.end() && *it != "|"; it++)
+        {
+            uint64_t port;
+            valid = parse_uint(*it, port);
+            ports.push_back(port);
+        }
+
+        out << "Updating node " << args[0] << std::endl;
+        if (!valid || mc_node_update(handle, ports) != bm::McSimplePre::SUCCESS)
+        {
+            out << "Invalid PRE operation" << std::endl;
+        }
+    }
+    else if ((cmd == "mc_node_associate" || cmd == "mc_node_dissociate") && args.size() == 2)
+    {
+        uint64_t mgrp_handle;
+        uint64_t node_handle;
+        bool associate = (cmd == "mc_node_associate");
+        out << (associate ? "Associating node " : "Dissociating node ") << args[1]
+            << (associate ? " to" : " from") << " multicast group " << args[0] << std::endl;
+        if (!parse_uint(args[0], mgrp_handle) || !parse_uint(args[1], node_handle) ||
+            (associate ? mc_node_associate(mgrp_handle, node_handle)
+                       : mc_node_dissociate(mgrp_handle, node_handle)) != bm::McSimplePre::SUCCESS)
+        {
+            out << "Invalid PRE operation" << std::endl;
+        }
+    }
+    else if ((cmd == "mirroring_add" || cmd == "mirroring_add_mc") && args.size() == 2)
+    {
+        uint64_t mirror_id;
+        uint64_t value;
+        MirroringSessionConfig config;
+        if (!parse_uint(args[0], mirror_id) || !parse_uint(args[1], value))
+        {
+            out << "Invalid mirroring operation" << std::endl;
+            return;
+        }
+        if (cmd == "mirroring_add")
+        {
+            config.egress_port = value;
+            config.egress_port_valid = true;
+        }
+        else
+        {
+            config.mgid = value;
+            config.mgid_valid = true;
+        }
+        if (!mirroring_add_session(mirror_id, config))
+        {
+            out << "Invalid mirroring operation" << std::endl;
+        }
+    }
+    else if (cmd == "mirroring_delete" && args.size() == 1)
+    {
+        uint64_t mirror_id;
+        if (!parse_uint(args[0], mirror_id) || !mirroring_delete_session(mirror_id))
+        {
+            out << "Invalid mirroring operation (SESSION_NOT_FOUND)" << std::endl;
+        }
+    }
+    else if (cmd == "mirroring_get" && args.size() == 1)
+    {
+        uint64_t mirror_id;
+        MirroringSessionConfig config;
+        if (!parse_uint(args[0], mirror_id) || !mirroring_get_session(mirror_id, &config))
+        {
+            out << "Invalid mirroring operation (SESSION_NOT_FOUND)" << std::endl;
+            return;
+        }
+        out << "MirroringSessionConfig(";
+        if (config.egress_port_valid)
+        {
+            out << "port=" << config.egress_port;
+        }
+        if (config.mgid_valid)
+        {
+            out << (config.egress_port_valid ? ", " : "") << "mgid=" << config.mgid;
+        }
+        out << ")" << std::endl;
+    }
+    else if (cmd == "register_read" && (args.size() == 1 || args.size() == 2))
+    {
+        const P4ProgramInfo::Register* reg = program_info->GetRegister(args[0]);
+        if (!reg)
+        {
+            out << "Error: Unknown register array " << args[0] << std::endl;
+            return;
+        }
+
+        uint64_t first = 0;
+        uint64_t last = reg->size;
+        if (args.size() == 2)
+        {
+            if (!parse_uint(args[1], first))
+            {
+                out << "Error: Bad format for index " << args[1] << std::endl;
+                return;
+            }
+            last = first + 1;
+        }
+
+        out << reg->name;
+        if (args.size() == 2)
+        {
+            out << "[" << first << "]";
+        }
+        out << "=";
+        for (uint64_t i = first; i < last; i++)
+        {
+            uint64_t value;
+            if (register_read(reg->name, i, &value) != bm::RegisterErrorCode::SUCCESS)
+            {
+                out << std::endl << "Invalid register operation" << std::endl;
+                return;
+            }
+            out << ((i == first) ? " " : ", ") << value;
+        }
+        out << std::endl;
+    }
+    else if (cmd == "register_write" && args.size() == 3)
+    {
+        uint64_t index;
+        uint64_t value;
+        if (!parse_uint(args[1], index) || !parse_uint(args[2], value) ||
+            register_write(args[0], index, value) != bm::RegisterErrorCode::SUCCESS)
+        {
+            out << "Invalid register operation" << std::endl;
+        }
+    }
+    else
+    {
+        out << "*** Unknown syntax: " << line << std::endl;
+    }
+}
+
+bm::MatchErrorCode
+P4Pipeline::table_add(const std::string& table_name,
+                      const std::string& action_name,
+                      const std::vector<std::string>& match_key,
+                      const std::vector<std::string>& action_params,
+                      bm::entry_handle_t* handle,
+                      int priority)
+{
+    const P4ProgramInfo::Table* table = program_info->GetTable(table_name);
+    if (!table)
+    {
+        return bm::MatchErrorCode::INVALID_TABLE_NAME;
+    }
+    const P4ProgramInfo::Action* action = program_info->GetAction(action_name, table);
+    if (!action)
+    {
+        return bm::MatchErrorCode::INVALID_ACTION_NAME;
+    }
+
+    std::vector<bm::MatchKeyParam> params;
+    if (!build_match_key(*table, match_key, &params))
+    {
+        return bm::MatchErrorCode::BAD_MATCH_KEY;
+    }
+    bm::ActionData action_data;
+    if (!build_action_data(*action, action_params, &action_data))
+    {
+        return bm::MatchErrorCode::BAD_ACTION_DATA;
+    }
+
+    return mt_add_entry(0,
+                        table->name,
+                        params,
+                        action->name,
+                        std::move(action_data),
+                        handle,
+                        priority);
+}
+
+bm::MatchErrorCode
+P4Pipeline::table_modify(const std::string& table_name,
+                         const std::string& action_name,
+                         bm::entry_handle_t handle,
+                         const std::vector<std::string>& action_params)
+{
+    const P4ProgramInfo::Table* table = program_info->GetTable(table_name);
+    if (!table)
+    {
+        return bm::MatchErrorCode::INVALID_TABLE_NAME;
+    }
+    const P4ProgramInfo::Action* action = program_info->GetAction(action_name, table);
+    if (!action)
+    {
+        return bm::MatchErrorCode::INVALID_ACTION_NAME;
+    }
+
+    bm::ActionData action_data;
+    if (!build_action_data(*action, action_params, &action_data))
+    {
+        return bm::MatchErrorCode::BAD_ACTION_DATA;
+    }
+
+    return mt_modify_entry(0, table->name, handle, action->name, std::move(action_data));
+}
+
+bm::MatchErrorCode
+P4Pipeline::table_delete(const std::string& table_name, bm::entry_handle_t handle)
+{
+    const P4ProgramInfo::Table* table = program_info->GetTable(table_name);
+    if (!table)
+    {
+        return bm::MatchErrorCode::INVALID_TABLE_NAME;
+    }
+
+    return mt_delete_entry(0, table->name, handle);
+}
+
+bm::MatchErrorCode
+P4Pipeline::table_set_default(const std::string& table_name,
+                              const std::string& action_name,
+                              const std::vector<std::string>& action_params)
+{
+    const P4ProgramInfo::Table* table = program_info->GetTable(table_name);
+    if (!table)
+    {
+        return bm::MatchErrorCode::INVALID_TABLE_NAME;
+    }
+    const P4ProgramInfo::Action* action = program_info->GetAction(action_name, table);
+    if (!action)
+    {
+        return bm::MatchErrorCode::INVALID_ACTION_NAME;
+    }
+
+    bm::ActionData action_data;
+    if (!build_action_data(*action, action_params, &action_data))
+    {
+        return bm::MatchErrorCode::BAD_ACTION_DATA;
+    }
+
+    return mt_set_default_action(0, table->name, action->name, std::move(action_data));
+}
+
+bm::McSimplePre::McReturnCode
+P4Pipeline::mc_mgrp_create(unsigned int mgid, bm::McSimplePre::mgrp_hdl_t* handle)
+{
+    bm::McSimplePre::McReturnCode rc = pre->mc_mgrp_create(mgid, handle);
+    if (rc == bm::McSimplePre::SUCCESS)
+    {
+        mc_groups.insert(*handle);
+    }
+    return rc;
+}
+
+bm::McSimplePre::McReturnCode
+P4Pipeline::mc_mgrp_destroy(bm::McSimplePre::mgrp_hdl_t handle)
+{
+    bm::McSimplePre::McReturnCode rc = pre->mc_mgrp_destroy(handle);
+    if (rc == bm::McSimplePre::SUCCESS)
+    {
+        // The nodes of the group are dissociated with it
+        mc_groups.erase(handle);
+        for (auto it = mc_node_groups.begin(); it != mc_node_groups.end();)
+        {
+            it = it->second == handle ? mc_node_groups.erase(it) : std::next(it);
+        }
+    }
+    return rc;
+}
+
+bm::McSimplePre::McReturnCode
+P4Pipeline::mc_node_create(unsigned int rid,
+                           const std::vector<uint32_t>& ports,
+                           bm::McSimplePre::l1_hdl_t* handle)
+{
+    bm::McSimplePre::PortMap port_map;
+    for (uint32_t port : ports)
+    {
+        if (port >= port_map.size())
+        {
+            return bm::McSimplePre::ERROR;
+        }
+        port_map.set(port);
+    }
+
+    bm::McSimplePre::McReturnCode rc =
+        pre->mc_node_create(rid, port_map, bm::McSimplePreLAG::LagMap(), handle);
+    if (rc == bm::McSimplePre::SUCCESS)
+    {
+        mc_node_ports[*handle] = port_map;
+    }
+    return rc;
+}
+
+bm::McSimplePre::McReturnCode
+P4Pipeline::mc_node_update(bm::McSimplePre::l1_hdl_t handle, const std::vector<uint32_t>& ports)
+{
+    bm::McSimplePre::PortMap port_map;
+    for (uint32_t port : ports)
+    {
+        if (port >= port_map.size())
+        {
+            return bm::McSimplePre::ERROR;
+        }
+        port_map.set(port);
+    }
+
+    bm::McSimplePre::McReturnCode rc =
+        pre->mc_node_update(handle, port_map, bm::McSimplePreLAG::LagMap());
+    if (rc == bm::McSimplePre::SUCCESS)
+    {
+        mc_node_ports[handle] = port_map;
+    }
+    return rc;
+}
+
+bm::McSimplePre::McReturnCode
+P4Pipeline::mc_node_destroy(bm::McSimplePre::l1_hdl_t handle)
+{
+    bm::McSimplePre::McReturnCode rc = pre->mc_node_destroy(handle);
+    if (rc == bm::McSimplePre::SUCCESS)
+    {
+        mc_node_ports.erase(handle);
+        mc_node_groups.erase(handle);
+    }
+    return rc;
+}
+
+bm::McSimplePre::McReturnCode
+P4Pipeline::mc_node_associate(bm::McSimplePre::mgrp_hdl_t mgrp_handle,
+                              bm::McSimplePre::l1_hdl_t node_handle)
+{
+    bm::McSimplePre::McReturnCode rc = pre->mc_node_associate(mgrp_handle, node_handle);
+    if (rc == bm::McSimplePre::SUCCESS)
+    {
+        mc_node_groups[node_handle] = mgrp_handle;
+    }
+    return rc;
+}
+
+bm::McSimplePre::McReturnCode
+P4Pipeline::mc_node_dissociate(bm::McSimplePre::mgrp_hdl_t mgrp_handle,
+                               bm::McSimplePre::l1_hdl_t node_handle)
+{
+    bm::McSimplePre::McReturnCode rc = pre->mc_node_dissociate(mgrp_handle, node_handle);
+    if (rc == bm::McSimplePre::SUCCESS)
+    {
+        mc_node_groups.erase(node_handle);
+    }
+    return rc;
+}
+
+void
+P4PipelineTransaction::table_add(const std::string& table_name,
+                                 const std::string& action_name,
+                                 const std::vector<std::string>& match_key,
+                                 const std::vector<std::string>& action_params,
+                                 int priority)
+{
+    Op op{};
+    op.type = Op::TABLE_ADD;
+    op.table_name = table_name;
+    op.action_name = action_name;
+    op.match_key = match_key;
+    op.action_params = action_params;
+    op.priority = priority;
+    ops.push_back(std::move(op));
+}
+
+void
+P4PipelineTransaction::table_modify(const std::string& table_name,
+                                    const std::string& action_name,
+                                    bm::entry_handle_t handle,
+                                    const std::vector<std::string>& action_params)
+{
+    Op op{};
+    op.type = Op::TABLE_MODIFY;
+    op.table_name = table_name;
+    op.action_name = action_name;
+    op.action_params = action_params;
+    op.handle = handle;
+    ops.push_back(std::move(op));
+}
+
+void
+P4PipelineTransaction::table_delete(const std::string& table_name, bm::entry_handle_t handle)
+{
+    Op op{};
+    op.type = Op::TABLE_DELETE;
+    op.table_name = table_name;
+    op.handle = handle;
+    ops.push_back(std::move(op));
+}
+
+void
+P4PipelineTransaction::table_set_default(const std::string& table_name,
+                                         const std::string& action_name,
+                                         const std::vector<std::string>& action_params)
+{
+    Op op{};
+    op.type = Op::TABLE_SET_DEFAULT;
+    op.table_name = table_name;
+    op.action_name = action_name;
+    op.action_params = action_params;
+    ops.push_back(std::move(op));
+}
+
+void
+P4PipelineTransaction::mc_node_update(bm::McSimplePre::l1_hdl_t node_handle,
+                                      const std::vector<uint32_t>& ports)
+{
+    Op op{};
+    op.type = Op::MC_NODE_UPDATE;
+    op.node_handle = node_handle;
+    op.ports = ports;
+    ops.push_back(std::move(op));
+}
+
+void
+P4PipelineTransaction::mc_node_associate(bm::McSimplePre::mgrp_hdl_t mgrp_handle,
+                                         bm::McSimplePre::l1_hdl_t node_handle)
+{
+    Op op{};
+    op.type = Op::MC_NODE_ASSOCIATE;
+    op.mgrp_handle = mgrp_handle;
+    op.node_handle = node_handle;
+    ops.push_back(std::move(op));
+}
+
+void
+P4PipelineTransaction::mc_node_dissociate(bm::McSimplePre::mgrp_hdl_t mgrp_handle,
+                                          bm::McSimplePre::l1_hdl_t node_handle)
+{
+    Op op{};
+    op.type = Op::MC_NODE_DISSOCIATE;
+    op.mgrp_handle = mgrp_handle;
+    op.node_handle = node_handle;
+    ops.push_back(std::move(op));
+}
+
+size_t
+P4PipelineTransaction::size() const
+{
+    return ops.size();
+}
+
+void
+P4PipelineTransaction::clear()
+{
+    ops.clear();
+    added_handles.clear();
+}
+
+const std::vector<bm::entry_handle_t>&
+P4PipelineTransaction::get_added_handles() const
+{
+    return added_handles;
+}
+
+bool
+P4Pipeline::commit(P4PipelineTransaction& transaction, std::string& error)
+{
+    using Op = P4PipelineTransaction::Op;
+    using entry_ref = std::pair<std::string, bm::entry_handle_t>;
+
+    /* A change with its names resolved and its key and parameters converted */
+    struct staged_op
+    {
+        const Op* op;
+        const P4ProgramInfo::Table* table;
+        const P4ProgramInfo::Action* action;
+        std::vector<bm::MatchKeyParam> match_key;
+        bm::ActionData action_data;
+        bm::McSimplePre::PortMap ports;
+    };
+
+    // Packets see either all the changes or none of them, and the checks stay valid
+    std::lock_guard<std::mutex> lock(processing_lock);
+
+    // Check every change against the state left by the ones before it
+    std::set<entry_ref> deleted;
+    std::set<std::pair<std::string, std::vector<std::string>>> added;
+    std::map<bm::McSimplePre::l1_hdl_t, bm::McSimplePre::mgrp_hdl_t> node_groups =
+        mc_node_groups;
+    std::vector<staged_op> staged(transaction.ops.size());
+    for (size_t i = 0; i < transaction.ops.size(); i++)
+    {
+        const Op& op = transaction.ops[i];
+        staged_op& item = staged[i];
+        item.op = &op;
+        std::string where = "change " + std::to_string(i) + ": ";
+        std::string node = std::to_string(op.node_handle);
+        std::string mgrp = std::to_string(op.mgrp_handle);
+
+        if (op.type == Op::MC_NODE_UPDATE)
+        {
+            if (mc_node_ports.find(op.node_handle) == mc_node_ports.end())
+            {
+                error = where + "unknown multicast node " + node;
+                return false;
+            }
+            for (uint32_t port : op.ports)
+            {
+                if (port >= item.ports.size())
+                {
+                    error = where + "invalid port " + std::to_string(port);
+                    return false;
+                }
+                item.ports.set(port);
+            }
+            continue;
+        }
+        if (op.type == Op::MC_NODE_ASSOCIATE || op.type == Op::MC_NODE_DISSOCIATE)
+        {
+            if (mc_node_ports.find(op.node_handle) == mc_node_ports.end())
+            {
+                error = where + "unknown multicast node " + node;
+                return false;
+            }
+            if (mc_groups.find(op.mgrp_handle) == mc_groups.end())
+            {
+                error = where + "unknown multicast group " + mgrp;
+                return false;
+            }
+            auto group = node_groups.find(op.node_handle);
+            if (op.type == Op::MC_NODE_ASSOCIATE)
+            {
+                if (group != node_groups.end())
+                {
+                    error = where + "multicast node " + node + " already associated";
+                    return false;
+                }
+                node_groups[op.node_handle] = op.mgrp_handle;
+            }
+            else
+            {
+                if (group == node_groups.end() || group->second != op.mgrp_handle)
+                {
+                    error = where + "multicast node " + node + " not in group " + mgrp;
+                    return false;
+                }
+                node_groups.erase(group);
+            }
+            continue;
+        }
+
+        item.table = program_info->GetTable(op.table_name);
+        if (!item.table)
+        {
+            error = where + "unknown table " + op.table_name;
+            return false;
+        }
+        if (op.type == Op::TABLE_MODIFY || op.type == Op::TABLE_DELETE)
+        {
+            bm::MatchTable::Entry entry;
+            if (deleted.count({item.table->name, op.handle}) ||
+                mt_get_entry(0, item.table->name, op.handle, &entry) !=
+                    bm::MatchErrorCode::SUCCESS)
+            {
+                error = where + "invalid handle " + std::to_string(op.handle) + " of " +
+                        item.table->name;
+                return false;
+            }
+            if (op.type == Op::TABLE_DELETE)
+            {
+                deleted.insert({item.table->name, op.handle});
+                continue;
+            }
+        }
+        item.action = program_info->GetAction(op.action_name, item.table);
+        if (!item.action)
+        {
+            error = where + "unknown action " + op.action_name + " of " + item.table->name;
+            return false;
+        }
+        if (!build_action_data(*item.action, op.action_params, &item.action_data))
+        {
+            error = where + "bad parameters for " + item.action->name;
+            return false;
+        }
+        if (op.type == Op::TABLE_ADD)
+        {
+            if (!build_match_key(*item.table, op.match_key, &item.match_key))
+            {
+                error = where + "bad key for " + item.table->name;
+                return false;
+            }
+
+            // A key can be added again only if the entry having it is deleted before
+            bm::MatchTable::Entry entry;
+            std::vector<std::string> key = op.match_key;
+            key.push_back(std::to_string(op.priority));
+            if (!added.insert({item.table->name, key}).second ||
+                (mt_get_entry_from_key(0,
+                                       item.table->name,
+                                       item.match_key,
+                                       &entry,
+                                       op.priority < 0 ? 1 : op.priority) ==
+                     bm::MatchErrorCode::SUCCESS &&
+                 !deleted.count({item.table->name, entry.handle})))
+            {
+                error = where + "duplicate key for " + item.table->name;
+                return false;
+            }
+        }
+    }
+
+    // Undos report whether they succeeded, entries restored after a delete get a new handle
+    std::vector<std::pair<size_t, std::function<bool()>>> undo_log;
+    std::map<entry_ref, bm::entry_handle_t> restored;
+    std::vector<bm::entry_handle_t> added_handles;
+    for (size_t i = 0; i < staged.size(); i++)
+    {
+        staged_op& item = staged[i];
+        const Op& op = *item.op;
+        const std::string table_name = item.table ? item.table->name : "";
+        bm::MatchErrorCode rc = bm::MatchErrorCode::SUCCESS;
+        bool mc_ok = true;
+
+        switch (op.type)
+        {
+        case Op::TABLE_ADD: {
+            bm::entry_handle_t handle;
+            rc = mt_add_entry(0,
+                              table_name,
+                              item.match_key,
+                              item.action->name,
+                              std::move(item.action_data),
+                              &handle,
+                              op.priority);
+            if (rc == bm::MatchErrorCode::SUCCESS)
+            {
+                added_handles.push_back(handle);
+                undo_log.emplace_back(i, [this, table_name, handle]() {
+                    return mt_delete_entry(0, table_name, handle) == bm::MatchErrorCode::SUCCESS;
+                });
+            }
+            break;
+        }
+        case Op::TABLE_MODIFY: {
+            bm::MatchTable::Entry entry;
+            rc = mt_get_entry(0, table_name, op.handle, &entry);
+            if (rc == bm::MatchErrorCode::SUCCESS)
+            {
+                rc = mt_modify_entry(0,
+                                     table_name,
+                                     op.handle,
+                                     item.action->name,
+                                     std::move(item.action_data));
+            }
+            if (rc == bm::MatchErrorCode::SUCCESS)
+            {
+                bm::entry_handle_t handle = op.handle;
+                undo_log.emplace_back(i, [this, &restored, table_name, handle, entry]() {
+                    // Deleted later in the transaction and already restored
+                    auto it = restored.find({table_name, handle});
+                    return mt_modify_entry(0,
+                                           table_name,
+                                           it == restored.end() ? handle : it->second,
+                                           entry.action_fn->get_name(),
+                                           entry.action_data) == bm::MatchErrorCode::SUCCESS;
+                });
+            }
+            break;
+        }
+        case Op::TABLE_DELETE: {
+            bm::MatchTable::Entry entry;
+            rc = mt_get_entry(0, table_name, op.handle, &entry);
+            if (rc == bm::MatchErrorCode::SUCCESS)
+            {
+                rc = mt_delete_entry(0, table_name, op.handle);
+            }
+            if (rc == bm::MatchErrorCode::SUCCESS)
+            {
+                undo_log.emplace_back(i, [this, &restored, table_name, entry]() {
+                    bm::entry_handle_t handle;
+                    if (mt_add_entry(0,
+                                     table_name,
+                                     entry.match_key,
+                                     entry.action_fn->get_name(),
+                                     entry.action_data,
+                                     &handle,
+                                     entry.priority) != bm::MatchErrorCode::SUCCESS)
+                    {
+                        return false;
+                    }
+                    restored[{table_name, entry.handle}] = handle;
+                    return true;
+                });
+            }
+            break;
+        }
+        case Op::TABLE_SET_DEFAULT: {
+            bm::MatchTable::Entry entry;
+            bool had_default = mt_get_default_entry(0, table_name, &entry) ==
+                                   bm::MatchErrorCode::SUCCESS &&
+                               entry.action_fn != nullptr;
+            rc = mt_set_default_action(0,
+                                       table_name,
+                                       item.action->name,
+                                       std::move(item.action_data));
+            if (rc == bm::MatchErrorCode::SUCCESS && had_default)
+            {
+                undo_log.emplace_back(i, [this, table_name, entry]() {
+                    return mt_set_default_action(0,
+                                                 table_name,
+                                                 entry.action_fn->get_name(),
+                                                 entry.action_data) ==
+                           bm::MatchErrorCode::SUCCESS;
+                });
+            }
+            else if (rc == bm::MatchErrorCode::SUCCESS)
+            {
+                undo_log.emplace_back(i, [this, table_name]() {
+                    return mt_reset_default_entry(0, table_name) == bm::MatchErrorCode::SUCCESS;
+                });
+            }
+            break;
+        }
+        case Op::MC_NODE_UPDATE: {
+            bm::McSimplePre::PortMap previous = mc_node_ports[op.node_handle];
+            mc_ok = pre->mc_node_update(op.node_handle, item.ports, bm::McSimplePreLAG::LagMap()) ==
+                    bm::McSimplePre::SUCCESS;
+            if (mc_ok)
+            {
+                mc_node_ports[op.node_handle] = item.ports;
+                undo_log.emplace_back(i, [this, node = op.node_handle, previous]() {
+                    if (pre->mc_node_update(node, previous, bm::McSimplePreLAG::LagMap()) !=
+                        bm::McSimplePre::SUCCESS)
+                    {
+                        return false;
+                    }
+                    mc_node_ports[node] = previous;
+                    return true;
+                });
+            }
+            break;
+        }
+        case Op::MC_NODE_ASSOCIATE:
+            mc_ok = mc_node_associate(op.mgrp_handle, op.node_handle) == bm::McSimplePre::SUCCESS;
+            if (mc_ok)
+            {
+                undo_log.emplace_back(i, [this, mgrp = op.mgrp_handle, node = op.node_handle]() {
+                    return mc_node_dissociate(mgrp, node) == bm::McSimplePre::SUCCESS;
+                });
+            }
+            break;
+        case Op::MC_NODE_DISSOCIATE:
+            mc_ok = mc_node_dissociate(op.mgrp_handle, op.node_handle) == bm::McSimplePre::SUCCESS;
+            if (mc_ok)
+            {
+                undo_log.emplace_back(i, [this, mgrp = op.mgrp_handle, node = op.node_handle]() {
+                    return mc_node_associate(mgrp, node) == bm::McSimplePre::SUCCESS;
+                });
+            }
+            break;
+        }
+
+        if (rc != bm::MatchErrorCode::SUCCESS || !mc_ok)
+        {
+            error = "change " + std::to_string(i) + ": " +
+                    (mc_ok ? match_error_to_string(rc) : std::string("invalid PRE operation"));
+            for (auto it = undo_log.rbegin(); it != undo_log.rend(); it++)
+            {
+                if (!it->second())
+                {
+                    error += "; undo of change " + std::to_string(it->first) + " failed";
+                }
+            }
+            for (const auto& entry : restored)
+            {
+                error += "; entry " + std::to_string(entry.first.second) + " of " +
+                         entry.first.first + " restored as " + std::to_string(entry.second);
+            }
+            return false;
+        }
+    }
+
+    transaction.added_handles = std::move(added_handles);
+    return true;
+}
+
+bm::RegisterErrorCode
+P4Pipeline::register_read(const std::string& register_name, size_t index, uint64_t* value)
+{
+    const P4ProgramInfo::Register* reg = program_info->GetRegister(register_name);
+    if (!reg)
+    {
+        return bm::RegisterErrorCode::INVALID_REGISTER_NAME;
+    }
+
+    bm::Data data;
+    bm::RegisterErrorCode rc = register_read(0, reg->name, index, &data);
+    if (rc == bm::RegisterErrorCode::SUCCESS)
+    {
+        *value = data.get_uint64();
+    }
+    return rc;
+}
+
+bm::RegisterErrorCode
+P4Pipeline::register_write(const std::string& register_name, size_t index, uint64_t value)
+{
+    const P4ProgramInfo::Register* reg = program_info->GetRegister(register_name);
+    if (!reg)
+    {
+        return bm::RegisterErrorCode::INVALID_REGISTER_NAME;
+    }
+
+    return register_write(0, reg->name, index, bm::Data(value));
+}
+
+bool
+P4Pipeline::dump_table_snapshot(const std::string& path, std::string& error)
+{
+    snapshot_writer writer;
+    writer.buffer.append(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    writer.put_u32(SNAPSHOT_VERSION);
+    writer.put_u32(program_info->GetTables().size());
+
+    for (const auto& table : program_info->GetTables())
+    {
+        writer.put_string(table.name);
+
+        // A const default action is already set when the program is loaded
+        bm::MatchTable::Entry default_entry;
+        bool has_default = !table.constDefaultEntry &&
+                           mt_get_default_entry(0, table.name, &default_entry) ==
+                               bm::MatchErrorCode::SUCCESS &&
+                           default_entry.action_fn != nullptr;
+        writer.put_u8(has_default);
+        if (has_default)
+        {
+            writer.put_string(default_entry.action_fn->get_name());
+            writer.put_action_data(default_entry.action_data);
+        }
+
+        // Empty for the tables bound to action profiles, which are not supported
+        std::vector<bm::MatchTable::Entry> entries = mt_get_entries(0, table.name);
+        writer.put_u32(entries.size());
+        writer.put_u32(table.key.size());
+        for (const auto& entry : entries)
+        {
+            writer.put_string(entry.action_fn->get_name());
+            writer.put_i32(entry.priority);
+            for (const auto& param : entry.match_key)
+            {
+                writer.put_u8(static_cast<uint8_t>(param.type));
+                writer.put_string(param.key);
+                writer.put_string(param.mask);
+                writer.put_i32(param.prefix_length);
+            }
+            writer.put_action_data(entry.action_data);
+        }
+    }
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    bool written = std::fwrite(writer.buffer.data(), 1, writer.buffer.size(), file) ==
+                   writer.buffer.size();
+    written = (std::fclose(file) == 0) && written;
+    if (!written)
+    {
+        error = "cannot write " + path;
+    }
+    return written;
+}
+
+bool
+P4Pipeline::load_table_snapshot(const std::string& path, std::string& error)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        error = "cannot open " + path;
+        return false;
+    }
+
+    size_t size = st.st_size;
+    void* data = (size > 0) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        error = "cannot map " + path;
+        return false;
+    }
+
+    snapshot_reader reader{static_cast<const char*>(data), static_cast<const char*>(data) + size};
+    bool valid = reader.has(sizeof(SNAPSHOT_MAGIC)) &&
+                 std::memcmp(reader.pos, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0;
+    reader.pos += valid ? sizeof(SNAPSHOT_MAGIC) : 0;
+    if (!valid || reader.get_u32() != SNAPSHOT_VERSION)
+    {
+        munmap(data, size);
+        error = path + " is not a table snapshot";
+        return false;
+    }
+
+    /* The content of a table in the snapshot */
+    struct snapshot_entry
+    {
+        const P4ProgramInfo::Action* action;
+        int priority;
+        std::vector<bm::MatchKeyParam> match_key;
+        bm::ActionData action_data;
+    };
+    struct snapshot_table
+    {
+        const P4ProgramInfo::Table* table;
+        const P4ProgramInfo::Action* default_action;
+        bm::ActionData default_data;
+        std::vector<snapshot_entry> entries;
+    };
+
+    // Read and check the whole file before changing any table
+    std::string table_name;
+    std::string action_name;
+    std::string key;
+    std::string mask;
+    std::string bytes;
+    uint32_t n_tables = reader.get_u32();
+    if (n_tables > program_info->GetTables().size())
+    {
+        munmap(data, size);
+        error = path + " has more tables than the program";
+        return false;
+    }
+    std::vector<snapshot_table> tables(n_tables);
+    for (size_t t = 0; t < tables.size() && reader.ok && error.empty(); t++)
+    {
+        snapshot_table& item = tables[t];
+        reader.get_string(table_name);
+        item.table = program_info->GetTable(table_name);
+        if (reader.ok && item.table == nullptr)
+        {
+            error = "unknown table " + table_name;
+            break;
+        }
+
+        item.default_action = nullptr;
+        if (reader.get_u8())
+        {
+            reader.get_string(action_name);
+            reader.get_action_data(item.default_data, bytes);
+            // Saved by older dumps, a const default action is already set
+            if (reader.ok && !item.table->constDefaultEntry)
+            {
+                item.default_action = program_info->GetAction(action_name, item.table);
+                if (item.default_action == nullptr)
+                {
+                    error = "unknown action " + action_name + " of " + item.table->name;
+                }
+            }
+        }
+
+        uint32_t n_entries = reader.get_u32();
+        uint32_t n_fields = reader.get_u32();
+        if (reader.ok && error.empty() && n_fields != item.table->key.size())
+        {
+            error = "wrong key size for " + item.table->name;
+        }
+        for (uint32_t e = 0; e < n_entries && reader.ok && error.empty(); e++)
+        {
+            snapshot_entry entry;
+            reader.get_string(action_name);
+            entry.priority = reader.get_i32();
+            for (uint32_t f = 0; f < n_fields; f++)
+            {
+                auto type = static_cast<bm::MatchKeyParam::Type>(reader.get_u8());
+                reader.get_string(key);
+                reader.get_string(mask);
+                int prefix_length = reader.get_i32();
+                switch (type)
+                {
+                case bm::MatchKeyParam::Type::LPM:
+                    entry.match_key.emplace_back(type, key, prefix_length);
+                    break;
+                case bm::MatchKeyParam::Type::TERNARY:
+                case bm::MatchKeyParam::Type::RANGE:
+                case bm::MatchKeyParam::Type::OPTIONAL:
+                    entry.match_key.emplace_back(type, key, mask);
+                    break;
+                default:
+                    entry.match_key.emplace_back(type, key);
+                    break;
+                }
+            }
+            reader.get_action_data(entry.action_data, bytes);
+
+            entry.action = reader.ok ? program_info->GetAction(action_name, item.table) : nullptr;
+            if (reader.ok && entry.action == nullptr)
+            {
+                error = "unknown action " + action_name + " of " + item.table->name;
+            }
+            item.entries.push_back(std::move(entry));
+        }
+    }
+
+    munmap(data, size);
+    if (error.empty() && !reader.ok)
+    {
+        error = path + " is truncated";
+    }
+    if (!error.empty())
+    {
+        return false;
+    }
+
+    for (auto& item : tables)
+    {
+        const std::string& name = item.table->name;
+        if (item.default_action != nullptr &&
+            mt_set_default_action(0,
+                                  name,
+                                  item.default_action->name,
+                                  std::move(item.default_data)) != bm::MatchErrorCode::SUCCESS)
+        {
+            error = "cannot set the default action of " + name;
+            return false;
+        }
+
+        for (auto& entry : item.entries)
+        {
+            bm::entry_handle_t handle;
+            bm::MatchErrorCode rc = mt_add_entry(0,
+                                                 name,
+                                                 entry.match_key,
+                                                 entry.action->name,
+                                                 std::move(entry.action_data),
+                                                 &handle,
+                                                 entry.priority);
+            if (rc != bm::MatchErrorCode::SUCCESS)
+            {
+                error = "cannot add an entry to " + name + ": " + match_error_to_string(rc);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+const P4ProgramInfo&
+P4Pipeline::get_program_info() const
+{
+    return *program_info;
+}
+
+bool
+P4Pipeline::add_header_mapping(const std::string& header_type, const std::string& type_id_name)
+{
+    if (type_id_name.empty())
+    {
+        header_types.erase(header_type);
+        build_header_mappings();
+        return true;
+    }
+
+    TypeId tid;
+    if (!TypeId::LookupByNameFailSafe(type_id_name, &tid) || !tid.HasConstructor() ||
+        !tid.IsChildOf(Header::GetTypeId()))
+    {
+        NS_LOG_WARN("Cannot map header type " << header_type << " to " << type_id_name);
+        return false;
+    }
+
+    header_types[header_type] = tid;
+    build_header_mappings();
+    return true;
+}
+
+void
+P4Pipeline::set_header_reconstruction(bool enable)
+{
+    reconstruct_headers = enable;
+}
+
+bool
+P4Pipeline::set_event_sink(std::shared_ptr<P4EventSink> sink, const std::string& field_name)
+{
+    if (!sink)
+    {
+        event_sink = nullptr;
+        return true;
+    }
+
+    size_t dot = field_name.rfind('.');
+    if (dot == std::string::npos)
+    {
+        return false;
+    }
+    std::string header_name = field_name.substr(0, dot);
+    std::string field = field_name.substr(dot + 1);
+
+    for (const auto& header : program_info->GetHeaders())
+    {
+        if (header.name != header_name)
+        {
+            continue;
+        }
+        for (size_t i = 0; i < header.fields.size(); i++)
+        {
+            if (header.fields[i] == field)
+            {
+                event_sink = std::move(sink);
+                event_header = header.id;
+                event_field = i;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+const char*
+P4PipelineStats::get_stage_name(Stage stage)
+{
+    static const char* names[N_STAGES] = {"parser", "ingress", "traffic_manager", "egress",
+                                          "deparser"};
+    return names[stage];
+}
+
+void
+P4Pipeline::enable_stats(bool counters, uint32_t timing_sample)
+{
+    stats_counters = counters;
+    this->timing_sample = timing_sample;
+    timing_countdown = timing_sample;
+
+    size_t n_tables = 0;
+    for (const auto& table : program_info->GetTables())
+    {
+        n_tables = std::max<size_t>(n_tables, table.id + 1);
+    }
+    size_t n_actions = 0;
+    for (const auto& action : program_info->GetActions())
+    {
+        n_actions = std::max<size_t>(n_actions, action.id + 1);
+    }
+    stats.table_hits.resize(n_tables);
+    stats.table_misses.resize(n_tables);
+    stats.action_runs.resize(n_actions);
+
+    if (counters)
+    {
+        static std::once_flag event_logger_init;
+        std::call_once(event_logger_init, []() {
+            bm::EventLogger::init(std::unique_ptr<bm::TransportIface>(new stats_transport()));
+        });
+    }
+}
+
+const P4PipelineStats&
+P4Pipeline::get_stats() const
+{
+    return stats;
+}
+
+void
+P4Pipeline::dump_stats(std::ostream& os) const
+{
+    if (stats_counters)
+    {
+        for (const auto& table : program_info->GetTables())
+        {
+            os << "table " << table.name << " hits=" << stats.table_hits[table.id]
+               << " misses=" << stats.table_misses[table.id] << "\n";
+        }
+        for (const auto& action : program_info->GetActions())
+        {
+            os << "action " << action.name << " runs=" << stats.action_runs[action.id] << "\n";
+        }
+    }
+
+    if (stats.lookup_cache_hits + stats.lookup_cache_misses > 0)
+    {
+        os << "lookup_cache hits=" << stats.lookup_cache_hits
+           << " misses=" << stats.lookup_cache_misses << " hit_rate="
+           << double(stats.lookup_cache_hits) /
+                  (stats.lookup_cache_hits + stats.lookup_cache_misses)
+           << "\n";
+    }
+
+    for (int stage = 0; stage < P4PipelineStats::N_STAGES; stage++)
+    {
+        uint64_t samples = 0;
+        std::ostringstream buckets;
+        for (uint32_t i = 0; i < P4PipelineStats::HISTOGRAM_BUCKETS; i++)
+        {
+            if (stats.stage_ns[stage][i] > 0)
+            {
+                samples += stats.stage_ns[stage][i];
+                buckets << " " << (1ULL << i) << "-" << (2ULL << i) - 1 << ":"
+                        << stats.stage_ns[stage][i];
+            }
+        }
+        if (samples > 0)
+        {
+            os << "stage " << P4PipelineStats::get_stage_name(P4PipelineStats::Stage(stage))
+               << " samples=" << samples << " ns_per_packet" << buckets.str() << "\n";
+        }
+    }
+}
+
+void
+P4Pipeline::count_event(const char* msg, int len)
+{
+    P4Pipeline* pipeline = stats_pipeline;
+    if (pipeline == nullptr || len < static_cast<int>(sizeof(event_msg_hdr) + sizeof(int)))
+    {
+        return;
+    }
+
+    int type;
+    int id;
+    std::memcpy(&type, msg, sizeof(type));
+    std::memcpy(&id, msg + sizeof(event_msg_hdr), sizeof(id));
+
+    std::vector<uint64_t>* counters;
+    switch (type)
+    {
+    case EVENT_TABLE_HIT:
+        counters = &pipeline->stats.table_hits;
+        break;
+    case EVENT_TABLE_MISS:
+        counters = &pipeline->stats.table_misses;
+        break;
+    case EVENT_ACTION_EXECUTE:
+        counters = &pipeline->stats.action_runs;
+        break;
+    default:
+        return;
+    }
+
+    if (id >= 0 && static_cast<size_t>(id) < counters->size())
+    {
+        (*counters)[id]++;
+    }
+}
+
+void
+P4Pipeline::record_stage(P4PipelineStats::Stage stage,
+                         std::chrono::steady_clock::time_point start,
+                         size_t n_packets)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    uint64_t per_packet = ns / std::max<size_t>(n_packets, 1);
+    uint32_t bucket = 0;
+    while (bucket + 1 < P4PipelineStats::HISTOGRAM_BUCKETS && (per_packet >> (bucket + 1)) > 0)
+    {
+        bucket++;
+    }
+    stats.stage_ns[stage][bucket]++;
+}
+
+void
+P4Pipeline::build_header_mappings()
+{
+    const std::vector<P4ProgramInfo::HeaderInstance>& headers = program_info->GetHeaders();
+
+    deparsed_headers.clear();
+    for (uint32_t id : program_info->GetDeparserHeaderIds())
+    {
+        DeparsedHeader deparsed;
+        deparsed.id = id;
+        auto it = header_types.find(headers[id].type);
+        if (it != header_types.end())
+        {
+            // One instance per deparsed header, the same type can appear more than once
+            deparsed.header.reset(dynamic_cast<Header*>(it->second.GetConstructor()()));
+        }
+        deparsed_headers.push_back(std::move(deparsed));
+    }
+}
+
+bool
+P4Pipeline::build_match_key(const P4ProgramInfo::Table& table,
+                            const std::vector<std::string>& match_key,
+                            std::vector<bm::MatchKeyParam>* params) const
+{
+    if (match_key.size() != table.key.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < match_key.size(); i++)
+    {
+        const P4ProgramInfo::KeyField& field = table.key[i];
+        const std::string& value = match_key[i];
+        std::string key;
+        std::string mask;
+
+        switch (field.matchType)
+        {
+        case P4ProgramInfo::MATCH_EXACT:
+            if (!parse_param(value, field.bitwidth, key))
+            {
+                return false;
+            }
+            params->emplace_back(bm::MatchKeyParam::Type::EXACT, key);
+            break;
+        case P4ProgramInfo::MATCH_LPM: {
+            size_t slash = value.find('/');
+            uint64_t prefix_length;
+            if (slash == std::string::npos ||
+                !parse_param(value.substr(0, slash), field.bitwidth, key) ||
+                !parse_uint(value.substr(slash + 1), prefix_length) ||
+                prefix_length > field.bitwidth)
+            {
+                return false;
+            }
+            params->emplace_back(bm::MatchKeyParam::Type::LPM,
+                                 key,
+                                 static_cast<int>(prefix_length));
+            break;
+        }
+        case P4ProgramInfo::MATCH_TERNARY: {
+            size_t sep = value.find("&&&");
+            if (sep == std::string::npos || !parse_param(value.substr(0, sep), field.bitwidth, key) ||
+                !parse_param(value.substr(sep + 3), field.bitwidth, mask))
+            {
+                return false;
+            }
+            params->emplace_back(bm::MatchKeyParam::Type::TERNARY, key, mask);
+            break;
+        }
+        case P4ProgramInfo::MATCH_RANGE: {
+            size_t sep = value.find("->");
+            if (sep == std::string::npos || !parse_param(value.substr(0, sep), field.bitwidth, key) ||
+                !parse_param(value.substr(sep + 2), field.bitwidth, mask))
+            {
+                return false;
+            }
+            params->emplace_back(bm::MatchKeyParam::Type::RANGE, key, mask);
+            break;
+        }
+        case P4ProgramInfo::MATCH_VALID: {
+            uint64_t valid;
+            if (!parse_uint(value, valid))
+            {
+                return false;
+            }
+            params->emplace_back(bm::MatchKeyParam::Type::VALID, std::string(1, valid ? 1 : 0));
+            break;
+        }
+        default:
+            NS_LOG_ERROR("Match type " << P4ProgramInfo::MatchTypeToString(field.matchType)
+                                       << " is not supported");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool
+P4Pipeline::build_action_data(const P4ProgramInfo::Action& action,
+                              const std::vector<std::string>& action_params,
+                              bm::ActionData* action_data) const
+{
+    if (action_params.size() != action.params.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < action_params.size(); i++)
+    {
+        std::string bytes;
+        if (!parse_param(action_params[i], action.params[i].bitwidth, bytes))
+        {
+            return false;
+        }
+        action_data->push_back_action_data(bytes.data(), bytes.size());
+    }
+
+    return true;
+}
+
+void
+P4Pipeline::start_and_return_()
+{
+}
+
+int
+P4Pipeline::receive_(bm::DevMgr::port_t, const char* buffer, int len)
+{
+    return 0;
+}
+
+void
+P4Pipeline::process(Ptr<const Packet> ns3_packet,
+                    uint32_t ingress_port,
+                    std::vector<P4PipelineOutput>& output)
+{
+    single_input.clear();
+    single_input.push_back({ns3_packet, ingress_port});
+    process_batch(single_input, output);
+}
+
+void
+P4Pipeline::process_batch(const std::vector<P4PipelineInput>& input,
+                          std::vector<P4PipelineOutput>& output)
+{
+    prepare_batch(input);
+    run_batch();
+    finish_batch(output);
+}
+
+void
+P4Pipeline::prepare_batch(const std::vector<P4PipelineInput>& input)
+{
+    pkts_in_ingress.clear();
+    pkts_to_egress.clear();
+    pkts_to_output.clear();
+    batch_origins.clear();
+
+    batch_timestamp = Simulator::Now().GetNanoSeconds();
+    for (uint32_t i = 0; i < input.size(); i++)
+    {
+        pkts_in_ingress.push_back({i, {}, 0, get_bm_packet(input[i].packet, input[i].port)});
+        if (traffic_manager)
+        {
+            batch_origins.push_back(input[i].packet);
+        }
+    }
+}
+
+void
+P4Pipeline::run_batch(bool one_by_one)
+{
+    std::lock_guard<std::mutex> lock(processing_lock);
+    stats_pipeline = stats_counters ? this : nullptr;
+    timing_batch = timing_sample > 0 && --timing_countdown == 0;
+    if (timing_batch)
+    {
+        timing_countdown = timing_sample;
+    }
+
+    for (auto& item : pkts_in_ingress)
+    {
+        this->init_metadata(item.packet);
+    }
+
+    std::vector<IngressPacket> pending;
+    if (one_by_one)
+    {
+        pending.swap(pkts_in_ingress);
+    }
+
+    size_t next = 0;
+    do
+    {
+        if (one_by_one)
+        {
+            pkts_in_ingress.push_back(std::move(pending[next++]));
+        }
+
+        // Recirculated packets go through ingress again
+        while (!pkts_in_ingress.empty())
+        {
+            this->run_ingress();
+            if (!traffic_manager)
+            {
+                // Otherwise egress runs when the packets leave the queues
+                this->run_egress();
+            }
+        }
+    } while (next < pending.size());
+
+    stats_pipeline = nullptr;
+}
+
+void
+P4Pipeline::finish_batch(std::vector<P4PipelineOutput>& output)
+{
+    if (traffic_manager)
+    {
+        enqueue_to_traffic_manager();
+    }
+
+    for (auto& item : pkts_to_output)
+    {
+        output.push_back({item.port, item.input, get_ns3_packet(std::move(item.packet))});
+    }
+
+    pkts_to_output.clear();
+    batch_origins.clear();
+}
+
+void
+P4Pipeline::enable_traffic_manager(DataRate rate,
+                                   uint32_t queue_depth,
+                                   TrafficManagerOutput output)
+{
+    traffic_manager_output = output;
+    traffic_manager.reset(new P4TrafficManager(
+        rate,
+        queue_depth,
+        [this](uint16_t port, std::unique_ptr<bm::Packet>& packet, Ptr<const Packet> origin) {
+            return process_dequeued(port, packet, origin);
+        }));
+}
+
+void
+P4Pipeline::enqueue_to_traffic_manager()
+{
+    for (auto& item : pkts_to_egress)
+    {
+        uint32_t priority = 0;
+        bm::PHV* phv = item.packet->get_phv();
+        if (phv->has_field("intrinsic_metadata.priority"))
+        {
+            priority = phv->get_field("intrinsic_metadata.priority").get_uint();
+        }
+        traffic_manager->Enqueue(item.port,
+                                 priority,
+                                 std::move(item.packet),
+                                 batch_origins[item.input]);
+    }
+    pkts_to_egress.clear();
+}
+
+uint32_t
+P4Pipeline::process_dequeued(uint16_t egress_port,
+                             std::unique_ptr<bm::Packet>& packet,
+                             Ptr<const Packet> origin)
+{
+    std::lock_guard<std::mutex> lock(processing_lock);
+
+    // Clones and recirculated packets derive from the same input packet
+    batch_timestamp = Simulator::Now().GetNanoSeconds();
+    batch_origins.assign(1, origin);
+
+    stats_pipeline = stats_counters ? this : nullptr;
+    timing_batch = timing_sample > 0 && --timing_countdown == 0;
+    if (timing_batch)
+    {
+        timing_countdown = timing_sample;
+    }
+    auto start = timing_batch ? std::chrono::steady_clock::now()
+                              : std::chrono::steady_clock::time_point();
+
+    this->process_egress(packet, egress_port, batch_timestamp);
+    this->process_egress_clone(packet, 0);
+    if (timing_batch)
+    {
+        record_stage(P4PipelineStats::STAGE_EGRESS, start, 1);
+    }
+
+    uint32_t size = 0;
+    uint16_t egress_spec_eg =
+        packet->get_phv()->get_field("standard_metadata.egress_spec").get_uint();
+    if (egress_spec_eg == drop_port)
+    {
+        BMLOG_DEBUG_PKT(*packet, "Dropping packet at the end of egress");
+    }
+    else
+    {
+        if (timing_batch)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+        deparser->deparse(packet.get());
+        if (timing_batch)
+        {
+            record_stage(P4PipelineStats::STAGE_DEPARSER, start, 1);
+        }
+        if (!this->process_recirculation(packet, 0))
+        {
+            Ptr<Packet> ns3_packet = get_ns3_packet(std::move(packet));
+            size = ns3_packet->GetSize();
+            traffic_manager_output(egress_port, ns3_packet, origin);
+        }
+    }
+
+    // Egress clones go back to the queues, recirculated packets after going through ingress
+    if (!pkts_in_ingress.empty())
+    {
+        this->run_ingress();
+    }
+    enqueue_to_traffic_manager();
+    batch_origins.clear();
+    stats_pipeline = nullptr;
+
+    return size;
+}
+
+void
+P4Pipeline::init_metadata(std::unique_ptr<bm::Packet>& packet)
+{
+    BMELOG(packet_in, *packet);
+
+    bm::PHV* phv = packet->get_phv();
+    phv->reset_metadata();
+    RegisterAccess::clear_all(packet.get());
+    phv->get_field("standard_metadata.packet_length")
+        .set(packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX));
+    phv->get_field("standard_metadata.instance_type").set(PKT_INSTANCE_TYPE_NORMAL);
+
+    if (phv->has_field("intrinsic_metadata.ingress_global_timestamp"))
+    {
+        phv->get_field("intrinsic_metadata.ingress_global_timestamp").set(batch_timestamp);
+    }
+
+    phv->get_field("standard_metadata.ingress_port").set(packet->get_ingress_port());
+}
+
+void
+P4Pipeline::process_parser(std::unique_ptr<bm::Packet>& packet)
+{
+    bm::PHV* phv = packet->get_phv();
+
+    parser->parse(packet.get());
+
+    if (phv->has_field("standard_metadata.parser_error"))
+    {
+        phv->get_field("standard_metadata.parser_error").set(packet->get_error_code().get());
+    }
+
+    if (phv->has_field("standard_metadata.checksum_error"))
+    {
+        phv->get_field("standard_metadata.checksum_error")
+            .set(packet->get_checksum_error() ? 1 : 0);
+    }
+}
+
+void
+P4Pipeline::record_event(const std::unique_ptr<bm::Packet>& packet)
+{
+    bm::Header& header = packet->get_phv()->get_header(event_header);
+    if (header.is_valid())
+    {
+        event_sink->Add(batch_timestamp,
+                        header.get_field(event_field).get_uint(),
+                        packet->get_ingress_port());
+    }
+}
+
+void
+P4Pipeline::run_ingress()
+{
+    // Each stage runs over all the packets, resubmitted packets go through them again
+    while (!pkts_in_ingress.empty())
+    {
+        auto start = timing_batch ? std::chrono::steady_clock::now()
+                                  : std::chrono::steady_clock::time_point();
+        for (auto& item : pkts_in_ingress)
+        {
+            // The parser pops the headers from the buffer, ingress clones and resubmitted
+            // packets need the original one
+            item.state = item.packet->save_buffer_state();
+            item.size = item.packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX);
+            this->process_parser(item.packet);
+            if (event_sink)
+            {
+                this->record_event(item.packet);
+            }
+        }
+        if (timing_batch)
+        {
+            record_stage(P4PipelineStats::STAGE_PARSER, start, pkts_in_ingress.size());
+            start = std::chrono::steady_clock::now();
+        }
+
+        for (auto& item : pkts_in_ingress)
+        {
+            this->process_ingress(item.packet);
+        }
+        if (timing_batch)
+        {
+            record_stage(P4PipelineStats::STAGE_INGRESS, start, pkts_in_ingress.size());
+            start = std::chrono::steady_clock::now();
+        }
+
+        pkts_resubmitted.clear();
+        for (auto& item : pkts_in_ingress)
+        {
+            this->process_traffic_manager(item);
+        }
+        if (timing_batch)
+        {
+            record_stage(P4PipelineStats::STAGE_TRAFFIC_MANAGER, start, pkts_in_ingress.size());
+        }
+        pkts_in_ingress.swap(pkts_resubmitted);
+    }
+}
+
+void
+P4Pipeline::run_egress()
+{
+    // Egress clones are appended to the packets to process, so iterate by index
+    auto start = timing_batch ? std::chrono::steady_clock::now()
+                              : std::chrono::steady_clock::time_point();
+    for (size_t i = 0; i < pkts_to_egress.size(); i++)
+    {
+        std::unique_ptr<bm::Packet> packet = std::move(pkts_to_egress[i].packet);
+        this->process_egress(packet, pkts_to_egress[i].port, batch_timestamp);
+        this->process_egress_clone(packet, pkts_to_egress[i].input);
+        pkts_to_egress[i].packet = std::move(packet);
+    }
+    if (timing_batch)
+    {
+        record_stage(P4PipelineStats::STAGE_EGRESS, start, pkts_to_egress.size());
+        start = std::chrono::steady_clock::now();
+    }
+
+    for (auto& item : pkts_to_egress)
+    {
+        bm::Field& f_egress_spec_eg =
+            item.packet->get_phv()->get_field("standard_metadata.egress_spec");
+        uint16_t egress_spec_eg = f_egress_spec_eg.get_uint();
+        if (egress_spec_eg == drop_port)
+        {
+            BMLOG_DEBUG_PKT(*item.packet, "Dropping packet at the end of egress");
+            continue;
+        }
+
+        deparser->deparse(item.packet.get());
+        if (!this->process_recirculation(item.packet, item.input))
+        {
+            pkts_to_output.push_back(std::move(item));
+        }
+    }
+
+    if (timing_batch)
+    {
+        record_stage(P4PipelineStats::STAGE_DEPARSER, start, pkts_to_egress.size());
+    }
+
+    // Drops the packets that were not moved to the output
+    pkts_to_egress.clear();
+}
+
+void
+P4Pipeline::process_ingress(std::unique_ptr<bm::Packet>& packet)
+{
+    // The following is similar to what happens in bmv2 simple_switch ingress thread.
+    BMLOG_DEBUG_PKT(*packet, "Processing packet");
+
+    ingress_mau->apply(packet.get());
+    packet->reset_exit();
+}
+
+void
+P4Pipeline::process_traffic_manager(IngressPacket& item)
+{
+    // The following is similar to what happens in bmv2 simple_switch ingress thread.
+    std::unique_ptr<bm::Packet>& packet = item.packet;
+    bm::PHV* phv = packet->get_phv();
+
+    uint16_t clone_mirror_session_id = RegisterAccess::get_clone_mirror_session_id(packet.get());
+    uint16_t clone_field_list = RegisterAccess::get_clone_field_list(packet.get());
+    if (clone_mirror_session_id)
+    {
+        BMLOG_DEBUG_PKT(*packet, "Cloning packet at ingress");
+        RegisterAccess::set_clone_mirror_session_id(packet.get(), 0);
+        RegisterAccess::set_clone_field_list(packet.get(), 0);
+        MirroringSessionConfig config;
+        clone_mirror_session_id &= RegisterAccess::MIRROR_SESSION_ID_MASK;
+        if (mirroring_get_session(clone_mirror_session_id, &config))
+        {
+            const bm::Packet::buffer_state_t packet_out_state = packet->save_buffer_state();
+            packet->restore_buffer_state(item.state);
+            std::unique_ptr<bm::Packet> packet_copy = packet->clone_no_phv_ptr();
+            RegisterAccess::clear_all(packet_copy.get());
+            packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, item.size);
+            // Parse again instead of copying the PHV of every ingress packet
+            parser->parse(packet_copy.get());
+            copy_field_list_and_set_type(packet,
+                                         packet_copy,
+                                         PKT_INSTANCE_TYPE_INGRESS_CLONE,
+                                         clone_field_list);
+            enqueue_clone(std::move(packet_copy), config, item.input);
+            packet->restore_buffer_state(packet_out_state);
+        }
+    }
+
+    uint16_t resubmit_flag = RegisterAccess::get_resubmit_flag(packet.get());
+    if (resubmit_flag)
+    {
+        BMLOG_DEBUG_PKT(*packet, "Resubmitting packet");
+        packet->restore_buffer_state(item.state);
+        RegisterAccess::set_resubmit_flag(packet.get(), 0);
+        std::unique_ptr<bm::Packet> packet_copy = packet->clone_no_phv_ptr();
+        copy_field_list_and_set_type(packet,
+                                     packet_copy,
+                                     PKT_INSTANCE_TYPE_RESUBMIT,
+                                     resubmit_flag);
+        RegisterAccess::clear_all(packet_copy.get());
+        packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, item.size);
+        packet_copy->get_phv()->get_field("standard_metadata.packet_length").set(item.size);
+        pkts_resubmitted.push_back({item.input, {}, 0, std::move(packet_copy)});
+        return;
+    }
+
+    bm::Field& f_instance_type = phv->get_field("standard_metadata.instance_type");
+    bm::Field& f_egress_spec_ig = phv->get_field("standard_metadata.egress_spec");
+    uint16_t egress_spec_ig = f_egress_spec_ig.get_uint();
+
+    unsigned int mgid = 0u;
+    if (phv->has_field("intrinsic_metadata.mcast_grp"))
+    {
+        bm::Field& f_mgid = phv->get_field("intrinsic_metadata.mcast_grp");
+        mgid = f_mgid.get_uint();
+    }
+    if (mgid != 0)
+    {
+        BMLOG_DEBUG_PKT(*packet, "Multicast requested for packet");
+        f_instance_type.set(PKT_INSTANCE_TYPE_REPLICATION);
+        this->process_multicast(std::move(packet), mgid, item.input);
+    }
+    else
+    {
+        BMLOG_DEBUG_PKT(*packet, "Egress port is {}", egress_spec_ig);
+        if (egress_spec_ig == drop_port)
+        {
+            BMLOG_DEBUG_PKT(*packet, "Dropping packet at ingress");
+        }
+        else
+        {
+            f_instance_type.set(PKT_INSTANCE_TYPE_NORMAL);
+            pkts_to_egress.push_back({egress_spec_ig, item.input, std::move(packet)});
+        }
+    }
+}
+
+void
+P4Pipeline::process_egress(std::unique_ptr<bm::Packet>& packet,
+                           uint16_t egress_port,
+                           uint64_t timestamp)
+{
+    // The following is similar to what happens in bmv2 simple_switch egress thread.
+    bm::PHV* phv = packet->get_phv();
+
+    if (phv->has_field("intrinsic_metadata.egress_global_timestamp"))
+    {
+        phv->get_field("intrinsic_metadata.egress_global_timestamp").set(timestamp);
+    }
+
+    phv->get_field("standard_metadata.egress_port").set(egress_port);
+
+    bm::Field& f_egress_spec = phv->get_field("standard_metadata.egress_spec");
+    f_egress_spec.set(drop_port + 1);
+
+    phv->get_field("standard_metadata.packet_length")
+        .set(packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX));
+
+    egress_mau->apply(packet.get());
+}
+
+void
+P4Pipeline::process_egress_clone(std::unique_ptr<bm::Packet>& packet, uint32_t input)
+{
+    uint16_t clone_mirror_session_id = RegisterAccess::get_clone_mirror_session_id(packet.get());
+    uint16_t clone_field_list = RegisterAccess::get_clone_field_list(packet.get());
+    if (!clone_mirror_session_id)
+    {
+        return;
+    }
+
+    BMLOG_DEBUG_PKT(*packet, "Cloning packet at egress");
+    RegisterAccess::set_clone_mirror_session_id(packet.get(), 0);
+    RegisterAccess::set_clone_field_list(packet.get(), 0);
+    MirroringSessionConfig config;
+    clone_mirror_session_id &= RegisterAccess::MIRROR_SESSION_ID_MASK;
+    if (!mirroring_get_session(clone_mirror_session_id, &config))
+    {
+        return;
+    }
+
+    std::unique_ptr<bm::Packet> packet_copy = packet->clone_with_phv_reset_metadata_ptr();
+    copy_field_list_and_set_type(packet,
+                                 packet_copy,
+                                 PKT_INSTANCE_TYPE_EGRESS_CLONE,
+                                 clone_field_list);
+    RegisterAccess::clear_all(packet_copy.get());
+    packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX,
+                              packet->get_register(RegisterAccess::PACKET_LENGTH_REG_IDX));
+    enqueue_clone(std::move(packet_copy), config, input);
+}
+
+bool
+P4Pipeline::process_recirculation(std::unique_ptr<bm::Packet>& packet, uint32_t input)
+{
+    uint16_t recirculate_flag = RegisterAccess::get_recirculate_flag(packet.get());
+    if (!recirculate_flag)
+    {
+        return false;
+    }
+
+    BMLOG_DEBUG_PKT(*packet, "Recirculating packet");
+    RegisterAccess::set_recirculate_flag(packet.get(), 0);
+    std::unique_ptr<bm::Packet> packet_copy = packet->clone_no_phv_ptr();
+    copy_field_list_and_set_type(packet, packet_copy, PKT_INSTANCE_TYPE_RECIRC, recirculate_flag);
+    size_t packet_size = packet_copy->get_data_size();
+    RegisterAccess::clear_all(packet_copy.get());
+    packet_copy->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, packet_size);
+    packet_copy->get_phv()->get_field("standard_metadata.packet_length").set(packet_size);
+    packet_copy->set_ingress_length(packet_size);
+    pkts_in_ingress.push_back({input, {}, 0, std::move(packet_copy)});
+    return true;
+}
+
+void
+P4Pipeline::copy_field_list_and_set_type(const std::unique_ptr<bm::Packet>& packet,
+                                         const std::unique_ptr<bm::Packet>& packet_copy,
+                                         PktInstanceType copy_type,
+                                         uint16_t field_list_id)
+{
+    bm::PHV* phv_copy = packet_copy->get_phv();
+    phv_copy->reset_metadata();
+    // Field list 0 is used by the P4_16 primitives that do not preserve any field
+    if (field_list_id > 0)
+    {
+        bm::FieldList* field_list = this->get_field_list(field_list_id);
+        field_list->copy_fields_between_phvs(phv_copy, packet->get_phv());
+    }
+    phv_copy->get_field("standard_metadata.instance_type").set(copy_type);
+}
+
+void
+P4Pipeline::enqueue_clone(std::unique_ptr<bm::Packet> packet,
+                          const MirroringSessionConfig& config,
+                          uint32_t input)
+{
+    if (config.mgid_valid)
+    {
+        BMLOG_DEBUG_PKT(*packet, "Cloning packet to MGID {}", config.mgid);
+        this->process_multicast(config.egress_port_valid ? packet->clone_with_phv_ptr()
+                                                         : std::move(packet),
+                                config.mgid,
+                                input);
+    }
+    if (config.egress_port_valid)
+    {
+        BMLOG_DEBUG_PKT(*packet, "Cloning packet to egress port {}", config.egress_port);
+        pkts_to_egress.push_back(
+            {static_cast<uint16_t>(config.egress_port), input, std::move(packet)});
+    }
+}
+
+void
+P4Pipeline::process_multicast(std::unique_ptr<bm::Packet> packet,
+                              unsigned int mgid,
+                              uint32_t input)
+{
+    auto* phv = packet->get_phv();
+    auto& f_rid = phv->get_field("intrinsic_metadata.egress_rid");
+    const auto pre_out = pre->replicate({mgid});
+    for (size_t i = 0; i < pre_out.size(); i++)
+    {
+        uint16_t egress_port = pre_out[i].egress_port;
+        BMLOG_DEBUG_PKT(*packet, "Replicating packet on port {}", egress_port);
+        f_rid.set(pre_out[i].rid);
+        if (i + 1 < pre_out.size())
+        {
+            pkts_to_egress.push_back({egress_port, input, packet->clone_with_phv_ptr()});
+        }
+        else
+        {
+            // The last replica takes the original packet, no need to clone it
+            pkts_to_egress.push_back({egress_port, input, std::move(packet)});
+        }
+        RegisterAccess::clear_all(pkts_to_egress.back().packet.get());
+    }
+}
+
+bool
+P4Pipeline::mirroring_add_session(int mirror_id, const MirroringSessionConfig& config)
+{
+    if (mirror_id < 0 || mirror_id > RegisterAccess::MAX_MIRROR_SESSION_ID)
+    {
+        return false;
+    }
+    mirroring_sessions[mirror_id] = config;
+    return true;
+}
+
+bool
+P4Pipeline::mirroring_delete_session(int mirror_id)
+{
+    return mirroring_sessions.erase(mirror_id) > 0;
+}
+
+bool
+P4Pipeline::mirroring_get_session(int mirror_id, MirroringSessionConfig* config) const
+{
+    auto it = mirroring_sessions.find(mirror_id);
+    if (it == mirroring_sessions.end())
+    {
+        return false;
+    }
+    *config = it->second;
+    return true;
+}
+
+std::unique_ptr<bm::Packet>
+P4Pipeline::get_bm_packet(Ptr<const Packet> ns3_packet, uint32_t ingress_port)
+{
+    int len = ns3_packet->GetSize();
 
-    p->AddHeader(eth);
+    if (len > MAX_PKT_SIZE)
+    {
+        BMLOG_DEBUG("Packet length {} exceeds MAX_PKT_SIZE", len);
+        std::exit(1);
+    }
+
+    // Serialize the ns-3 packet straight into the bmv2 buffer. The data sits at the end of
+    // the buffer, the rest is headroom for the headers pushed by the P4 program.
+    bm::PacketBuffer buffer(MAX_PKT_SIZE);
+    ns3_packet->CopyData(reinterpret_cast<uint8_t*>(buffer.push(len)), len);
+
+    auto packet = new_packet_ptr(ingress_port, packet_id++, len, std::move(buffer));
+    // Kept up to date by the primitives adding and removing headers
+    packet->set_register(RegisterAccess::PACKET_LENGTH_REG_IDX, len);
+    return packet;
+}
+
+Ptr<Packet>
+P4Pipeline::get_ns3_packet(std::unique_ptr<bm::Packet> bm_packet)
+{
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(bm_packet->data());
+    uint32_t size = bm_packet->get_data_size();
+
+    // The deparsed bytes become the packet payload, consumers deserialize the headers they need
+    Ptr<Packet> ns3_packet = Create<Packet>(data, size);
+    if (!reconstruct_headers)
+    {
+        return ns3_packet;
+    }
+
+    // Turn the leading deparsed headers into ns-3 Headers, in a single pass. A Header may
+    // span several P4 headers (e.g. the SRH and its segment list, TCP and its options): the
+    // following ones are then skipped as their bytes were already consumed.
+    bm::PHV* phv = bm_packet->get_phv();
+    removed_headers.clear();
+    uint32_t start = 0;
+    uint32_t consumed = 0;
+    for (auto& deparsed : deparsed_headers)
+    {
+        const bm::Header& hdr = phv->get_header(deparsed.id);
+        if (!hdr.is_valid())
+        {
+            continue;
+        }
+
+        uint32_t end = start + hdr.get_nbytes_packet();
+        if (end <= consumed)
+        {
+            start = end;
+            continue;
+        }
+        if (start != consumed || !deparsed.header || end > size)
+        {
+            break;
+        }
+
+        consumed += ns3_packet->RemoveHeader(*deparsed.header);
+        removed_headers.push_back(deparsed.header.get());
+        start = end;
+    }
+
+    if (consumed != start)
+    {
+        // A Header does not end on a P4 header boundary, leave the packet as it was deparsed
+        BMLOG_DEBUG_PKT(*bm_packet, "Cannot rebuild ns-3 headers for packet");
+        return Create<Packet>(data, size);
+    }
+
+    for (auto it = removed_headers.rbegin(); it != removed_headers.rend(); ++it)
+    {
+        ns3_packet->AddHeader(**it);
+    }
 
-    return p;
+    return ns3_packet;
 }
 } // namespace ns3
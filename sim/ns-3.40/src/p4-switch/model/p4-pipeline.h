@@ -25,21 +25,200 @@
 #define MAX_PKT_SIZE 9000
 #define DEFAULT_DROP_PORT 511
 
+#include <bm/bm_sim/logger.h>
 #include <bm/bm_sim/packet.h>
 #include <bm/bm_sim/switch.h>
 #include <bm/bm_sim/simple_pre_lag.h>
 
+#include <chrono>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
 #include <sstream>
-#include <list>
+#include <vector>
 
+#include <ns3/data-rate.h>
+#include <ns3/header.h>
 #include <ns3/pointer.h>
 #include <ns3/packet.h>
 #include <ns3/simulator.h>
+#include <ns3/p4-event-sink.h>
+#include <ns3/p4-program-info.h>
+#include <ns3/p4-traffic-manager.h>
 
 namespace ns3
 {
+   /**
+    * \ingroup p4-switch
+    *
+    * A packet emitted by the P4 pipeline, with the port it must be sent to.
+    */
+   struct P4PipelineOutput
+   {
+      uint16_t port;      //!< Egress port
+      uint32_t input;     //!< Index of the input packet it derives from
+      Ptr<Packet> packet; //!< Deparsed packet
+   };
+
+   /**
+    * \ingroup p4-switch
+    *
+    * A packet to be processed by the P4 pipeline, with the port it was received on.
+    */
+   struct P4PipelineInput
+   {
+      Ptr<const Packet> packet; //!< Received packet
+      uint32_t port;            //!< Ingress port
+   };
+
+   /**
+    * \ingroup p4-switch
+    *
+    * Counters of the P4 pipeline, see P4Pipeline::enable_stats().
+    */
+   struct P4PipelineStats
+   {
+      /**
+       * Stages timed by the histograms
+       */
+      enum Stage
+      {
+         STAGE_PARSER,          //!< Parser
+         STAGE_INGRESS,         //!< Ingress match-action pipeline
+         STAGE_TRAFFIC_MANAGER, //!< Clones, resubmission and multicast replication
+         STAGE_EGRESS,          //!< Egress match-action pipeline
+         STAGE_DEPARSER,        //!< Deparser
+         N_STAGES,
+      };
+
+      /**
+       * Histogram buckets, bucket i counts the samples of [2^i, 2^(i+1)) ns per packet
+       */
+      static const uint32_t HISTOGRAM_BUCKETS = 32;
+
+      std::vector<uint64_t> table_hits;   //!< Hits of each table, by bmv2 table id
+      std::vector<uint64_t> table_misses; //!< Misses of each table, by bmv2 table id
+      std::vector<uint64_t> action_runs;  //!< Executions of each action, by bmv2 action id
+      uint64_t stage_ns[N_STAGES][HISTOGRAM_BUCKETS] = {}; //!< Sampled time per packet
+      uint64_t lookup_cache_hits = 0;   //!< Table lookups answered by the lookup cache
+      uint64_t lookup_cache_misses = 0; //!< Table lookups that went through bmv2
+
+      /**
+       * \return the name of a stage
+       * \param stage the stage
+       */
+      static const char *get_stage_name(Stage stage);
+   };
+
+   /**
+    * \ingroup p4-switch
+    *
+    * Table and multicast changes applied as a whole by P4Pipeline::commit().
+    *
+    * The changes are only recorded, with keys and action parameters in the CLI textual format
+    * of P4Pipeline::table_add(), and are checked and applied at commit time, in order.
+    */
+   class P4PipelineTransaction
+   {
+   public:
+      /**
+       * \brief Add an entry, see P4Pipeline::table_add()
+       */
+      void table_add(const std::string &table_name, const std::string &action_name,
+                     const std::vector<std::string> &match_key,
+                     const std::vector<std::string> &action_params, int priority = -1);
+
+      /**
+       * \brief Change the action of an entry, see P4Pipeline::table_modify()
+       */
+      void table_modify(const std::string &table_name, const std::string &action_name,
+                        bm::entry_handle_t handle, const std::vector<std::string> &action_params);
+
+      /**
+       * \brief Delete an entry, see P4Pipeline::table_delete()
+       */
+      void table_delete(const std::string &table_name, bm::entry_handle_t handle);
+
+      /**
+       * \brief Set the default action of a table, see P4Pipeline::table_set_default()
+       */
+      void table_set_default(const std::string &table_name, const std::string &action_name,
+                             const std::vector<std::string> &action_params);
+
+      /**
+       * \brief Change the ports of a multicast node, see P4Pipeline::mc_node_update()
+       */
+      void mc_node_update(bm::McSimplePre::l1_hdl_t node_handle,
+                          const std::vector<uint32_t> &ports);
+
+      /**
+       * \brief Add a multicast node to a multicast group
+       */
+      void mc_node_associate(bm::McSimplePre::mgrp_hdl_t mgrp_handle,
+                             bm::McSimplePre::l1_hdl_t node_handle);
+
+      /**
+       * \brief Remove a multicast node from a multicast group
+       */
+      void mc_node_dissociate(bm::McSimplePre::mgrp_hdl_t mgrp_handle,
+                              bm::McSimplePre::l1_hdl_t node_handle);
+
+      /**
+       * \return the number of changes
+       */
+      size_t size() const;
+
+      /**
+       * \brief Remove all the changes, to reuse the transaction
+       */
+      void clear();
+
+      /**
+       * \return the handles of the entries added by the last successful commit, in order
+       */
+      const std::vector<bm::entry_handle_t> &get_added_handles() const;
+
+   private:
+      friend class P4Pipeline;
+
+      /**
+       * A recorded change
+       */
+      struct Op
+      {
+         /**
+          * Kinds of change
+          */
+         enum Type
+         {
+            TABLE_ADD,
+            TABLE_MODIFY,
+            TABLE_DELETE,
+            TABLE_SET_DEFAULT,
+            MC_NODE_UPDATE,
+            MC_NODE_ASSOCIATE,
+            MC_NODE_DISSOCIATE,
+         };
+
+         Type type;                               //!< Kind of change
+         std::string table_name;                  //!< Table, for table changes
+         std::string action_name;                 //!< Action, for table changes
+         std::vector<std::string> match_key;      //!< Key of the added entry
+         std::vector<std::string> action_params;  //!< Action parameters
+         int priority;                            //!< Priority of the added entry
+         bm::entry_handle_t handle;               //!< Modified or deleted entry
+         bm::McSimplePre::mgrp_hdl_t mgrp_handle; //!< Multicast group
+         bm::McSimplePre::l1_hdl_t node_handle;   //!< Multicast node
+         std::vector<uint32_t> ports;             //!< Ports of the multicast node
+      };
+
+      std::vector<Op> ops;
+      std::vector<bm::entry_handle_t> added_handles;
+   };
+
    /**
     * \ingroup p4-switch
     *
@@ -51,14 +230,279 @@ namespace ns3
    public:
       /**
        * \brief P4Pipeline constructor
+       *
+       * \param jsonFile the bmv2 JSON file
+       * \param name the name of the switch, used for logs and IPC endpoints
+       * \param enableThrift if true, start the Thrift runtime server (for an external
+       *        simple_switch_CLI) and the nanomsg notification socket. Otherwise the pipeline
+       *        can only be controlled in-process and uses no server threads or sockets.
+       * \param logLevel the bmv2 log level, OFF disables the console logger. The bmv2 logger
+       *        is shared by all the pipelines, so the last pipeline created sets it.
+       * \param lookupCacheSize if not 0, exact and LPM tables remember the result of up to this
+       *        many lookups, by key, until an entry is added or deleted. This saves the trie
+       *        walks of LPM tables when their content rarely changes. The hits are counted in
+       *        get_stats().
        */
-      P4Pipeline(std::string jsonFile, std::string name);
+      P4Pipeline(std::string jsonFile, std::string name, bool enableThrift = true,
+                 bm::Logger::LogLevel logLevel = bm::Logger::LogLevel::INFO,
+                 size_t lookupCacheSize = 0);
 
       /**
        * \brief Run the provided CLI commands to populate table entries
+       *
+       * Commands use the simple_switch_CLI syntax, one per line, and are executed
+       * in-process through the runtime interface. The returned output mimics the one
+       * of the CLI (e.g. "Entry has been added with handle 3").
        */
       std::string run_cli_commands(std::string commands);
 
+      /**
+       * \brief Add an entry to a match-action table
+       *
+       * Key fields and action parameters are given in the CLI textual format
+       * (e.g. "2001:db8::/64" for an LPM field, "10.0.0.1&&&0xffffff00" for a ternary one).
+       * Table and action names can be abbreviated to any unique suffix.
+       *
+       * \param table_name the table name
+       * \param action_name the action name
+       * \param match_key one value per key field
+       * \param action_params one value per action parameter
+       * \param handle filled with the handle of the new entry
+       * \param priority the entry priority, only used by ternary and range tables
+       * \return the bmv2 error code
+       */
+      bm::MatchErrorCode table_add(const std::string &table_name, const std::string &action_name,
+                                   const std::vector<std::string> &match_key,
+                                   const std::vector<std::string> &action_params,
+                                   bm::entry_handle_t *handle, int priority = -1);
+
+      /**
+       * \brief Change the action of an existing table entry
+       */
+      bm::MatchErrorCode table_modify(const std::string &table_name, const std::string &action_name,
+                                      bm::entry_handle_t handle,
+                                      const std::vector<std::string> &action_params);
+
+      /**
+       * \brief Delete an entry from a match-action table
+       */
+      bm::MatchErrorCode table_delete(const std::string &table_name, bm::entry_handle_t handle);
+
+      /**
+       * \brief Set the default action of a match-action table
+       */
+      bm::MatchErrorCode table_set_default(const std::string &table_name,
+                                           const std::string &action_name,
+                                           const std::vector<std::string> &action_params);
+
+      /**
+       * \brief Create a multicast group, the returned handle is used to associate nodes
+       */
+      bm::McSimplePre::McReturnCode mc_mgrp_create(unsigned int mgid,
+                                                   bm::McSimplePre::mgrp_hdl_t *handle);
+
+      /**
+       * \brief Destroy a multicast group
+       */
+      bm::McSimplePre::McReturnCode mc_mgrp_destroy(bm::McSimplePre::mgrp_hdl_t handle);
+
+      /**
+       * \brief Create a multicast node replicating to the given ports with the given rid
+       */
+      bm::McSimplePre::McReturnCode mc_node_create(unsigned int rid,
+                                                   const std::vector<uint32_t> &ports,
+                                                   bm::McSimplePre::l1_hdl_t *handle);
+
+      /**
+       * \brief Change the ports a multicast node replicates to
+       */
+      bm::McSimplePre::McReturnCode mc_node_update(bm::McSimplePre::l1_hdl_t handle,
+                                                   const std::vector<uint32_t> &ports);
+
+      /**
+       * \brief Destroy a multicast node
+       */
+      bm::McSimplePre::McReturnCode mc_node_destroy(bm::McSimplePre::l1_hdl_t handle);
+
+      /**
+       * \brief Add a multicast node to a multicast group
+       */
+      bm::McSimplePre::McReturnCode mc_node_associate(bm::McSimplePre::mgrp_hdl_t mgrp_handle,
+                                                      bm::McSimplePre::l1_hdl_t node_handle);
+
+      /**
+       * \brief Remove a multicast node from a multicast group
+       */
+      bm::McSimplePre::McReturnCode mc_node_dissociate(bm::McSimplePre::mgrp_hdl_t mgrp_handle,
+                                                       bm::McSimplePre::l1_hdl_t node_handle);
+
+      /**
+       * \brief Apply all the changes of a transaction, or none of them
+       *
+       * All the changes are checked first, against the current state and the changes before
+       * them: names, keys and action parameters, handles of modified and deleted entries, keys
+       * of added entries, and multicast nodes and groups. An invalid change fails the commit
+       * before anything is modified. The changes are then applied in order while no packet is
+       * processed. Only a resource limit, as a full table, can still fail a change: the ones
+       * already applied are then undone in reverse order, so packets see the tables and
+       * multicast groups either as they were before the commit or as they are after it.
+       * Entries deleted and restored by an undo get a new handle, reported in error with any
+       * undo that failed.
+       *
+       * Multicast nodes and groups created through Thrift cannot be changed in a transaction,
+       * as their state is not known to the pipeline.
+       *
+       * \param transaction the changes, the handles of the added entries are stored in it
+       * \param error filled with a description of the failed change and of the rollback
+       * \return true if all the changes were applied
+       */
+      bool commit(P4PipelineTransaction &transaction, std::string &error);
+
+      /**
+       * Configuration of a mirroring session, as in simple_switch
+       */
+      struct MirroringSessionConfig
+      {
+         uint32_t egress_port = 0;       //!< Port the clones are sent to
+         bool egress_port_valid = false; //!< Whether to send the clones to egress_port
+         unsigned int mgid = 0;          //!< Multicast group the clones are replicated to
+         bool mgid_valid = false;        //!< Whether to replicate the clones to mgid
+      };
+
+      /**
+       * \brief Add (or replace) a mirroring session, used by the clone primitives
+       * \return false if the session id is out of range
+       */
+      bool mirroring_add_session(int mirror_id, const MirroringSessionConfig &config);
+
+      /**
+       * \brief Delete a mirroring session
+       * \return false if the session does not exist
+       */
+      bool mirroring_delete_session(int mirror_id);
+
+      /**
+       * \brief Get the configuration of a mirroring session
+       * \return false if the session does not exist
+       */
+      bool mirroring_get_session(int mirror_id, MirroringSessionConfig *config) const;
+
+      using bm::Switch::register_read;
+      using bm::Switch::register_write;
+
+      /**
+       * \brief Read a register cell, the name can be abbreviated to any unique suffix
+       */
+      bm::RegisterErrorCode register_read(const std::string &register_name, size_t index,
+                                          uint64_t *value);
+
+      /**
+       * \brief Write a register cell, the name can be abbreviated to any unique suffix
+       */
+      bm::RegisterErrorCode register_write(const std::string &register_name, size_t index,
+                                           uint64_t value);
+
+      /**
+       * \brief Save the entries and default actions of all the match-action tables to a file
+       *
+       * The snapshot can be loaded with load_table_snapshot() into a pipeline running the
+       * same program, e.g. to reuse across runs a table state that is slow to compute. Tables
+       * bound to action profiles are not saved, nor the default actions declared const.
+       *
+       * \param path the file to write
+       * \param error filled with a description of the problem on failure
+       * \return true on success
+       */
+      bool dump_table_snapshot(const std::string &path, std::string &error);
+
+      /**
+       * \brief Add the entries and default actions saved by dump_table_snapshot()
+       *
+       * The file is memory-mapped and read whole first: tables, actions and key sizes are
+       * checked against the program, and nothing is changed if the file does not match it.
+       * The entries are then added in a single pass, which stops at the first entry that
+       * cannot be added (e.g. a full table) with the tables partially loaded.
+       *
+       * \param path the file to read
+       * \param error filled with a description of the problem on failure
+       * \return true on success
+       */
+      bool load_table_snapshot(const std::string &path, std::string &error);
+
+      /**
+       * \brief Get the description of the loaded P4 program
+       */
+      const P4ProgramInfo &get_program_info() const;
+
+      /**
+       * \brief Map a P4 header type to an ns-3 Header, used to rebuild the output packets
+       *
+       * The mapping replaces any previous one for the same header type. An empty TypeId
+       * name removes it.
+       *
+       * \param header_type the P4 header type name (e.g. "ipv6_h")
+       * \param type_id_name the TypeId name of the ns-3 Header (e.g. "ns3::Ipv6Header")
+       * \return false if the TypeId does not exist or cannot be instantiated as a Header
+       */
+      bool add_header_mapping(const std::string &header_type, const std::string &type_id_name);
+
+      /**
+       * \brief Enable or disable the reconstruction of ns-3 headers in the output packets
+       *
+       * When enabled, the headers emitted by the deparser are added to the output packets as
+       * ns-3 Header objects (up to the first header without a mapping), so that probes and
+       * protocols can peek them without parsing the payload again. When disabled (the default),
+       * the deparsed bytes are the payload of the output packets.
+       */
+      void set_header_reconstruction(bool enable);
+
+      /**
+       * \brief Record a header field of every parsed packet to an event sink
+       *
+       * After parsing, the value of the field, the ingress timestamp and the ingress port of
+       * each packet where the header is valid are added to the sink. This is a cheap
+       * replacement for log_msg() when analysing per-packet values offline.
+       *
+       * \param sink the sink, nullptr stops recording
+       * \param field_name the field, as "header.field" (e.g. "srv6_ll_tlv.seq_n")
+       * \return false if the field does not exist
+       */
+      bool set_event_sink(std::shared_ptr<P4EventSink> sink, const std::string &field_name);
+
+      /**
+       * \brief Keep per-table and per-action counters, and sample the time spent in each stage
+       *
+       * Counters are collected from the bmv2 event logger (table hits and misses, action
+       * executions), which is redirected in-process the first time counters are enabled. The
+       * event logger is shared by all the pipelines, those without counters ignore its events.
+       * Nothing is counted if bmv2 was built without the event logger.
+       *
+       * \param counters whether to count table hits and misses, and action executions
+       * \param timing_sample time the stages of one batch every timing_sample, 0 disables
+       */
+      void enable_stats(bool counters, uint32_t timing_sample);
+
+      /**
+       * \return the counters, see enable_stats()
+       */
+      const P4PipelineStats &get_stats() const;
+
+      /**
+       * \brief Write the counters in a readable form, with table and action names
+       * \param os the output stream
+       */
+      void dump_stats(std::ostream &os) const;
+
+      /**
+       * \brief Count a bmv2 event, if it was generated by a pipeline with counters enabled
+       *
+       * Called by the event logger transport, from the thread processing the packet.
+       *
+       * \param msg the event message
+       * \param len the message size
+       */
+      static void count_event(const char *msg, int len);
+
       /**
        * \brief Unused
        */
@@ -71,11 +515,90 @@ namespace ns3
 
       /**
        * \brief Invoke the P4 switch processing
+       *
+       * The packets to send are appended to the caller-provided output vector, which
+       * can be cleared and reused across calls to avoid allocations.
+       */
+      void process(Ptr<const Packet> ns3_packet, uint32_t ingress_port,
+                   std::vector<P4PipelineOutput> &output);
+
+      /**
+       * \brief Invoke the P4 switch processing on a batch of packets
+       *
+       * Each stage (parser, ingress, PRE, egress, deparser) runs over the whole batch before
+       * the next one starts, as packets would flow through a real pipeline. Outputs are
+       * appended in egress order and refer to their input packet by index.
+       */
+      void process_batch(const std::vector<P4PipelineInput> &input,
+                         std::vector<P4PipelineOutput> &output);
+
+      /**
+       * \brief First step of process_batch(), converts the input packets to bmv2 packets
+       *
+       * process_batch() can be split in three steps so that the P4 processing, which does not
+       * touch any ns-3 object, can run outside of the simulation thread.
+       */
+      void prepare_batch(const std::vector<P4PipelineInput> &input);
+
+      /**
+       * \brief Second step of process_batch(), runs the P4 program over the prepared packets
+       *
+       * By default all the packets go through ingress before any of them goes through egress.
+       * With one_by_one each packet, with its clones and recirculations, goes through ingress
+       * and egress before the next one, as if processed alone.
+       *
+       * This can be called from any thread, as long as a single thread uses the pipeline.
+       *
+       * \param one_by_one whether to run the packets through the whole program one at a time
        */
-      std::list<std::pair<uint16_t, Ptr<Packet>>> *process(Ptr<const Packet> ns3_packet,
-                                                           uint32_t ingress_port);
+      void run_batch(bool one_by_one = false);
+
+      /**
+       * \brief Last step of process_batch(), converts the packets to send to ns-3 packets
+       */
+      void finish_batch(std::vector<P4PipelineOutput> &output);
+
+      /**
+       * \brief Receives the packets leaving the traffic manager: egress port, deparsed packet
+       *        and input packet it derives from
+       */
+      using TrafficManagerOutput = std::function<void(uint16_t, Ptr<Packet>, Ptr<const Packet>)>;
+
+      /**
+       * \brief Queue packets between ingress and egress, as the simple_switch traffic manager
+       *
+       * Once enabled, packets leaving the ingress are queued per egress port and priority
+       * (intrinsic_metadata.priority) and drained at the given rate. The egress pipeline runs
+       * when a packet is dequeued, with the queueing metadata filled, and the packet is then
+       * passed to the output handler instead of being returned by process() and finish_batch().
+       *
+       * \param rate the drain rate of each port
+       * \param queue_depth the capacity of each queue, in packets
+       * \param output the handler of the packets leaving the egress
+       */
+      void enable_traffic_manager(DataRate rate, uint32_t queue_depth,
+                                  TrafficManagerOutput output);
 
    private:
+      /**
+       * \brief Execute a single CLI command, appending its output to the stream
+       */
+      void run_cli_command(const std::string &line, std::ostringstream &out);
+
+      /**
+       * \brief Convert textual key fields to bmv2 match parameters
+       */
+      bool build_match_key(const P4ProgramInfo::Table &table,
+                           const std::vector<std::string> &match_key,
+                           std::vector<bm::MatchKeyParam> *params) const;
+
+      /**
+       * \brief Convert textual action parameters to bmv2 action data
+       */
+      bool build_action_data(const P4ProgramInfo::Action &action,
+                             const std::vector<std::string> &action_params,
+                             bm::ActionData *action_data) const;
+
       enum PktInstanceType
       {
          PKT_INSTANCE_TYPE_NORMAL,
@@ -88,21 +611,108 @@ namespace ns3
       };
 
       /**
-       * \brief Invoke the P4 processing ingress pipeline (parser, match-action)
+       * A packet waiting for ingress processing
+       */
+      struct IngressPacket
+      {
+         uint32_t input;                     //!< Index of the input packet it derives from
+         bm::Packet::buffer_state_t state;   //!< Buffer state before parsing
+         uint64_t size;                      //!< Packet length before ingress
+         std::unique_ptr<bm::Packet> packet; //!< bmv2 packet
+      };
+
+      /**
+       * \brief Initialize the metadata of a received packet
+       */
+      void init_metadata(std::unique_ptr<bm::Packet> &packet);
+
+      /**
+       * \brief Parse a packet
+       */
+      void process_parser(std::unique_ptr<bm::Packet> &packet);
+
+      /**
+       * \brief Add the event field of a parsed packet to the event sink, if its header is valid
+       */
+      void record_event(const std::unique_ptr<bm::Packet> &packet);
+
+      /**
+       * \brief Add the time per packet of a stage to its histogram
+       * \param stage the stage
+       * \param start when the stage started
+       * \param n_packets the number of packets processed
+       */
+      void record_stage(P4PipelineStats::Stage stage, std::chrono::steady_clock::time_point start,
+                        size_t n_packets);
+
+      /**
+       * \brief Run parser and ingress over the packets to ingress, until no packet is resubmitted
+       */
+      void run_ingress();
+
+      /**
+       * \brief Run egress and deparser over the packets to egress, including egress clones
+       */
+      void run_egress();
+
+      /**
+       * \brief Invoke the P4 processing ingress pipeline (match-action)
        */
       void process_ingress(std::unique_ptr<bm::Packet> &packet);
 
       /**
-       * \brief Invoke the P4 processing egress pipeline (match-action, deparser)
+       * \brief Handle a packet at the end of ingress: clone, resubmit, replicate, drop it or
+       *        queue it for egress processing
+       */
+      void process_traffic_manager(IngressPacket &item);
+
+      /**
+       * \brief Clone a packet at the end of egress, if requested
        */
-      void process_egress(std::unique_ptr<bm::Packet> &packet, int pkt_len, uint16_t egress_port);
+      void process_egress_clone(std::unique_ptr<bm::Packet> &packet, uint32_t input);
+
+      /**
+       * \brief Recirculate a deparsed packet, if requested
+       * \return true if the packet was recirculated
+       */
+      bool process_recirculation(std::unique_ptr<bm::Packet> &packet, uint32_t input);
+
+      /**
+       * \brief Reset the metadata of a copy, except the fields of a field list
+       */
+      void copy_field_list_and_set_type(const std::unique_ptr<bm::Packet> &packet,
+                                        const std::unique_ptr<bm::Packet> &packet_copy,
+                                        PktInstanceType copy_type, uint16_t field_list_id);
+
+      /**
+       * \brief Queue a clone for egress processing, according to a mirroring session
+       */
+      void enqueue_clone(std::unique_ptr<bm::Packet> packet, const MirroringSessionConfig &config,
+                         uint32_t input);
+
+      /**
+       * \brief Move the packets to egress to the traffic manager
+       */
+      void enqueue_to_traffic_manager();
+
+      /**
+       * \brief Invoke the P4 processing egress pipeline (match-action)
+       */
+      void process_egress(std::unique_ptr<bm::Packet> &packet, uint16_t egress_port,
+                          uint64_t timestamp);
+
+      /**
+       * \brief Run the egress of a packet leaving the traffic manager and output it
+       * \return the size of the packet sent, 0 if it was dropped
+       */
+      uint32_t process_dequeued(uint16_t egress_port, std::unique_ptr<bm::Packet> &packet,
+                                Ptr<const Packet> origin);
 
       /**
        * \brief Process the multicasting of a packet
        */
-      void
-      process_multicast(std::list<std::pair<uint16_t, std::unique_ptr<bm::Packet>>> *pkts_to_egress,
-                        bm::Packet *packet, unsigned int mgid);
+      void process_multicast(std::unique_ptr<bm::Packet> packet, unsigned int mgid,
+                             uint32_t input);
 
       /**
        * \brief Convert the NS3 packet ptr into a bmv2 pkt ptr
@@ -110,17 +720,126 @@ namespace ns3
       std::unique_ptr<bm::Packet> get_bm_packet(Ptr<const Packet> ns3_packet, uint32_t ingress_port);
 
       /**
-       * \brief Convert the NS3 packet ptr into a bmv2 pkt ptr
+       * \brief Convert the bmv2 pkt ptr into a NS3 packet ptr
        */
       Ptr<Packet> get_ns3_packet(std::unique_ptr<bm::Packet> bm_packet);
 
+      /**
+       * \brief Rebuild the list of deparsed headers that have an ns-3 Header mapping
+       */
+      void build_header_mappings();
+
+      /**
+       * A header emitted by the deparser, with the ns-3 Header used to rebuild it
+       */
+      struct DeparsedHeader
+      {
+         bm::header_id_t id;             //!< bmv2 header id
+         std::unique_ptr<Header> header; //!< Instance of the mapped Header, nullptr if unmapped
+      };
+
    private:
       const uint32_t drop_port = DEFAULT_DROP_PORT;
 
       static int thrift_port;
       static bm::packet_id_t packet_id;
-      static uint8_t ns2bm_buf[MAX_PKT_SIZE];
       std::shared_ptr<bm::McSimplePreLAG> pre;
+
+      /**
+       * Ports of the multicast nodes created in-process, to undo their updates
+       */
+      std::map<bm::McSimplePre::l1_hdl_t, bm::McSimplePre::PortMap> mc_node_ports;
+
+      /**
+       * Multicast groups created in-process, and the groups of their associated nodes, to
+       * check the multicast changes of a transaction
+       */
+      std::set<bm::McSimplePre::mgrp_hdl_t> mc_groups;
+      std::map<bm::McSimplePre::l1_hdl_t, bm::McSimplePre::mgrp_hdl_t> mc_node_groups;
+
+      /**
+       * Held while packets are processed and while a transaction is applied
+       */
+      std::mutex processing_lock;
+      std::shared_ptr<const P4ProgramInfo> program_info;
+
+      /**
+       * ns-3 Header TypeIds, by P4 header type name
+       */
+      std::map<std::string, TypeId> header_types;
+
+      /**
+       * Headers emitted by the deparser, in order, used to rebuild the output packets
+       */
+      std::vector<DeparsedHeader> deparsed_headers;
+
+      /**
+       * Headers removed from the current output packet, reused across packets
+       */
+      std::vector<Header *> removed_headers;
+
+      bool reconstruct_headers = false;
+
+      /**
+       * A packet waiting for egress processing
+       */
+      struct EgressPacket
+      {
+         uint16_t port;                      //!< Egress port
+         uint32_t input;                     //!< Index of the input packet it derives from
+         std::unique_ptr<bm::Packet> packet; //!< bmv2 packet
+      };
+
+      /**
+       * Pipeline stages, resolved once at initialization
+       */
+      bm::Parser *parser;
+      bm::Deparser *deparser;
+      bm::Pipeline *ingress_mau;
+      bm::Pipeline *egress_mau;
+
+      /**
+       * Buffers reused across calls to process() and process_batch()
+       */
+      std::vector<P4PipelineInput> single_input;
+      std::vector<IngressPacket> pkts_in_ingress;
+      std::vector<IngressPacket> pkts_resubmitted;
+      std::vector<EgressPacket> pkts_to_egress;
+      std::vector<EgressPacket> pkts_to_output;
+
+      /**
+       * Mirroring sessions, by id
+       */
+      std::map<int, MirroringSessionConfig> mirroring_sessions;
+
+      /**
+       * Simulation time at which the current batch is processed, in nanoseconds
+       */
+      uint64_t batch_timestamp = 0;
+
+      /**
+       * Input packets of the current batch, only kept for the traffic manager
+       */
+      std::vector<Ptr<const Packet>> batch_origins;
+
+      std::unique_ptr<P4TrafficManager> traffic_manager;
+      TrafficManagerOutput traffic_manager_output;
+
+      /**
+       * Sink of the per-packet events, with the header and field offset recorded
+       */
+      std::shared_ptr<P4EventSink> event_sink;
+      bm::header_id_t event_header = 0;
+      int event_field = 0;
+
+      /**
+       * Counters, with the sampling state of the stage timing
+       */
+      P4PipelineStats stats;
+      bool stats_counters = false;
+      uint32_t timing_sample = 0;
+      uint32_t timing_countdown = 0;
+      bool timing_batch = false;
    };
 
 } // namespace ns3
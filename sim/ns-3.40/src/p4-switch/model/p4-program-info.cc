@@ -0,0 +1,696 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "p4-program-info.h"
+
+#include "ns3/log.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <sys/stat.h>
+#include <tuple>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::P4ProgramInfo implementation.
+ */
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("P4ProgramInfo");
+
+namespace
+{
+
+/**
+ * Minimal JSON document model, enough to walk a bmv2 JSON file.
+ */
+struct JsonValue
+{
+    enum Type
+    {
+        JSON_NULL,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT,
+    };
+
+    Type type{JSON_NULL};
+    bool boolean{false};
+    double number{0};
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* Get(const std::string& key) const
+    {
+        if (type != JSON_OBJECT)
+        {
+            return nullptr;
+        }
+        for (const auto& item : object)
+        {
+            if (item.first == key)
+            {
+                return &item.second;
+            }
+        }
+        return nullptr;
+    }
+
+    std::string GetString(const std::string& key) const
+    {
+        const JsonValue* v = Get(key);
+        return (v && v->type == JSON_STRING) ? v->string : "";
+    }
+
+    uint32_t GetUint(const std::string& key) const
+    {
+        const JsonValue* v = Get(key);
+        return (v && v->type == JSON_NUMBER) ? static_cast<uint32_t>(v->number) : 0;
+    }
+
+    const std::vector<JsonValue>& GetArray(const std::string& key) const
+    {
+        static const std::vector<JsonValue> empty;
+        const JsonValue* v = Get(key);
+        return (v && v->type == JSON_ARRAY) ? v->array : empty;
+    }
+};
+
+/**
+ * Recursive descent JSON parser.
+ */
+class JsonParser
+{
+  public:
+    JsonParser(const std::string& text)
+        : m_text(text),
+          m_pos(0)
+    {
+    }
+
+    bool Parse(JsonValue& value, std::string& error)
+    {
+        if (!ParseValue(value) || (SkipSpaces(), m_pos != m_text.size()))
+        {
+            error = "invalid JSON at offset " + std::to_string(m_pos);
+            return false;
+        }
+        return true;
+    }
+
+  private:
+    void SkipSpaces()
+    {
+        while (m_pos < m_text.size() &&
+               (m_text[m_pos] == ' ' || m_text[m_pos] == '\n' || m_text[m_pos] == '\r' ||
+                m_text[m_pos] == '\t'))
+        {
+            m_pos++;
+        }
+    }
+
+    bool Consume(char c)
+    {
+        SkipSpaces();
+        if (m_pos < m_text.size() && m_text[m_pos] == c)
+        {
+            m_pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool ConsumeWord(const char* word)
+    {
+        size_t len = std::char_traits<char>::length(word);
+        if (m_text.compare(m_pos, len, word) == 0)
+        {
+            m_pos += len;
+            return true;
+        }
+        return false;
+    }
+
+    bool ParseString(std::string& out)
+    {
+        if (!Consume('"'))
+        {
+            return false;
+        }
+        while (m_pos < m_text.size())
+        {
+            char c = m_text[m_pos++];
+            if (c == '"')
+            {
+                return true;
+            }
+            if (c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if (m_pos >= m_text.size())
+            {
+                return false;
+            }
+            c = m_text[m_pos++];
+            switch (c)
+            {
+            case 'n':
+                out += '\n';
+                break;
+            case 't':
+                out += '\t';
+                break;
+            case 'r':
+                out += '\r';
+                break;
+            case 'b':
+                out += '\b';
+                break;
+            case 'f':
+                out += '\f';
+                break;
+            case 'u':
+                // Names in bmv2 JSON files are plain ASCII, keep only the low byte
+                if (m_pos + 4 > m_text.size())
+                {
+                    return false;
+                }
+                out += static_cast<char>(std::strtol(m_text.substr(m_pos, 4).c_str(), nullptr, 16));
+                m_pos += 4;
+                break;
+            default:
+                out += c;
+            }
+        }
+        return false;
+    }
+
+    bool ParseValue(JsonValue& value)
+    {
+        SkipSpaces();
+        if (m_pos >= m_text.size())
+        {
+            return false;
+        }
+
+        char c = m_text[m_pos];
+        if (c == '{')
+        {
+            m_pos++;
+            value.type = JsonValue::JSON_OBJECT;
+            if (Consume('}'))
+            {
+                return true;
+            }
+            do
+            {
+                std::pair<std::string, JsonValue> item;
+                if (!ParseString(item.first) || !Consume(':') || !ParseValue(item.second))
+                {
+                    return false;
+                }
+                value.object.push_back(std::move(item));
+            } while (Consume(','));
+            return Consume('}');
+        }
+        if (c == '[')
+        {
+            m_pos++;
+            value.type = JsonValue::JSON_ARRAY;
+            if (Consume(']'))
+            {
+                return true;
+            }
+            do
+            {
+                value.array.emplace_back();
+                if (!ParseValue(value.array.back()))
+                {
+                    return false;
+                }
+            } while (Consume(','));
+            return Consume(']');
+        }
+        if (c == '"')
+        {
+            value.type = JsonValue::JSON_STRING;
+            return ParseString(value.string);
+        }
+        if (ConsumeWord("true"))
+        {
+            value.type = JsonValue::JSON_BOOL;
+            value.boolean = true;
+            return true;
+        }
+        if (ConsumeWord("false"))
+        {
+            value.type = JsonValue::JSON_BOOL;
+            return true;
+        }
+        if (ConsumeWord("null"))
+        {
+            return true;
+        }
+
+        const char* start = m_text.c_str() + m_pos;
+        char* end = nullptr;
+        value.type = JsonValue::JSON_NUMBER;
+        value.number = std::strtod(start, &end);
+        if (end == start)
+        {
+            return false;
+        }
+        m_pos += end - start;
+        return true;
+    }
+
+    const std::string& m_text; //!< Document being parsed
+    size_t m_pos;              //!< Current offset
+};
+
+bool
+ParseMatchType(const std::string& str, P4ProgramInfo::MatchType& type)
+{
+    static const std::map<std::string, P4ProgramInfo::MatchType> types = {
+        {"exact", P4ProgramInfo::MATCH_EXACT},
+        {"lpm", P4ProgramInfo::MATCH_LPM},
+        {"ternary", P4ProgramInfo::MATCH_TERNARY},
+        {"range", P4ProgramInfo::MATCH_RANGE},
+        {"valid", P4ProgramInfo::MATCH_VALID},
+        {"optional", P4ProgramInfo::MATCH_OPTIONAL},
+    };
+
+    auto it = types.find(str);
+    if (it == types.end())
+    {
+        return false;
+    }
+    type = it->second;
+    return true;
+}
+
+} // namespace
+
+P4ProgramInfo::P4ProgramInfo()
+{
+    NS_LOG_FUNCTION_NOARGS();
+}
+
+std::shared_ptr<const P4ProgramInfo>
+P4ProgramInfo::Load(const std::string& path, std::string& error)
+{
+    NS_LOG_FUNCTION(path);
+
+    // Size and modification time detect a file rewritten with a different program, without
+    // reading it
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+    {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    using CacheKey = std::tuple<std::string, off_t, time_t, long>;
+    CacheKey key(path, st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+
+    static std::mutex mutex;
+    static std::map<CacheKey, std::shared_ptr<const P4ProgramInfo>> cache;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = cache.find(key);
+    if (it != cache.end())
+    {
+        return it->second;
+    }
+
+    std::ifstream stream(path);
+    if (!stream)
+    {
+        error = "cannot open " + path;
+        return nullptr;
+    }
+    std::stringstream content;
+    content << stream.rdbuf();
+
+    auto info = std::make_shared<P4ProgramInfo>();
+    info->m_json = content.str();
+    if (!info->Parse(info->m_json, error))
+    {
+        return nullptr;
+    }
+    cache.emplace(key, info);
+    return info;
+}
+
+bool
+P4ProgramInfo::Parse(const std::string& json, std::string& error)
+{
+    NS_LOG_FUNCTION_NOARGS();
+
+    JsonValue root;
+    if (!JsonParser(json).Parse(root, error))
+    {
+        return false;
+    }
+    if (root.type != JsonValue::JSON_OBJECT)
+    {
+        error = "the bmv2 JSON root is not an object";
+        return false;
+    }
+
+    // Header types: name -> (field name -> bitwidth), and field names in bmv2 offset order
+    std::map<std::string, std::map<std::string, uint32_t>> header_types;
+    std::map<std::string, std::vector<std::string>> header_fields;
+    for (const auto& ht : root.GetArray("header_types"))
+    {
+        auto& fields = header_types[ht.GetString("name")];
+        auto& names = header_fields[ht.GetString("name")];
+        for (const auto& f : ht.GetArray("fields"))
+        {
+            if (f.type == JsonValue::JSON_ARRAY && f.array.size() >= 2)
+            {
+                fields[f.array[0].string] = static_cast<uint32_t>(f.array[1].number);
+                names.push_back(f.array[0].string);
+            }
+        }
+    }
+
+    // Header instances: name -> header type
+    std::map<std::string, std::string> headers;
+    std::map<std::string, std::vector<uint32_t>> header_ids;
+    for (const auto& h : root.GetArray("headers"))
+    {
+        HeaderInstance header;
+        header.name = h.GetString("name");
+        header.type = h.GetString("header_type");
+        header.id = h.GetUint("id");
+        const JsonValue* metadata = h.Get("metadata");
+        header.metadata = metadata && metadata->boolean;
+        header.fields = header_fields[header.type];
+
+        headers[header.name] = header.type;
+        header_ids[header.name] = {header.id};
+        if (m_headers.size() <= header.id)
+        {
+            m_headers.resize(header.id + 1);
+        }
+        m_headers[header.id] = std::move(header);
+    }
+
+    // Stacks and unions are emitted as a whole by the deparser, expand them to headers
+    std::map<uint32_t, std::vector<uint32_t>> union_ids;
+    for (const auto& u : root.GetArray("header_unions"))
+    {
+        std::vector<uint32_t>& ids = header_ids[u.GetString("name")];
+        for (const auto& id : u.GetArray("header_ids"))
+        {
+            ids.push_back(static_cast<uint32_t>(id.number));
+        }
+        union_ids[u.GetUint("id")] = ids;
+    }
+    for (const auto& st : root.GetArray("header_stacks"))
+    {
+        std::vector<uint32_t>& ids = header_ids[st.GetString("name")];
+        for (const auto& id : st.GetArray("header_ids"))
+        {
+            ids.push_back(static_cast<uint32_t>(id.number));
+        }
+    }
+    for (const auto& st : root.GetArray("header_union_stacks"))
+    {
+        std::vector<uint32_t>& ids = header_ids[st.GetString("name")];
+        for (const auto& id : st.GetArray("header_union_ids"))
+        {
+            const auto& members = union_ids[static_cast<uint32_t>(id.number)];
+            ids.insert(ids.end(), members.begin(), members.end());
+        }
+    }
+
+    const std::vector<JsonValue>& deparsers = root.GetArray("deparsers");
+    if (!deparsers.empty())
+    {
+        for (const auto& name : deparsers[0].GetArray("order"))
+        {
+            auto it = header_ids.find(name.string);
+            if (it != header_ids.end())
+            {
+                m_deparserOrder.insert(m_deparserOrder.end(), it->second.begin(), it->second.end());
+            }
+        }
+    }
+
+    for (const auto& a : root.GetArray("actions"))
+    {
+        Action action;
+        action.name = a.GetString("name");
+        action.id = a.GetUint("id");
+        for (const auto& p : a.GetArray("runtime_data"))
+        {
+            action.params.push_back({p.GetString("name"), p.GetUint("bitwidth")});
+        }
+        IndexName(m_actionIndex, action.name, m_actions.size());
+        m_actions.push_back(std::move(action));
+    }
+
+    for (const auto& pipeline : root.GetArray("pipelines"))
+    {
+        for (const auto& t : pipeline.GetArray("tables"))
+        {
+            Table table;
+            table.name = t.GetString("name");
+            table.id = t.GetUint("id");
+            if (!ParseMatchType(t.GetString("match_type"), table.matchType))
+            {
+                error = "unknown match type for table " + table.name;
+                return false;
+            }
+
+            for (const auto& k : t.GetArray("key"))
+            {
+                KeyField field;
+                if (!ParseMatchType(k.GetString("match_type"), field.matchType))
+                {
+                    error = "unknown match type for a key of table " + table.name;
+                    return false;
+                }
+
+                const JsonValue* target = k.Get("target");
+                field.bitwidth = 0;
+                if (target && target->type == JsonValue::JSON_ARRAY && target->array.size() == 2)
+                {
+                    const std::string& header = target->array[0].string;
+                    const std::string& name = target->array[1].string;
+                    field.name = header + "." + name;
+                    if (name == "$valid$")
+                    {
+                        field.bitwidth = 1;
+                    }
+                    else
+                    {
+                        auto ht = header_types.find(headers[header]);
+                        if (ht != header_types.end() && ht->second.count(name))
+                        {
+                            field.bitwidth = ht->second.at(name);
+                        }
+                    }
+                }
+                else if (target && target->type == JsonValue::JSON_STRING)
+                {
+                    // "valid" match on a header instance
+                    field.name = target->string;
+                    field.bitwidth = 1;
+                }
+
+                if (field.bitwidth == 0)
+                {
+                    error = "cannot resolve the width of a key of table " + table.name;
+                    return false;
+                }
+                table.key.push_back(std::move(field));
+            }
+
+            for (const auto& a : t.GetArray("actions"))
+            {
+                table.actions.push_back(a.string);
+            }
+
+            // const default_action in P4, setting the default action of the table fails
+            const JsonValue* defaultEntry = t.Get("default_entry");
+            const JsonValue* entryConst =
+                defaultEntry ? defaultEntry->Get("action_entry_const") : nullptr;
+            table.constDefaultEntry =
+                entryConst && entryConst->type == JsonValue::JSON_BOOL && entryConst->boolean;
+
+            IndexName(m_tableIndex, table.name, m_tables.size());
+            m_tables.push_back(std::move(table));
+        }
+    }
+
+    for (const auto& r : root.GetArray("register_arrays"))
+    {
+        Register reg;
+        reg.name = r.GetString("name");
+        reg.bitwidth = r.GetUint("bitwidth");
+        reg.size = r.GetUint("size");
+        IndexName(m_registerIndex, reg.name, m_registers.size());
+        m_registers.push_back(std::move(reg));
+    }
+
+    NS_LOG_DEBUG("Parsed P4 program with " << m_tables.size() << " tables, " << m_actions.size()
+                                           << " actions and " << m_registers.size()
+                                           << " registers");
+
+    return true;
+}
+
+const P4ProgramInfo::Table*
+P4ProgramInfo::GetTable(const std::string& name) const
+{
+    int pos = LookupName(m_tableIndex, name);
+    return (pos < 0) ? nullptr : &m_tables[pos];
+}
+
+const P4ProgramInfo::Action*
+P4ProgramInfo::GetAction(const std::string& name, const Table* table) const
+{
+    if (table)
+    {
+        // Resolve the name among the actions of the table first
+        NameIndex table_actions;
+        for (const auto& a : table->actions)
+        {
+            int pos = LookupName(m_actionIndex, a);
+            if (pos >= 0)
+            {
+                IndexName(table_actions, a, pos);
+            }
+        }
+
+        int pos = LookupName(table_actions, name);
+        if (pos >= 0)
+        {
+            return &m_actions[pos];
+        }
+    }
+
+    int pos = LookupName(m_actionIndex, name);
+    return (pos < 0) ? nullptr : &m_actions[pos];
+}
+
+const P4ProgramInfo::Register*
+P4ProgramInfo::GetRegister(const std::string& name) const
+{
+    int pos = LookupName(m_registerIndex, name);
+    return (pos < 0) ? nullptr : &m_registers[pos];
+}
+
+const std::string&
+P4ProgramInfo::GetJson() const
+{
+    return m_json;
+}
+
+const std::vector<P4ProgramInfo::Table>&
+P4ProgramInfo::GetTables() const
+{
+    return m_tables;
+}
+
+const std::vector<P4ProgramInfo::Action>&
+P4ProgramInfo::GetActions() const
+{
+    return m_actions;
+}
+
+const std::vector<P4ProgramInfo::HeaderInstance>&
+P4ProgramInfo::GetHeaders() const
+{
+    return m_headers;
+}
+
+const std::vector<uint32_t>&
+P4ProgramInfo::GetDeparserHeaderIds() const
+{
+    return m_deparserOrder;
+}
+
+std::string
+P4ProgramInfo::MatchTypeToString(MatchType type)
+{
+    switch (type)
+    {
+    case MATCH_EXACT:
+        return "exact";
+    case MATCH_LPM:
+        return "lpm";
+    case MATCH_TERNARY:
+        return "ternary";
+    case MATCH_RANGE:
+        return "range";
+    case MATCH_VALID:
+        return "valid";
+    case MATCH_OPTIONAL:
+        return "optional";
+    }
+    return "";
+}
+
+void
+P4ProgramInfo::IndexName(NameIndex& index, const std::string& name, int pos)
+{
+    index.names[name] = pos;
+
+    size_t dot = name.find('.');
+    while (dot != std::string::npos)
+    {
+        std::string suffix = name.substr(dot + 1);
+        auto it = index.suffixes.find(suffix);
+        if (it == index.suffixes.end())
+        {
+            index.suffixes[suffix] = pos;
+        }
+        else if (it->second != pos)
+        {
+            it->second = -1;
+        }
+        dot = name.find('.', dot + 1);
+    }
+}
+
+int
+P4ProgramInfo::LookupName(const NameIndex& index, const std::string& name)
+{
+    // A full name always wins over the suffix of another object
+    auto it = index.names.find(name);
+    if (it != index.names.end())
+    {
+        return it->second;
+    }
+    it = index.suffixes.find(name);
+    return (it == index.suffixes.end()) ? -1 : it->second;
+}
+
+} // namespace ns3
@@ -0,0 +1,252 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+
+#ifndef P4_PROGRAM_INFO_H
+#define P4_PROGRAM_INFO_H
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::P4ProgramInfo declaration.
+ */
+
+namespace ns3
+{
+
+/**
+ * \ingroup p4-switch
+ * \brief Description of a compiled P4 program, read from the bmv2 JSON.
+ *
+ * This holds the subset of the bmv2 JSON that the control plane needs to turn
+ * textual commands into runtime calls: table keys with their match kinds and
+ * widths, action parameters, and register arrays. Names can be resolved either
+ * by their fully qualified name or by any unique dot-separated suffix, in the
+ * same way simple_switch_CLI does (e.g. "ipv6_forward" for "MyIngress.ipv6_forward").
+ */
+class P4ProgramInfo
+{
+  public:
+    /**
+     * Match kinds supported by bmv2.
+     */
+    enum MatchType
+    {
+        MATCH_EXACT,
+        MATCH_LPM,
+        MATCH_TERNARY,
+        MATCH_RANGE,
+        MATCH_VALID,
+        MATCH_OPTIONAL,
+    };
+
+    /**
+     * A field of a table key.
+     */
+    struct KeyField
+    {
+        std::string name;    //!< Field name, as "header.field"
+        MatchType matchType; //!< Match kind
+        uint32_t bitwidth;   //!< Field width in bits
+    };
+
+    /**
+     * A match-action table.
+     */
+    struct Table
+    {
+        std::string name;                 //!< Fully qualified name
+        uint32_t id;                      //!< bmv2 table id
+        MatchType matchType;              //!< Overall table match kind
+        std::vector<KeyField> key;        //!< Key fields
+        std::vector<std::string> actions; //!< Fully qualified names of the allowed actions
+        bool constDefaultEntry;           //!< Whether the default entry cannot be changed
+    };
+
+    /**
+     * A runtime parameter of an action.
+     */
+    struct ActionParam
+    {
+        std::string name;  //!< Parameter name
+        uint32_t bitwidth; //!< Parameter width in bits
+    };
+
+    /**
+     * An action.
+     */
+    struct Action
+    {
+        std::string name;                //!< Fully qualified name
+        uint32_t id;                     //!< bmv2 action id
+        std::vector<ActionParam> params; //!< Runtime parameters
+    };
+
+    /**
+     * A register array.
+     */
+    struct Register
+    {
+        std::string name;  //!< Fully qualified name
+        uint32_t bitwidth; //!< Width of each cell in bits
+        uint32_t size;     //!< Number of cells
+    };
+
+    /**
+     * A header instance.
+     */
+    struct HeaderInstance
+    {
+        std::string name;                //!< Instance name
+        std::string type;                //!< Header type name
+        uint32_t id;                     //!< bmv2 header id
+        bool metadata;                   //!< Whether this is a metadata header
+        std::vector<std::string> fields; //!< Field names, in bmv2 field offset order
+    };
+
+    P4ProgramInfo();
+
+    /**
+     * \brief Get the description of a bmv2 JSON file, read and parsed once per process
+     *
+     * Descriptions are cached by path, size and modification time, so the switches running
+     * the same program share a single instance, with the content of the file, and a file
+     * rewritten with a different program is read again. This is safe to call from several
+     * threads.
+     *
+     * \param path the bmv2 JSON file
+     * \param error filled with a description of the problem on failure
+     * \return the description, or nullptr on failure
+     */
+    static std::shared_ptr<const P4ProgramInfo> Load(const std::string& path, std::string& error);
+
+    /**
+     * \brief Parse the content of a bmv2 JSON file
+     * \param json the JSON document
+     * \param error filled with a description of the problem on failure
+     * \return true on success
+     */
+    bool Parse(const std::string& json, std::string& error);
+
+    /**
+     * \brief Look up a table by full name or unique suffix
+     * \param name the table name
+     * \return the table, or nullptr if not found (or ambiguous)
+     */
+    const Table* GetTable(const std::string& name) const;
+
+    /**
+     * \brief Look up an action by full name or unique suffix
+     *
+     * If a table is given, the actions of that table are searched first, so that
+     * short names are resolved in the context of the table.
+     *
+     * \param name the action name
+     * \param table the table the action is used in, may be nullptr
+     * \return the action, or nullptr if not found (or ambiguous)
+     */
+    const Action* GetAction(const std::string& name, const Table* table = nullptr) const;
+
+    /**
+     * \brief Look up a register array by full name or unique suffix
+     * \param name the register name
+     * \return the register, or nullptr if not found (or ambiguous)
+     */
+    const Register* GetRegister(const std::string& name) const;
+
+    /**
+     * \return all the tables, in the order of the JSON file
+     */
+    const std::vector<Table>& GetTables() const;
+
+    /**
+     * \return all the actions, in the order of the JSON file
+     */
+    const std::vector<Action>& GetActions() const;
+
+    /**
+     * \return all the header instances, indexed by bmv2 header id
+     */
+    const std::vector<HeaderInstance>& GetHeaders() const;
+
+    /**
+     * \brief Get the headers emitted by the deparser
+     *
+     * Header stacks, unions and union stacks are expanded into their member headers.
+     *
+     * \return the bmv2 ids of the headers, in emission order
+     */
+    const std::vector<uint32_t>& GetDeparserHeaderIds() const;
+
+    /**
+     * \return the content of the bmv2 JSON file, when loaded with Load()
+     */
+    const std::string& GetJson() const;
+
+    /**
+     * \return the string representation of a match kind, as used in the bmv2 JSON
+     * \param type the match kind
+     */
+    static std::string MatchTypeToString(MatchType type);
+
+  private:
+    /**
+     * Name index, mapping full names and unique suffixes to object positions.
+     * Ambiguous suffixes map to -1.
+     */
+    struct NameIndex
+    {
+        std::map<std::string, int> names;    //!< Fully qualified names
+        std::map<std::string, int> suffixes; //!< Dot-separated suffixes
+    };
+
+    /**
+     * \brief Add a name and all its suffixes to an index
+     * \param index the index
+     * \param name the fully qualified name
+     * \param pos the position of the object
+     */
+    static void IndexName(NameIndex& index, const std::string& name, int pos);
+
+    /**
+     * \brief Resolve a name in an index
+     * \param index the index
+     * \param name the name
+     * \return the position of the object, or -1
+     */
+    static int LookupName(const NameIndex& index, const std::string& name);
+
+    std::vector<Table> m_tables;           //!< Tables
+    std::vector<Action> m_actions;         //!< Actions
+    std::vector<Register> m_registers;     //!< Register arrays
+    std::vector<HeaderInstance> m_headers; //!< Header instances, by id
+    std::vector<uint32_t> m_deparserOrder; //!< Ids of the headers emitted by the deparser
+    NameIndex m_tableIndex;                //!< Table names index
+    NameIndex m_actionIndex;               //!< Action names index
+    NameIndex m_registerIndex;             //!< Register names index
+    std::string m_json;                    //!< Content of the file, when loaded with Load()
+};
+
+} // namespace ns3
+
+#endif /* P4_PROGRAM_INFO_H */
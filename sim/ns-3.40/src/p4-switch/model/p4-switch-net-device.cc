@@ -19,18 +19,20 @@
 
 #include "ns3/boolean.h"
 #include "ns3/channel.h"
-#include "ns3/csma-net-device.h"
+#include "ns3/enum.h"
 #include "ns3/ethernet-header.h"
 #include "ns3/log.h"
 #include "ns3/names.h"
 #include "ns3/node.h"
+#include "ns3/p4-pipeline-executor.h"
 #include "ns3/packet.h"
 #include "ns3/simulator.h"
 #include "ns3/string.h"
+#include "ns3/trace-source-accessor.h"
 #include "ns3/uinteger.h"
 
-#include <chrono>
-#include <thread>
+#include <fstream>
+#include <iostream>
 
 /**
  * \file
@@ -69,7 +71,143 @@ P4SwitchNetDevice::GetTypeId()
                           StringValue(""),
                           MakeStringAccessor(&P4SwitchNetDevice::GetPipelineCommands,
                                              &P4SwitchNetDevice::SetPipelineCommands),
-                          MakeStringChecker());
+                          MakeStringChecker())
+            .AddAttribute("PipelineTableSnapshot",
+                          "Table snapshot, saved with DumpTableSnapshot(), to load into the P4 "
+                          "pipeline before running PipelineCommands. Empty disables loading",
+                          StringValue(""),
+                          MakeStringAccessor(&P4SwitchNetDevice::m_pipeline_table_snapshot),
+                          MakeStringChecker())
+            .AddAttribute("ControlPlane",
+                          "How the P4 pipeline can be controlled: Inproc only allows the "
+                          "in-process API, Thrift also starts a Thrift server and nanomsg sockets",
+                          EnumValue(CONTROL_PLANE_THRIFT),
+                          MakeEnumAccessor(&P4SwitchNetDevice::m_control_plane),
+                          MakeEnumChecker(CONTROL_PLANE_INPROC,
+                                          "Inproc",
+                                          CONTROL_PLANE_THRIFT,
+                                          "Thrift"))
+            .AddAttribute("ReconstructHeaders",
+                          "Add the headers emitted by the P4 deparser to the output packets as "
+                          "ns-3 Headers (Ethernet, IPv6, SRH, Live-Live TLV, TCP, UDP), instead "
+                          "of leaving them in the payload",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&P4SwitchNetDevice::m_reconstruct_headers),
+                          MakeBooleanChecker())
+            .AddAttribute("LogLevel",
+                          "Verbosity of the bmv2 logger. Off also disables the console logger, "
+                          "and with it the output of log_msg(). The bmv2 logger is shared by "
+                          "all the switches, the last one initialized sets it",
+                          EnumValue(LOG_LEVEL_INFO),
+                          MakeEnumAccessor(&P4SwitchNetDevice::m_log_level),
+                          MakeEnumChecker(LOG_LEVEL_TRACE,
+                                          "Trace",
+                                          LOG_LEVEL_DEBUG,
+                                          "Debug",
+                                          LOG_LEVEL_INFO,
+                                          "Info",
+                                          LOG_LEVEL_WARN,
+                                          "Warn",
+                                          LOG_LEVEL_ERROR,
+                                          "Error",
+                                          LOG_LEVEL_CRITICAL,
+                                          "Critical",
+                                          LOG_LEVEL_OFF,
+                                          "Off"))
+            .AddAttribute("EventLogFile",
+                          "Binary file where to record EventLogField, the ingress timestamp "
+                          "and the ingress port of every parsed packet where the field is "
+                          "valid (see P4EventSink). Empty disables the recording",
+                          StringValue(""),
+                          MakeStringAccessor(&P4SwitchNetDevice::m_event_log_file),
+                          MakeStringChecker())
+            .AddAttribute("EventLogField",
+                          "The header field recorded in EventLogFile, as header.field",
+                          StringValue("srv6_ll_tlv.seq_n"),
+                          MakeStringAccessor(&P4SwitchNetDevice::m_event_log_field),
+                          MakeStringChecker())
+            .AddAttribute("BatchProcessing",
+                          "Run the P4 pipeline over all the packets received at the same time, "
+                          "or within BatchWindow, instead of one packet at a time",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&P4SwitchNetDevice::m_batch_processing),
+                          MakeBooleanChecker())
+            .AddAttribute("BatchWindow",
+                          "How long to wait for more packets before processing a batch. "
+                          "Packets are delayed by up to this amount",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_batch_window),
+                          MakeTimeChecker())
+            .AddAttribute("TrafficManager",
+                          "Queue packets per egress port and priority between the P4 ingress "
+                          "and egress, filling the queueing metadata",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&P4SwitchNetDevice::m_traffic_manager),
+                          MakeBooleanChecker())
+            .AddAttribute("EgressRate",
+                          "The rate at which the traffic manager drains each egress port",
+                          DataRateValue(DataRate("1Gbps")),
+                          MakeDataRateAccessor(&P4SwitchNetDevice::m_egress_rate),
+                          MakeDataRateChecker())
+            .AddAttribute("QueueDepth",
+                          "The capacity of each traffic manager queue, in packets",
+                          UintegerValue(64),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_queue_depth),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("ProcessingDelay",
+                          "Fixed latency of the P4 pipeline, from the reception of a packet to "
+                          "the transmission of its outputs",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_processing_delay),
+                          MakeTimeChecker())
+            .AddAttribute("TableDelay",
+                          "Latency added for each match-action table of the P4 program, as in "
+                          "a pipeline with one stage per table",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_table_delay),
+                          MakeTimeChecker())
+            .AddAttribute("ReplicationDelay",
+                          "Latency added to each output of a packet after the first one "
+                          "(multicast copies and clones), which leave the pipeline one at a time",
+                          TimeValue(Seconds(0)),
+                          MakeTimeAccessor(&P4SwitchNetDevice::m_replication_delay),
+                          MakeTimeChecker())
+            .AddAttribute("PipelineThroughput",
+                          "Packets per second that can enter the P4 pipeline, 0 for unlimited. "
+                          "Packets received faster wait for the pipeline, without limit",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_pipeline_throughput),
+                          MakeUintegerChecker<uint64_t>())
+            .AddAttribute("LookupCacheSize",
+                          "Number of lookup results remembered by each exact and LPM table, by "
+                          "key, until an entry is added or deleted. 0 disables the cache",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_lookup_cache_size),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("TableCounters",
+                          "Count the hits and misses of each table and the executions of each "
+                          "action of the P4 program, without bmv2 logging",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&P4SwitchNetDevice::m_table_counters),
+                          MakeBooleanChecker())
+            .AddAttribute("StageTimingSample",
+                          "Measure the wall-clock time per packet of each pipeline stage for "
+                          "one batch every StageTimingSample, 0 disables the measurement",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&P4SwitchNetDevice::m_stage_timing_sample),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("StatsFile",
+                          "File where the counters, stage timings and lookup cache hits are "
+                          "appended when the device is disposed, empty for the standard output",
+                          StringValue(""),
+                          MakeStringAccessor(&P4SwitchNetDevice::m_stats_file),
+                          MakeStringChecker())
+            .AddTraceSource("PipelineStats",
+                            "Counters of the P4 pipeline, after each packet or batch processed. "
+                            "Only fired when TableCounters, StageTimingSample or "
+                            "LookupCacheSize are enabled",
+                            MakeTraceSourceAccessor(&P4SwitchNetDevice::m_stats_trace),
+                            "ns3::P4SwitchNetDevice::StatsTracedCallback");
 
     return tid;
 }
@@ -77,7 +215,8 @@ P4SwitchNetDevice::GetTypeId()
 P4SwitchNetDevice::P4SwitchNetDevice()
     : m_node(nullptr),
       m_ifIndex(0),
-      m_p4_pipeline(nullptr)
+      m_p4_pipeline(nullptr),
+      m_job_pending(false)
 {
     NS_LOG_FUNCTION_NOARGS();
     m_channel = CreateObject<P4SwitchChannel>();
@@ -98,13 +237,27 @@ P4SwitchNetDevice::DoDispose()
         *iter = nullptr;
     }
     m_ports.clear();
+    m_batch_event.Cancel();
+    m_inputs.clear();
+    m_batch_inputs.clear();
+    m_tags.clear();
+    if (m_event_sink)
+    {
+        m_event_sink->Close();
+    }
+    if (m_p4_pipeline &&
+        (m_table_counters || m_stage_timing_sample > 0 || m_lookup_cache_size > 0))
+    {
+        DumpStats();
+    }
     m_channel = nullptr;
     m_node = nullptr;
     NetDevice::DoDispose();
 }
 
 void
-P4SwitchNetDevice::ReceiveFromDevice(Ptr<NetDevice> incomingPort,
+P4SwitchNetDevice::ReceiveFromDevice(uint32_t port_n,
+                                     Ptr<NetDevice> incomingPort,
                                      Ptr<const Packet> packet,
                                      uint16_t protocol,
                                      const Address& src,
@@ -118,13 +271,11 @@ P4SwitchNetDevice::ReceiveFromDevice(Ptr<NetDevice> incomingPort,
         InitPipeline();
     }
 
-    std::string node_name = Names::FindName(m_node);
-
-    uint32_t port_n = GetPortN(incomingPort);
-    NS_LOG_LOGIC(node_name << " ReceiveFromDevice port " << port_n
-                           << " sending through P4 pipeline");
+    NS_LOG_LOGIC(m_node_name << " ReceiveFromDevice port " << port_n
+                             << " sending through P4 pipeline");
 
-    // Re-append Ethernet header, removed by CsmaNetDevice
+    // Re-append the Ethernet header, removed by the port. Point-to-point ports report the
+    // address of the remote device as source and their own as destination.
     Ptr<Packet> full_packet = packet->Copy();
 
     EthernetHeader eth_hdr_in;
@@ -135,61 +286,208 @@ P4SwitchNetDevice::ReceiveFromDevice(Ptr<NetDevice> incomingPort,
     eth_hdr_in.SetLengthType(protocol);
     full_packet->AddHeader(eth_hdr_in);
 
-    std::list<std::pair<uint16_t, Ptr<Packet>>>* pkts = m_p4_pipeline->process(full_packet, port_n);
-    for (auto item : *pkts)
+    m_inputs.push_back({full_packet, port_n});
+    if (!m_batch_processing)
     {
-        Ptr<NetDevice> port = GetPort(item.first);
-        if (!port)
+        ProcessInputs();
+    }
+    else if (!m_batch_event.IsRunning())
+    {
+        // Packets received until the window expires are processed together
+        m_batch_event =
+            Simulator::Schedule(m_batch_window, &P4SwitchNetDevice::ProcessInputs, this);
+    }
+}
+
+void
+P4SwitchNetDevice::ProcessInputs()
+{
+    NS_LOG_FUNCTION_NOARGS();
+
+    P4PipelineExecutor* executor = P4PipelineExecutor::Get();
+    if (executor != nullptr)
+    {
+        // Run the pipeline together with the ones of the other switches. The packets received
+        // until then share the job, but without BatchProcessing they go through the program one
+        // at a time, as when processed inline: they arrived at the same time, so the shared
+        // timestamp is the one each of them would get alone.
+        if (!m_job_pending)
         {
-            NS_LOG_DEBUG(node_name << " Port " << item.first << " not found, dropping packet");
-            continue;
+            m_job_pending = true;
+            executor->Submit({[this]() { PrepareInputs(); },
+                              [this]() { m_p4_pipeline->run_batch(!m_batch_processing); },
+                              [this]() { SendOutputs(); }});
         }
+        return;
+    }
 
-        // WARNING: out_pkt is a reconstructed Packet in p4-pipeline.
-        // We try to infer known headers, but if something is missing you have to add the parsing
-        // logic there
-        Ptr<Packet> out_pkt = item.second;
-        // Remove the Ethernet header for the SendFrom
-        EthernetHeader eth_hdr_out;
-        out_pkt->RemoveHeader(eth_hdr_out);
+    PrepareInputs();
+    m_p4_pipeline->run_batch(!m_batch_processing);
+    SendOutputs();
+}
 
-        ByteTagIterator it = packet->GetByteTagIterator();
-        while (it.HasNext())
-        {
-            ByteTagIterator::Item tag_item = it.Next();
-            Callback<ObjectBase*> constructor = tag_item.GetTypeId().GetConstructor();
+void
+P4SwitchNetDevice::PrepareInputs()
+{
+    NS_LOG_FUNCTION_NOARGS();
+
+    // Packets received from now on go to the next batch
+    m_job_pending = false;
+    m_batch_inputs.swap(m_inputs);
+    m_inputs.clear();
+
+    NS_LOG_LOGIC(m_node_name << " Processing " << m_batch_inputs.size() << " packets");
+    m_p4_pipeline->prepare_batch(m_batch_inputs);
+}
 
-            Tag* tag = dynamic_cast<Tag*>(constructor());
-            NS_ASSERT(tag != nullptr);
-            tag_item.GetTag(*tag);
+void
+P4SwitchNetDevice::SendOutputs()
+{
+    NS_LOG_FUNCTION_NOARGS();
 
-            out_pkt->AddByteTag(*tag);
+    m_outputs.clear();
+    m_p4_pipeline->finish_batch(m_outputs);
+    if (m_latency.IsZero() && m_replication_delay.IsZero() && m_pipeline_throughput == 0)
+    {
+        for (auto& item : m_outputs)
+        {
+            SendOutput(item.port, item.packet, m_batch_inputs[item.input].packet);
         }
+    }
+    else
+    {
+        ScheduleOutputs();
+    }
+    m_outputs.clear();
+    m_batch_inputs.clear();
 
-        PacketTagIterator pit = packet->GetPacketTagIterator();
-        while (pit.HasNext())
+    if (m_table_counters || m_stage_timing_sample > 0 || m_lookup_cache_size > 0)
+    {
+        m_stats_trace(m_p4_pipeline->get_stats());
+    }
+}
+
+void
+P4SwitchNetDevice::DumpStats()
+{
+    std::ofstream file;
+    if (!m_stats_file.empty())
+    {
+        file.open(m_stats_file, std::ios::app);
+        if (!file)
         {
-            PacketTagIterator::Item tag_item = pit.Next();
-            Callback<ObjectBase*> constructor = tag_item.GetTypeId().GetConstructor();
+            NS_LOG_ERROR(m_node_name << " Cannot write P4 pipeline statistics to " << m_stats_file);
+            return;
+        }
+    }
 
-            Tag* tag = dynamic_cast<Tag*>(constructor());
-            NS_ASSERT(tag != nullptr);
-            tag_item.GetTag(*tag);
+    std::ostream& os = m_stats_file.empty() ? std::cout : file;
+    os << m_node_name << " P4 pipeline statistics\n";
+    m_p4_pipeline->dump_stats(os);
+    os.flush();
+}
 
-            out_pkt->AddPacketTag(*tag);
+void
+P4SwitchNetDevice::ScheduleOutputs()
+{
+    NS_LOG_FUNCTION_NOARGS();
+
+    // Input packets enter the pipeline one after the other, at most at the pipeline throughput
+    Time now = Simulator::Now();
+    m_input_delays.assign(m_batch_inputs.size(), m_latency);
+    if (m_pipeline_throughput > 0)
+    {
+        Time packet_time = Seconds(1.0 / m_pipeline_throughput);
+        for (auto& delay : m_input_delays)
+        {
+            Time start = Max(now, m_pipeline_free);
+            m_pipeline_free = start + packet_time;
+            delay += start - now;
         }
+    }
 
-        NS_LOG_DEBUG(node_name << " Forwarding pkt " << out_pkt << " to port " << item.first << " "
-                               << eth_hdr_out.GetDestination() << " " << eth_hdr_out.GetSource()
-                               << " " << eth_hdr_out.GetLengthType());
+    // Replicas of the same packet leave the pipeline one after the other
+    m_replicas.assign(m_batch_inputs.size(), 0);
+    for (auto& item : m_outputs)
+    {
+        Time delay = m_input_delays[item.input] + m_replication_delay * m_replicas[item.input]++;
+        Simulator::Schedule(delay,
+                            &P4SwitchNetDevice::SendOutput,
+                            this,
+                            item.port,
+                            item.packet,
+                            m_batch_inputs[item.input].packet);
+    }
+}
 
+void
+P4SwitchNetDevice::SendOutput(uint16_t port_n, Ptr<Packet> out_pkt, Ptr<const Packet> packet)
+{
+    NS_LOG_FUNCTION_NOARGS();
+
+    Ptr<NetDevice> port = GetPort(port_n);
+    if (!port)
+    {
+        NS_LOG_DEBUG(m_node_name << " Port " << port_n << " not found, dropping packet");
+        return;
+    }
+
+    // out_pkt carries the deparsed bytes as payload, headers are deserialized on demand
+    // Remove the Ethernet header, the port adds its own framing
+    EthernetHeader eth_hdr_out;
+    out_pkt->RemoveHeader(eth_hdr_out);
+
+    // Tags are copied through one reusable instance per type
+    ByteTagIterator it = packet->GetByteTagIterator();
+    while (it.HasNext())
+    {
+        ByteTagIterator::Item tag_item = it.Next();
+        Tag* tag = GetTagInstance(tag_item.GetTypeId());
+        tag_item.GetTag(*tag);
+        out_pkt->AddByteTag(*tag);
+    }
+
+    PacketTagIterator pit = packet->GetPacketTagIterator();
+    while (pit.HasNext())
+    {
+        PacketTagIterator::Item tag_item = pit.Next();
+        Tag* tag = GetTagInstance(tag_item.GetTypeId());
+        tag_item.GetTag(*tag);
+        out_pkt->AddPacketTag(*tag);
+    }
+
+    NS_LOG_DEBUG(m_node_name << " Forwarding pkt " << out_pkt << " to port " << port_n << " "
+                             << eth_hdr_out.GetDestination() << " " << eth_hdr_out.GetSource()
+                             << " " << eth_hdr_out.GetLengthType());
+
+    if (port->SupportsSendFrom())
+    {
         port->SendFrom(out_pkt,
                        eth_hdr_out.GetSource(),
                        eth_hdr_out.GetDestination(),
                        eth_hdr_out.GetLengthType());
     }
+    else
+    {
+        // e.g. point-to-point, the source address is implied by the link
+        port->Send(out_pkt, eth_hdr_out.GetDestination(), eth_hdr_out.GetLengthType());
+    }
+}
 
-    delete pkts;
+Tag*
+P4SwitchNetDevice::GetTagInstance(TypeId tid)
+{
+    uint16_t uid = tid.GetUid();
+    if (uid >= m_tags.size())
+    {
+        m_tags.resize(uid + 1);
+    }
+    if (!m_tags[uid])
+    {
+        m_tags[uid].reset(dynamic_cast<Tag*>(tid.GetConstructor()()));
+        NS_ASSERT(m_tags[uid] != nullptr);
+    }
+    return m_tags[uid].get();
 }
 
 void
@@ -197,15 +495,65 @@ P4SwitchNetDevice::InitPipeline()
 {
     NS_LOG_FUNCTION_NOARGS();
 
-    std::string node_name = Names::FindName(m_node);
+    // Names are usually assigned after the device is created, but before the simulation runs
+    m_node_name = Names::FindName(m_node);
+    const std::string& node_name = m_node_name;
     if (m_pipeline_json != "")
     {
         NS_LOG_DEBUG(node_name << " Initializing up P4 pipeline...");
-        m_p4_pipeline = new P4Pipeline(m_pipeline_json, node_name);
+        m_p4_pipeline = new P4Pipeline(m_pipeline_json,
+                                       node_name,
+                                       m_control_plane == CONTROL_PLANE_THRIFT,
+                                       static_cast<bm::Logger::LogLevel>(m_log_level),
+                                       m_lookup_cache_size);
+        m_p4_pipeline->set_header_reconstruction(m_reconstruct_headers);
+        m_p4_pipeline->enable_stats(m_table_counters, m_stage_timing_sample);
+        if (!m_event_log_file.empty())
+        {
+            m_event_sink = std::make_shared<P4EventSink>(m_event_log_file);
+            if (!m_event_sink->IsOpen() ||
+                !m_p4_pipeline->set_event_sink(m_event_sink, m_event_log_field))
+            {
+                NS_LOG_ERROR(node_name << " Cannot record " << m_event_log_field << " to "
+                                       << m_event_log_file);
+                m_event_sink = nullptr;
+            }
+        }
+        m_latency = m_processing_delay +
+                    m_table_delay * m_p4_pipeline->get_program_info().GetTables().size();
+        if (m_traffic_manager)
+        {
+            // Queueing is modeled by the traffic manager, only the pipeline latency applies
+            m_p4_pipeline->enable_traffic_manager(
+                m_egress_rate,
+                m_queue_depth,
+                [this](uint16_t port_n, Ptr<Packet> out_pkt, Ptr<const Packet> packet) {
+                    if (m_latency.IsZero())
+                    {
+                        SendOutput(port_n, out_pkt, packet);
+                        return;
+                    }
+                    Simulator::Schedule(m_latency,
+                                        &P4SwitchNetDevice::SendOutput,
+                                        this,
+                                        port_n,
+                                        out_pkt,
+                                        packet);
+                });
+        }
+        if (!m_pipeline_table_snapshot.empty())
+        {
+            std::string error;
+            if (!m_p4_pipeline->load_table_snapshot(m_pipeline_table_snapshot, error))
+            {
+                NS_FATAL_ERROR(node_name << " Cannot load table snapshot: " << error);
+            }
+        }
         if (!m_pipeline_commands.empty())
         {
-            std::this_thread::sleep_for(std::chrono::seconds(5));
-            m_p4_pipeline->run_cli_commands(m_pipeline_commands);
+            NS_LOG_DEBUG(node_name << " Running P4 pipeline commands:\n"
+                                   << m_pipeline_commands << "\n"
+                                   << m_p4_pipeline->run_cli_commands(m_pipeline_commands));
         }
     }
     else
@@ -221,21 +569,127 @@ P4SwitchNetDevice::RunPipelineCommands(std::string commands)
     return m_p4_pipeline->run_cli_commands(commands);
 }
 
+bool
+P4SwitchNetDevice::RegisterRead(const std::string& name, uint32_t index, uint64_t& value)
+{
+    if (m_p4_pipeline == nullptr)
+    {
+        InitPipeline();
+    }
+    return m_p4_pipeline &&
+           m_p4_pipeline->register_read(name, index, &value) == bm::RegisterErrorCode::SUCCESS;
+}
+
+bool
+P4SwitchNetDevice::RegisterWrite(const std::string& name, uint32_t index, uint64_t value)
+{
+    if (m_p4_pipeline == nullptr)
+    {
+        InitPipeline();
+    }
+    return m_p4_pipeline &&
+           m_p4_pipeline->register_write(name, index, value) == bm::RegisterErrorCode::SUCCESS;
+}
+
+bool
+P4SwitchNetDevice::TableAdd(const std::string& table,
+                            const std::string& action,
+                            const std::vector<std::string>& matchKey,
+                            const std::vector<std::string>& actionParams,
+                            uint32_t& handle)
+{
+    if (m_p4_pipeline == nullptr)
+    {
+        InitPipeline();
+    }
+    bm::entry_handle_t entry = 0;
+    bm::MatchErrorCode rc = m_p4_pipeline->table_add(table, action, matchKey, actionParams, &entry);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        NS_LOG_ERROR(m_node_name << " Cannot add entry to " << table << ", error "
+                                 << static_cast<int>(rc));
+        return false;
+    }
+    handle = entry;
+    return true;
+}
+
+bool
+P4SwitchNetDevice::TableModify(const std::string& table,
+                               const std::string& action,
+                               uint32_t handle,
+                               const std::vector<std::string>& actionParams)
+{
+    if (m_p4_pipeline == nullptr)
+    {
+        InitPipeline();
+    }
+    bm::MatchErrorCode rc = m_p4_pipeline->table_modify(table, action, handle, actionParams);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        NS_LOG_ERROR(m_node_name << " Cannot modify entry " << handle << " of " << table
+                                 << ", error " << static_cast<int>(rc));
+        return false;
+    }
+    return true;
+}
+
+bool
+P4SwitchNetDevice::TableDelete(const std::string& table, uint32_t handle)
+{
+    if (m_p4_pipeline == nullptr)
+    {
+        InitPipeline();
+    }
+    bm::MatchErrorCode rc = m_p4_pipeline->table_delete(table, handle);
+    if (rc != bm::MatchErrorCode::SUCCESS)
+    {
+        NS_LOG_ERROR(m_node_name << " Cannot delete entry " << handle << " of " << table
+                                 << ", error " << static_cast<int>(rc));
+        return false;
+    }
+    return true;
+}
+
+bool
+P4SwitchNetDevice::CommitTransaction(P4PipelineTransaction& transaction)
+{
+    if (m_p4_pipeline == nullptr)
+    {
+        InitPipeline();
+    }
+    std::string error;
+    if (!m_p4_pipeline->commit(transaction, error))
+    {
+        NS_LOG_ERROR(m_node_name << " Cannot commit transaction: " << error);
+        return false;
+    }
+    return true;
+}
+
+bool
+P4SwitchNetDevice::DumpTableSnapshot(std::string path)
+{
+    std::string error;
+    if (!m_p4_pipeline->dump_table_snapshot(path, error))
+    {
+        NS_LOG_ERROR(m_node_name << " Cannot dump table snapshot: " << error);
+        return false;
+    }
+    return true;
+}
+
 void
 P4SwitchNetDevice::AddPort(Ptr<NetDevice> port)
 {
     NS_LOG_FUNCTION_NOARGS();
     NS_ASSERT(port != this);
 
-    // We only support CSMA devices
-    Ptr<CsmaNetDevice> port_csma = port->GetObject<CsmaNetDevice>();
-    if (!port_csma)
-    {
-        NS_FATAL_ERROR("Device is not CSMA: cannot be added to P4 switch.");
-    }
-    if (!port->SupportsSendFrom())
+    // Any device with Ethernet-like addressing can be a port (e.g. CSMA, point-to-point,
+    // simple), the Ethernet header seen by the P4 program is rebuilt from the addresses
+    if (!Mac48Address::IsMatchingType(port->GetAddress()))
     {
-        NS_FATAL_ERROR("Device does not support SendFrom: cannot be added to switch.");
+        NS_FATAL_ERROR("Device does not use MAC-48 addresses: cannot be added to P4 switch.");
     }
     if (m_address == Mac48Address())
     {
@@ -243,12 +697,18 @@ P4SwitchNetDevice::AddPort(Ptr<NetDevice> port)
     }
 
     NS_LOG_DEBUG("RegisterProtocolHandler for " << port->GetInstanceTypeId().GetName());
-    m_node->RegisterProtocolHandler(MakeCallback(&P4SwitchNetDevice::ReceiveFromDevice, this),
-                                    0,
-                                    port,
-                                    true);
+    // Ports are numbered from 1, the number is bound to the callback to avoid looking it up
+    uint32_t port_n = m_ports.size() + 1;
+    m_node->RegisterProtocolHandler(
+        MakeCallback(&P4SwitchNetDevice::ReceiveFromDevice, this, port_n),
+        0,
+        port,
+        true);
     m_ports.push_back(port);
-    m_channel->AddChannel(port->GetChannel());
+    if (port->GetChannel())
+    {
+        m_channel->AddChannel(port->GetChannel());
+    }
 }
 
 uint32_t
@@ -18,16 +18,22 @@
 #ifndef P4_SWITCH_NET_DEVICE_H
 #define P4_SWITCH_NET_DEVICE_H
 
+#include "ns3/data-rate.h"
+#include "ns3/event-id.h"
 #include "ns3/mac48-address.h"
 #include "ns3/net-device.h"
 #include "ns3/nstime.h"
 #include "ns3/p4-pipeline.h"
 #include "ns3/p4-switch-channel.h"
+#include "ns3/tag.h"
+#include "ns3/traced-callback.h"
 
 #include <list>
 #include <map>
+#include <memory>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 /**
  * \file
@@ -62,12 +68,52 @@ class P4SwitchNetDevice : public NetDevice
      * \return the object TypeId
      */
     static TypeId GetTypeId();
+
+    /**
+     * How the P4 pipeline can be controlled
+     */
+    enum ControlPlane
+    {
+        CONTROL_PLANE_INPROC, //!< Only through the in-process API, no server threads or sockets
+        CONTROL_PLANE_THRIFT, //!< Also through Thrift (simple_switch_CLI) and nanomsg
+    };
+
+    /**
+     * Verbosity of the bmv2 logger, in the order of bm::Logger::LogLevel
+     */
+    enum LogLevel
+    {
+        LOG_LEVEL_TRACE,    //!< Every step of the packet processing
+        LOG_LEVEL_DEBUG,    //!< Debugging messages
+        LOG_LEVEL_INFO,     //!< Informational messages, including log_msg()
+        LOG_LEVEL_WARN,     //!< Warnings
+        LOG_LEVEL_ERROR,    //!< Errors
+        LOG_LEVEL_CRITICAL, //!< Critical errors
+        LOG_LEVEL_OFF,      //!< No logging, the console logger is not created
+    };
+
+    /**
+     * TracedCallback signature for the counters of the P4 pipeline.
+     *
+     * \param [in] stats the counters, cumulative since the start of the simulation
+     */
+    typedef void (*StatsTracedCallback)(const P4PipelineStats& stats);
+
     P4SwitchNetDevice();
     ~P4SwitchNetDevice() override;
 
     P4SwitchNetDevice(const P4SwitchNetDevice&) = delete;
     P4SwitchNetDevice& operator=(const P4SwitchNetDevice&) = delete;
 
+    /**
+     * \brief Add a port to the switch
+     *
+     * Ports can be any NetDevice with MAC-48 addresses (e.g. CSMA, point-to-point or simple
+     * devices). Packets are sent with SendFrom() when the port supports it, with Send()
+     * otherwise.
+     *
+     * \param port the port
+     */
     void AddPort(Ptr<NetDevice> port);
     uint32_t GetNPorts() const;
     Ptr<NetDevice> GetPort(uint32_t n) const;
@@ -80,6 +126,89 @@ class P4SwitchNetDevice : public NetDevice
 
     std::string RunPipelineCommands(std::string commands);
 
+    /**
+     * \brief Read a register cell of the P4 program
+     * \param name the register name, can be abbreviated to any unique suffix
+     * \param index the cell
+     * \param value set to the value of the cell
+     * \return false if the register does not exist or the index is out of range
+     */
+    bool RegisterRead(const std::string& name, uint32_t index, uint64_t& value);
+
+    /**
+     * \brief Write a register cell of the P4 program
+     * \param name the register name, can be abbreviated to any unique suffix
+     * \param index the cell
+     * \param value the value
+     * \return false if the register does not exist or the index is out of range
+     */
+    bool RegisterWrite(const std::string& name, uint32_t index, uint64_t value);
+
+    /**
+     * \brief Add an entry to a match-action table of the P4 program
+     *
+     * Unlike RunPipelineCommands(), the entry is added with a direct call, with no command
+     * parsing, so that controllers can reprogram the switch at every simulated event.
+     *
+     * \param table the table name, can be abbreviated to any unique suffix
+     * \param action the action name, can be abbreviated to any unique suffix
+     * \param matchKey one value per key field, in the CLI format (e.g. "2001::1/128")
+     * \param actionParams one value per action parameter, in the CLI format
+     * \param handle set to the handle of the new entry
+     * \return false if the entry cannot be added
+     */
+    bool TableAdd(const std::string& table,
+                  const std::string& action,
+                  const std::vector<std::string>& matchKey,
+                  const std::vector<std::string>& actionParams,
+                  uint32_t& handle);
+
+    /**
+     * \brief Change the action of an entry of a match-action table of the P4 program
+     *
+     * The entry keeps matching while its action changes, so no packet can miss it.
+     *
+     * \param table the table name, can be abbreviated to any unique suffix
+     * \param action the action name, can be abbreviated to any unique suffix
+     * \param handle the entry handle, as returned by TableAdd()
+     * \param actionParams one value per action parameter, in the CLI format
+     * \return false if the entry cannot be modified
+     */
+    bool TableModify(const std::string& table,
+                     const std::string& action,
+                     uint32_t handle,
+                     const std::vector<std::string>& actionParams);
+
+    /**
+     * \brief Delete an entry of a match-action table of the P4 program
+     * \param table the table name, can be abbreviated to any unique suffix
+     * \param handle the entry handle, as returned by TableAdd()
+     * \return false if the entry cannot be deleted
+     */
+    bool TableDelete(const std::string& table, uint32_t handle);
+
+    /**
+     * \brief Apply a set of table and multicast changes all at once
+     *
+     * Packets are processed either before all the changes or after all of them. If a change
+     * fails, the ones already applied are undone and nothing changes.
+     *
+     * \param transaction the changes, the handles of the added entries are stored in it
+     * \return false if the changes cannot be applied
+     */
+    bool CommitTransaction(P4PipelineTransaction& transaction);
+
+    /**
+     * \brief Save the current state of the match-action tables
+     *
+     * The file can be loaded back through the PipelineTableSnapshot attribute, to skip
+     * rebuilding the tables with PipelineCommands in later runs.
+     *
+     * \param path the file to write
+     * \return true on success
+     */
+    bool DumpTableSnapshot(std::string path);
+
     // inherited from NetDevice base class.
     void SetIfIndex(const uint32_t index) override;
     uint32_t GetIfIndex() const override;
@@ -112,15 +241,71 @@ class P4SwitchNetDevice : public NetDevice
   protected:
     void DoDispose() override;
 
-    void ReceiveFromDevice(Ptr<NetDevice> device,
+    /**
+     * \brief Receive a packet from a port
+     * \param port_n the port number, bound to the callback when the port is added
+     * \param device the port
+     * \param packet the packet
+     * \param protocol the protocol number
+     * \param source the source address
+     * \param destination the destination address
+     * \param packetType the packet type
+     */
+    void ReceiveFromDevice(uint32_t port_n,
+                           Ptr<NetDevice> device,
                            Ptr<const Packet> packet,
                            uint16_t protocol,
                            const Address& source,
                            const Address& destination,
                            PacketType packetType);
 
+    /**
+     * \brief Run the P4 pipeline over the received packets and send the outputs
+     *
+     * With P4WorkerThreads set, the pipeline runs later at the same simulation time, in
+     * parallel with the ones of other switches. Packets received meanwhile are processed in
+     * the same job, still one at a time unless BatchProcessing is set.
+     */
+    void ProcessInputs();
+
+    /**
+     * \brief Hand the received packets to the P4 pipeline
+     */
+    void PrepareInputs();
+
+    /**
+     * \brief Collect the packets emitted by the P4 pipeline and send them
+     */
+    void SendOutputs();
+
+    /**
+     * \brief Send the packets emitted by the P4 pipeline for the current batch, after the
+     *        latency of the pipeline
+     */
+    void ScheduleOutputs();
+
+    /**
+     * \brief Send a packet emitted by the P4 pipeline
+     * \param port_n the egress port
+     * \param out_pkt the packet to send
+     * \param packet the received packet it derives from, its tags are copied
+     */
+    void SendOutput(uint16_t port_n, Ptr<Packet> out_pkt, Ptr<const Packet> packet);
+
     void InitPipeline();
 
+    /**
+     * \brief Get the instance used to copy the tags of a type, created on first use
+     * \param tid the TypeId of the tag
+     * \return the tag instance
+     */
+    Tag* GetTagInstance(TypeId tid);
+
+    /**
+     * \brief Write the counters of the P4 pipeline to StatsFile, or to the standard output
+     */
+    void DumpStats();
+
   private:
     NetDevice::ReceiveCallback m_rxCallback;               //!< receive callback
     NetDevice::PromiscReceiveCallback m_promiscRxCallback; //!< promiscuous receive callback
@@ -128,11 +313,49 @@ class P4SwitchNetDevice : public NetDevice
     Mac48Address m_address; //!< MAC address of the NetDevice, this is the MAC Address of the first
                             //!< interface added
 
-    P4Pipeline* m_p4_pipeline;       //!< The P4 pipeline
-    std::string m_pipeline_json;     //!< The bmv2 JSON file (generated by the p4c backend)
-    std::string m_pipeline_commands; //!< The CLI commands to run
+    P4Pipeline* m_p4_pipeline;               //!< The P4 pipeline
+    std::string m_pipeline_json;             //!< The bmv2 JSON file (generated by the p4c backend)
+    std::string m_pipeline_commands;         //!< The CLI commands to run
+    std::string m_pipeline_table_snapshot;   //!< Table snapshot to load, empty if none
+    ControlPlane m_control_plane;            //!< How the P4 pipeline can be controlled
+    bool m_reconstruct_headers;              //!< Whether to add ns-3 Headers to the output packets
+    std::vector<P4PipelineOutput> m_outputs; //!< Pipeline output, reused across batches
+
+    LogLevel m_log_level;                      //!< Verbosity of the bmv2 logger
+    std::string m_event_log_file;              //!< File of the per-packet events, empty if disabled
+    std::string m_event_log_field;             //!< Header field recorded in the events
+    std::shared_ptr<P4EventSink> m_event_sink; //!< Sink of the per-packet events
+
+    bool m_batch_processing;                     //!< Whether to process packets in batches
+    Time m_batch_window;                         //!< How long to wait for more packets in a batch
+    EventId m_batch_event;                       //!< Event processing the current batch
+    bool m_job_pending;                          //!< Whether a job was submitted to the executor
+    std::vector<P4PipelineInput> m_inputs;       //!< Packets received for the next batch
+    std::vector<P4PipelineInput> m_batch_inputs; //!< Packets of the batch being processed
+
+    bool m_traffic_manager; //!< Whether to queue packets between ingress and egress
+    DataRate m_egress_rate; //!< Drain rate of the egress ports
+    uint32_t m_queue_depth; //!< Capacity of the egress queues, in packets
+
+    Time m_processing_delay;          //!< Fixed latency of the pipeline
+    Time m_table_delay;               //!< Latency of each match-action table
+    Time m_replication_delay;         //!< Latency of each replica after the first
+    uint64_t m_pipeline_throughput;   //!< Packets per second entering the pipeline, 0 if unlimited
+    Time m_latency;                   //!< Latency of the pipeline, for the loaded program
+    Time m_pipeline_free;             //!< When the pipeline can accept the next packet
+    std::vector<Time> m_input_delays; //!< Latency of each input packet of the batch
+    std::vector<uint32_t> m_replicas; //!< Outputs sent so far for each input packet
+
+    uint32_t m_lookup_cache_size;                         //!< Lookups cached by each table
+    bool m_table_counters;                                //!< Whether to count table hits
+    uint32_t m_stage_timing_sample;                       //!< Batches per stage timing sample
+    std::string m_stats_file;                             //!< Where to dump the counters
+    TracedCallback<const P4PipelineStats&> m_stats_trace; //!< Counters after each batch
+
+    std::vector<std::unique_ptr<Tag>> m_tags; //!< Instances used to copy tags, by TypeId uid
 
     Ptr<Node> m_node;                    //!< node owning this NetDevice
+    std::string m_node_name;             //!< name of the node, cached when the pipeline starts
     Ptr<P4SwitchChannel> m_channel;      //!< virtual channel
     std::vector<Ptr<NetDevice>> m_ports; //!< ports
     uint32_t m_ifIndex;                  //!< Interface index
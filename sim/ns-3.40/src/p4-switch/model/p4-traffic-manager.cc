@@ -0,0 +1,151 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "p4-traffic-manager.h"
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include <bm/bm_sim/phv.h>
+
+#include <algorithm>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::P4TrafficManager implementation.
+ */
+
+namespace ns3
+{
+NS_LOG_COMPONENT_DEFINE("P4TrafficManager");
+
+P4TrafficManager::P4TrafficManager(DataRate rate, uint32_t depth, EgressHandler egress)
+    : m_rate(rate),
+      m_depth(depth),
+      m_egress(egress)
+{
+    NS_LOG_FUNCTION(this << rate << depth);
+}
+
+P4TrafficManager::~P4TrafficManager()
+{
+    NS_LOG_FUNCTION(this);
+    for (auto& port : m_ports)
+    {
+        port.dequeueEvent.Cancel();
+    }
+}
+
+bool
+P4TrafficManager::Enqueue(uint16_t port,
+                          uint32_t priority,
+                          std::unique_ptr<bm::Packet> packet,
+                          Ptr<const Packet> origin)
+{
+    if (port >= m_ports.size())
+    {
+        m_ports.resize(port + 1);
+    }
+    priority = std::min(priority, N_PRIORITIES - 1);
+
+    Port& state = m_ports[port];
+    std::deque<Entry>& queue = state.queues[priority];
+    if (queue.size() >= m_depth)
+    {
+        NS_LOG_LOGIC("Queue " << priority << " of port " << port << " is full, dropping packet");
+        return false;
+    }
+
+    uint32_t qdepth = queue.size();
+    uint64_t now = Simulator::Now().GetNanoSeconds();
+    queue.push_back({std::move(packet), origin, now, qdepth});
+
+    if (!state.busy)
+    {
+        // Dequeue in a separate event, so that packets enqueued at the same time see each other
+        state.busy = true;
+        state.dequeueEvent = Simulator::ScheduleNow(&P4TrafficManager::Dequeue, this, port);
+    }
+    return true;
+}
+
+uint32_t
+P4TrafficManager::GetQueueDepth(uint16_t port, uint32_t priority) const
+{
+    if (port >= m_ports.size() || priority >= N_PRIORITIES)
+    {
+        return 0;
+    }
+    return m_ports[port].queues[priority].size();
+}
+
+void
+P4TrafficManager::Dequeue(uint16_t port)
+{
+    Port& state = m_ports[port];
+
+    uint32_t priority = N_PRIORITIES;
+    while (priority > 0 && state.queues[priority - 1].empty())
+    {
+        priority--;
+    }
+    if (priority == 0)
+    {
+        state.busy = false;
+        return;
+    }
+    std::deque<Entry>& queue = state.queues[priority - 1];
+
+    Entry entry = std::move(queue.front());
+    queue.pop_front();
+
+    // Same fields as simple_switch, timestamps are in nanoseconds like the global timestamps
+    // of the pipeline, and enq_timestamp wraps around at its 32 bits
+    uint64_t now = Simulator::Now().GetNanoSeconds();
+    bm::PHV* phv = entry.packet->get_phv();
+    if (phv->has_field("queueing_metadata.enq_timestamp"))
+    {
+        phv->get_field("queueing_metadata.enq_timestamp").set(entry.enqTimestamp);
+    }
+    if (phv->has_field("queueing_metadata.enq_qdepth"))
+    {
+        phv->get_field("queueing_metadata.enq_qdepth").set(entry.enqQdepth);
+    }
+    if (phv->has_field("queueing_metadata.deq_timedelta"))
+    {
+        phv->get_field("queueing_metadata.deq_timedelta").set(now - entry.enqTimestamp);
+    }
+    if (phv->has_field("queueing_metadata.deq_qdepth"))
+    {
+        phv->get_field("queueing_metadata.deq_qdepth").set(queue.size());
+    }
+    if (phv->has_field("queueing_metadata.qid"))
+    {
+        phv->get_field("queueing_metadata.qid").set(priority - 1);
+    }
+
+    uint32_t size = m_egress(port, entry.packet, entry.origin);
+
+    // The port is busy while transmitting the packet, a dropped packet takes no time
+    state.dequeueEvent = Simulator::Schedule(m_rate.CalculateBytesTxTime(size),
+                                             &P4TrafficManager::Dequeue,
+                                             this,
+                                             port);
+}
+
+} // namespace ns3
@@ -0,0 +1,136 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef P4_TRAFFIC_MANAGER_H
+#define P4_TRAFFIC_MANAGER_H
+
+#include "ns3/data-rate.h"
+#include "ns3/event-id.h"
+#include "ns3/packet.h"
+
+#include <bm/bm_sim/packet.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::P4TrafficManager declaration.
+ */
+
+namespace ns3
+{
+
+/**
+ * \ingroup p4-switch
+ * \brief Egress queues between the ingress and the egress of a P4 pipeline
+ *
+ * Modeled after the simple_switch traffic manager: each egress port has one FIFO per priority,
+ * served in strict priority order (the highest first) and drained at a fixed rate. Each queue
+ * holds up to a fixed number of packets, packets arriving to a full queue are dropped.
+ *
+ * When a packet is dequeued, the queueing metadata is filled (if the P4 program declares it)
+ * and the packet is handed to the egress handler, which runs the egress pipeline and sends it.
+ * The port is then busy for the transmission time of the packet at the drain rate. All the
+ * operations are O(1) and the queues are only served by simulator events.
+ */
+class P4TrafficManager
+{
+  public:
+    static constexpr uint32_t N_PRIORITIES = 8; //!< Number of priorities, as in simple_switch
+
+    /**
+     * \brief Handler running the egress of a dequeued packet
+     *
+     * Arguments are the egress port, the packet and the ns-3 packet it derives from. It returns
+     * the number of bytes sent, 0 if the packet was dropped.
+     */
+    using EgressHandler =
+        std::function<uint32_t(uint16_t, std::unique_ptr<bm::Packet>&, Ptr<const Packet>)>;
+
+    /**
+     * \brief Constructor
+     * \param rate the drain rate of each port
+     * \param depth the capacity of each queue, in packets
+     * \param egress the handler of dequeued packets
+     */
+    P4TrafficManager(DataRate rate, uint32_t depth, EgressHandler egress);
+    ~P4TrafficManager();
+
+    P4TrafficManager(const P4TrafficManager&) = delete;
+    P4TrafficManager& operator=(const P4TrafficManager&) = delete;
+
+    /**
+     * \brief Enqueue a packet
+     * \param port the egress port
+     * \param priority the priority, values above the highest one are capped
+     * \param packet the packet
+     * \param origin the ns-3 packet the packet derives from
+     * \return false if the queue was full and the packet was dropped
+     */
+    bool Enqueue(uint16_t port,
+                 uint32_t priority,
+                 std::unique_ptr<bm::Packet> packet,
+                 Ptr<const Packet> origin);
+
+    /**
+     * \brief Get the number of packets queued for a port
+     * \param port the egress port
+     * \param priority the priority
+     * \return the queue depth, in packets
+     */
+    uint32_t GetQueueDepth(uint16_t port, uint32_t priority) const;
+
+  private:
+    /**
+     * A queued packet
+     */
+    struct Entry
+    {
+        std::unique_ptr<bm::Packet> packet; //!< bmv2 packet
+        Ptr<const Packet> origin;           //!< ns-3 packet it derives from
+        uint64_t enqTimestamp;              //!< Enqueue time, in nanoseconds
+        uint32_t enqQdepth;                 //!< Queue depth at enqueue time
+    };
+
+    /**
+     * State of an egress port
+     */
+    struct Port
+    {
+        std::deque<Entry> queues[N_PRIORITIES]; //!< One FIFO per priority
+        EventId dequeueEvent;                   //!< Next dequeue
+        bool busy = false;                      //!< Whether a dequeue is scheduled
+    };
+
+    /**
+     * \brief Dequeue a packet from a port, and schedule the next dequeue
+     * \param port the egress port
+     */
+    void Dequeue(uint16_t port);
+
+    DataRate m_rate;          //!< Drain rate of each port
+    uint32_t m_depth;         //!< Capacity of each queue, in packets
+    EgressHandler m_egress;   //!< Handler of dequeued packets
+    std::deque<Port> m_ports; //!< Ports, by index (a deque does not move them when growing)
+};
+
+} // namespace ns3
+
+#endif /* P4_TRAFFIC_MANAGER_H */
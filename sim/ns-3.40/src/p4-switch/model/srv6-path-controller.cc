@@ -0,0 +1,465 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#include "srv6-path-controller.h"
+
+#include "ipv6-segment-routing-header.h"
+#include "live-live-tlv-header.h"
+
+#include "ns3/abort.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/ethernet-header.h"
+#include "ns3/ipv6-header.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/tcp-header.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::SrV6PathController implementation.
+ */
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("SrV6PathController");
+
+NS_OBJECT_ENSURE_REGISTERED(SrV6PathController);
+
+/**
+ * Table selecting the path of the flows at the spreader and at the merger
+ */
+static const char* FLOW_TABLE = "check_live_live_enabled";
+
+/**
+ * EtherType of IPv6
+ */
+static const uint16_t ETHERTYPE_IPV6 = 0x86dd;
+
+/**
+ * SRH tag of the replicas, set by live_live_mcast
+ */
+static const uint16_t LIVE_LIVE_TAG = 1;
+
+TypeId
+SrV6PathController::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::SrV6PathController")
+            .SetParent<Object>()
+            .SetGroupName("P4Switch")
+            .AddConstructor<SrV6PathController>()
+            .AddAttribute("Mode",
+                          "Events the controller reacts to",
+                          EnumValue(SrV6PathController::LATENCY),
+                          MakeEnumAccessor(&SrV6PathController::m_mode),
+                          MakeEnumChecker(SrV6PathController::LATENCY,
+                                          "latency",
+                                          SrV6PathController::TCP,
+                                          "tcp"))
+            .AddAttribute("TargetLatency",
+                          "Latency of the current path that replicates the flow on all the "
+                          "paths, in latency mode",
+                          TimeValue(MicroSeconds(1500)),
+                          MakeTimeAccessor(&SrV6PathController::m_target_latency),
+                          MakeTimeChecker())
+            .AddAttribute("Percentile",
+                          "Percentile of the samples of a path used as its latency",
+                          DoubleValue(50),
+                          MakeDoubleAccessor(&SrV6PathController::m_percentile),
+                          MakeDoubleChecker<double>(0, 100))
+            .AddAttribute("WindowSize",
+                          "Latency samples kept for each path",
+                          UintegerValue(16),
+                          MakeUintegerAccessor(&SrV6PathController::m_window_size),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("MinSamples",
+                          "Latency samples of the current path needed to compare it with "
+                          "TargetLatency",
+                          UintegerValue(4),
+                          MakeUintegerAccessor(&SrV6PathController::m_min_samples),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("ProbeTime",
+                          "Time the flow is replicated on all the paths before choosing one",
+                          TimeValue(Seconds(1)),
+                          MakeTimeAccessor(&SrV6PathController::m_probe_time),
+                          MakeTimeChecker(NanoSeconds(1)))
+            .AddAttribute("OutOfOrderThreshold",
+                          "Out of order TCP segments that move the flow to TcpPath, in tcp mode",
+                          UintegerValue(34),
+                          MakeUintegerAccessor(&SrV6PathController::m_ooo_threshold),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("TcpPath",
+                          "Path, in AddPath() order, the flow is moved to by out of order TCP "
+                          "segments, in tcp mode",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&SrV6PathController::m_tcp_path),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("MulticastGroup",
+                          "Multicast group of the spreader replicating on all the paths",
+                          UintegerValue(1),
+                          MakeUintegerAccessor(&SrV6PathController::m_mcast_group),
+                          MakeUintegerChecker<uint16_t>(1))
+            .AddAttribute("SpreaderAddress",
+                          "Source address of the SRv6 encapsulation of the spreader",
+                          Ipv6AddressValue("e1::2"),
+                          MakeIpv6AddressAccessor(&SrV6PathController::m_spreader_address),
+                          MakeIpv6AddressChecker())
+            .AddAttribute("MergerAddress",
+                          "Source address of the SRv6 encapsulation of the merger",
+                          Ipv6AddressValue("e2::2"),
+                          MakeIpv6AddressAccessor(&SrV6PathController::m_merger_address),
+                          MakeIpv6AddressChecker())
+            .AddTraceSource("Sample",
+                            "Latency sample of a path",
+                            MakeTraceSourceAccessor(&SrV6PathController::m_sample_trace),
+                            "ns3::SrV6PathController::LatencyTracedCallback")
+            .AddTraceSource("Latency",
+                            "Latency of a path, at every sample",
+                            MakeTraceSourceAccessor(&SrV6PathController::m_latency_trace),
+                            "ns3::SrV6PathController::LatencyTracedCallback")
+            .AddTraceSource("Alert",
+                            "The current path crossed the threshold of the mode",
+                            MakeTraceSourceAccessor(&SrV6PathController::m_alert_trace),
+                            "ns3::SrV6PathController::PathTracedCallback")
+            .AddTraceSource("PathChange",
+                            "The flow moved to another path",
+                            MakeTraceSourceAccessor(&SrV6PathController::m_path_trace),
+                            "ns3::SrV6PathController::PathTracedCallback");
+
+    return tid;
+}
+
+SrV6PathController::SrV6PathController()
+    : m_spreader_handle(0),
+      m_merger_handle(0),
+      m_path(0),
+      m_probing(false),
+      m_last_seq(0),
+      m_ooo_segments(0)
+{
+    NS_LOG_FUNCTION_NOARGS();
+}
+
+SrV6PathController::~SrV6PathController()
+{
+    NS_LOG_FUNCTION_NOARGS();
+}
+
+void
+SrV6PathController::DoDispose()
+{
+    NS_LOG_FUNCTION_NOARGS();
+    m_probe_event.Cancel();
+    m_spreader = nullptr;
+    m_merger = nullptr;
+    m_paths.clear();
+    Object::DoDispose();
+}
+
+void
+SrV6PathController::SetSpreader(Ptr<P4SwitchNetDevice> spreader)
+{
+    m_spreader = spreader;
+}
+
+void
+SrV6PathController::SetMerger(Ptr<P4SwitchNetDevice> merger)
+{
+    m_merger = merger;
+}
+
+void
+SrV6PathController::SetFlow(Ipv6Address source, Ipv6Address destination)
+{
+    m_source = source;
+    m_destination = destination;
+}
+
+void
+SrV6PathController::AddPath(uint32_t spreaderPort, uint32_t mergerPort, Ptr<NetDevice> mergerLink)
+{
+    m_paths.push_back({spreaderPort, mergerPort, mergerLink, {}, 0, 0, Time(0), false});
+}
+
+void
+SrV6PathController::Start()
+{
+    NS_LOG_FUNCTION(this);
+    NS_ABORT_MSG_IF(!m_spreader || !m_merger, "Spreader and merger must be set");
+    NS_ABORT_MSG_IF(m_paths.empty(), "At least a path must be added");
+    NS_ABORT_MSG_IF(m_mode == TCP && m_tcp_path >= m_paths.size(),
+                    "TcpPath " << m_tcp_path << " is not a path");
+
+    std::ostringstream source;
+    source << m_source << "/128";
+    std::ostringstream destination;
+    destination << m_destination << "/128";
+    std::ostringstream spreaderAddress;
+    spreaderAddress << m_spreader_address;
+    std::ostringstream mergerAddress;
+    mergerAddress << m_merger_address;
+
+    m_path = 0;
+    NS_ABORT_MSG_IF(!m_spreader->TableAdd(FLOW_TABLE,
+                                          "ipv6_encap_forward_port",
+                                          {source.str()},
+                                          {spreaderAddress.str(),
+                                           std::to_string(m_paths[m_path].spreaderPort)},
+                                          m_spreader_handle),
+                    "Cannot add the entry of " << m_source << " to the spreader");
+    NS_ABORT_MSG_IF(!m_merger->TableAdd(FLOW_TABLE,
+                                        "ipv6_encap_forward_port",
+                                        {destination.str()},
+                                        {mergerAddress.str(),
+                                         std::to_string(m_paths[m_path].mergerPort)},
+                                        m_merger_handle),
+                    "Cannot add the entry of " << m_destination << " to the merger");
+
+    for (uint32_t i = 0; i < m_paths.size(); i++)
+    {
+        m_paths[i].samples.assign(m_window_size, 0);
+        m_paths[i].link->TraceConnectWithoutContext(
+            "MacPromiscRx",
+            MakeCallback(&SrV6PathController::ReceiveFrame, this).Bind(i));
+    }
+    m_scratch.reserve(m_window_size);
+}
+
+void
+SrV6PathController::ReceiveFrame(uint32_t path, Ptr<const Packet> packet)
+{
+    Ptr<Packet> frame = packet->Copy();
+    EthernetHeader eth;
+    frame->RemoveHeader(eth);
+    if (eth.GetLengthType() != ETHERTYPE_IPV6)
+    {
+        return;
+    }
+
+    Ipv6Header outer;
+    frame->RemoveHeader(outer);
+    if (outer.GetNextHeader() != Ipv6Header::IPV6_EXT_ROUTING)
+    {
+        return;
+    }
+
+    // Packets sent before the last change of the entry still arrive, they are not sampled
+    Ipv6SegmentRoutingHeader srh;
+    frame->RemoveHeader(srh);
+    bool replica = srh.GetTag() == LIVE_LIVE_TAG;
+    if (replica != m_probing)
+    {
+        return;
+    }
+    if (replica)
+    {
+        LiveLiveTlvHeader tlv;
+        frame->RemoveHeader(tlv);
+    }
+
+    Ipv6Header inner;
+    frame->PeekHeader(inner);
+    if (inner.GetSource() != m_source || inner.GetDestination() != m_destination)
+    {
+        return;
+    }
+
+    // A sample every two packets, as the time between them
+    Path& p = m_paths[path];
+    if (!p.pending)
+    {
+        p.first = Simulator::Now();
+        p.pending = true;
+        return;
+    }
+    p.pending = false;
+    AddSample(path, Simulator::Now() - p.first);
+}
+
+void
+SrV6PathController::AddSample(uint32_t path, Time sample)
+{
+    Path& p = m_paths[path];
+    p.samples[p.next] = sample.GetNanoSeconds();
+    p.next = (p.next + 1) % m_window_size;
+    p.count = std::min(p.count + 1, m_window_size);
+    m_sample_trace(path, sample);
+
+    Time latency = GetLatency(path);
+    m_latency_trace(path, latency);
+
+    if (m_mode == LATENCY && !m_probing && path == m_path && p.count >= m_min_samples &&
+        latency >= m_target_latency)
+    {
+        NS_LOG_DEBUG("Latency " << latency << " of path " << path << " above target");
+        m_alert_trace(path);
+        StartProbe();
+    }
+}
+
+Time
+SrV6PathController::GetLatency(uint32_t path)
+{
+    const Path& p = m_paths[path];
+    if (p.count == 0)
+    {
+        return Time(0);
+    }
+
+    m_scratch.assign(p.samples.begin(), p.samples.begin() + p.count);
+    uint32_t rank = std::ceil(m_percentile / 100 * p.count);
+    auto nth = m_scratch.begin() + (rank > 0 ? rank - 1 : 0);
+    std::nth_element(m_scratch.begin(), nth, m_scratch.end());
+    return NanoSeconds(*nth);
+}
+
+void
+SrV6PathController::ClearSamples()
+{
+    for (auto& p : m_paths)
+    {
+        p.next = 0;
+        p.count = 0;
+        p.pending = false;
+    }
+}
+
+void
+SrV6PathController::ModifyEntry(Ptr<P4SwitchNetDevice> device,
+                                uint32_t handle,
+                                const std::string& action,
+                                const std::vector<std::string>& params)
+{
+    NS_ABORT_MSG_IF(!device->TableModify(FLOW_TABLE, action, handle, params),
+                    "Cannot modify entry " << handle << " of " << FLOW_TABLE);
+}
+
+void
+SrV6PathController::StartProbe()
+{
+    NS_LOG_FUNCTION(this);
+
+    std::ostringstream spreaderAddress;
+    spreaderAddress << m_spreader_address;
+    ModifyEntry(m_spreader,
+                m_spreader_handle,
+                "live_live_mcast",
+                {std::to_string(m_mcast_group), spreaderAddress.str()});
+
+    m_probing = true;
+    ClearSamples();
+    m_probe_event = Simulator::Schedule(m_probe_time, &SrV6PathController::EndProbe, this);
+}
+
+void
+SrV6PathController::EndProbe()
+{
+    NS_LOG_FUNCTION(this);
+
+    // Without replicas received, the flow goes back to its path
+    uint32_t best = m_path;
+    Time bestLatency = Time::Max();
+    for (uint32_t i = 0; i < m_paths.size(); i++)
+    {
+        if (m_paths[i].count == 0)
+        {
+            continue;
+        }
+        Time latency = GetLatency(i);
+        if (latency < bestLatency)
+        {
+            best = i;
+            bestLatency = latency;
+        }
+    }
+
+    m_probing = false;
+    NS_LOG_DEBUG("Best path " << best << " with latency " << bestLatency);
+    SetPath(best);
+}
+
+void
+SrV6PathController::SetPath(uint32_t path)
+{
+    NS_LOG_FUNCTION(this << path);
+
+    std::ostringstream spreaderAddress;
+    spreaderAddress << m_spreader_address;
+    std::ostringstream mergerAddress;
+    mergerAddress << m_merger_address;
+    ModifyEntry(m_spreader,
+                m_spreader_handle,
+                "ipv6_encap_forward_port",
+                {spreaderAddress.str(), std::to_string(m_paths[path].spreaderPort)});
+    ModifyEntry(m_merger,
+                m_merger_handle,
+                "ipv6_encap_forward_port",
+                {mergerAddress.str(), std::to_string(m_paths[path].mergerPort)});
+
+    ClearSamples();
+    if (path != m_path)
+    {
+        m_path = path;
+        m_path_trace(path);
+    }
+}
+
+void
+SrV6PathController::ReceiveTcpSegment(Ptr<const Packet> packet,
+                                      const TcpHeader& header,
+                                      Ptr<const TcpSocketBase> socket)
+{
+    SequenceNumber32 seq = header.GetSequenceNumber();
+    if (seq > m_last_seq)
+    {
+        m_last_seq = seq;
+        return;
+    }
+
+    m_ooo_segments++;
+    if (m_mode == TCP && m_ooo_segments >= m_ooo_threshold)
+    {
+        NS_LOG_DEBUG(m_ooo_segments << " out of order segments on path " << m_path);
+        m_alert_trace(m_path);
+        m_ooo_segments = 0;
+        m_probe_event.Cancel();
+        m_probing = false;
+        SetPath(m_tcp_path);
+    }
+}
+
+uint32_t
+SrV6PathController::GetPath() const
+{
+    return m_path;
+}
+
+bool
+SrV6PathController::IsProbing() const
+{
+    return m_probing;
+}
+
+} // namespace ns3
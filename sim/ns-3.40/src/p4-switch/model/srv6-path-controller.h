@@ -0,0 +1,264 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+#ifndef SRV6_PATH_CONTROLLER_H
+#define SRV6_PATH_CONTROLLER_H
+
+#include "ns3/event-id.h"
+#include "ns3/ipv6-address.h"
+#include "ns3/net-device.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/p4-switch-net-device.h"
+#include "ns3/sequence-number.h"
+#include "ns3/traced-callback.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch
+ * ns3::SrV6PathController declaration.
+ */
+
+namespace ns3
+{
+
+class TcpHeader;
+class TcpSocketBase;
+
+/**
+ * \ingroup p4-switch
+ * \brief moves an SD-WAN flow between the paths of two switches running srv6_livelive.p4
+ *
+ * The controller owns the check_live_live_enabled entries of one flow: the source/128 entry
+ * of the spreader and the destination/128 entry of the merger, for the returning packets.
+ * Both are added by Start() on the first path and then only modified, with direct calls to
+ * the switches, so the flow never falls back to the default action of the table.
+ *
+ * It reacts to the traces it is connected to, without polling:
+ *
+ * - the frames received by the merger on each path (MacPromiscRx of the links added with
+ *   AddPath()) give a latency sample every two packets of the flow, as the time between
+ *   them. The last WindowSize samples of each path are kept, and their Percentile is the
+ *   latency of the path;
+ * - in latency Mode, when the latency of the current path reaches TargetLatency, the flow
+ *   is replicated on all the paths with live_live_mcast for ProbeTime, and then moved to
+ *   the path with the lowest latency of the replicas;
+ * - in tcp Mode, the segments received by the TCP receiver (Rx of its TcpSocketBase,
+ *   connected to ReceiveTcpSegment()) are counted when out of order, and the flow is moved
+ *   to TcpPath, the backup path of live-live-sdwan by default, when they reach
+ *   OutOfOrderThreshold.
+ */
+class SrV6PathController : public Object
+{
+  public:
+    /**
+     * \brief Get the type ID.
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * Events the controller reacts to
+     */
+    enum Mode
+    {
+        LATENCY, //!< Latency of the current path above TargetLatency
+        TCP,     //!< Out of order TCP segments above OutOfOrderThreshold
+    };
+
+    /**
+     * TracedCallback signature for the latency of a path.
+     *
+     * \param [in] path the path, in AddPath() order
+     * \param [in] latency a sample, or the percentile of the samples of the path
+     */
+    typedef void (*LatencyTracedCallback)(uint32_t path, Time latency);
+
+    /**
+     * TracedCallback signature for a path.
+     *
+     * \param [in] path the path, in AddPath() order
+     */
+    typedef void (*PathTracedCallback)(uint32_t path);
+
+    SrV6PathController();
+    ~SrV6PathController() override;
+
+    /**
+     * \brief Set the switch that encapsulates the flow
+     * \param spreader a P4SwitchNetDevice running srv6_livelive.p4
+     */
+    void SetSpreader(Ptr<P4SwitchNetDevice> spreader);
+
+    /**
+     * \brief Set the switch that decapsulates the flow
+     * \param merger a P4SwitchNetDevice running srv6_livelive.p4
+     */
+    void SetMerger(Ptr<P4SwitchNetDevice> merger);
+
+    /**
+     * \brief Set the flow to control
+     * \param source the address of the sender, behind the spreader
+     * \param destination the address of the receiver, behind the merger
+     */
+    void SetFlow(Ipv6Address source, Ipv6Address destination);
+
+    /**
+     * \brief Add a path between the spreader and the merger, the first one carries the flow
+     * \param spreaderPort the port of the spreader where the path starts
+     * \param mergerPort the port of the merger where the path arrives
+     * \param mergerLink the device of the merger node where the path arrives, whose
+     *        MacPromiscRx trace gives the latency samples
+     */
+    void AddPath(uint32_t spreaderPort, uint32_t mergerPort, Ptr<NetDevice> mergerLink);
+
+    /**
+     * \brief Add the entries of the flow on the first path and connect to the paths
+     */
+    void Start();
+
+    /**
+     * \brief Trace sink for the segments received by the TCP receiver of the flow
+     * \param packet the segment payload
+     * \param header the TCP header
+     * \param socket the receiving socket
+     */
+    void ReceiveTcpSegment(Ptr<const Packet> packet,
+                           const TcpHeader& header,
+                           Ptr<const TcpSocketBase> socket);
+
+    /**
+     * \return the path carrying the flow, in AddPath() order
+     */
+    uint32_t GetPath() const;
+
+    /**
+     * \return true if the flow is replicated on all the paths
+     */
+    bool IsProbing() const;
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * A path between the spreader and the merger, with its latency samples
+     */
+    struct Path
+    {
+        uint32_t spreaderPort;        //!< Egress port of the spreader
+        uint32_t mergerPort;          //!< Ingress port of the merger
+        Ptr<NetDevice> link;          //!< Device of the merger node receiving the path
+        std::vector<int64_t> samples; //!< Last samples, in ns, as a ring
+        uint32_t next;                //!< Ring index of the next sample
+        uint32_t count;               //!< Samples in the ring
+        Time first;                   //!< Arrival of the first packet of the sample
+        bool pending;                 //!< Whether first is set
+    };
+
+    /**
+     * \brief Trace sink for the frames received on a path
+     * \param path the path, in AddPath() order
+     * \param packet the frame
+     */
+    void ReceiveFrame(uint32_t path, Ptr<const Packet> packet);
+
+    /**
+     * \brief Add a latency sample to a path and react to it
+     * \param path the path, in AddPath() order
+     * \param sample the sample
+     */
+    void AddSample(uint32_t path, Time sample);
+
+    /**
+     * \param path the path, in AddPath() order
+     * \return the Percentile of the samples of the path, zero if there are none
+     */
+    Time GetLatency(uint32_t path);
+
+    /**
+     * \brief Forget the samples of all the paths
+     */
+    void ClearSamples();
+
+    /**
+     * \brief Replicate the flow on all the paths
+     */
+    void StartProbe();
+
+    /**
+     * \brief Move the flow to the path of the replicas with the lowest latency
+     */
+    void EndProbe();
+
+    /**
+     * \brief Move the flow, in both directions, to a path
+     * \param path the path, in AddPath() order
+     */
+    void SetPath(uint32_t path);
+
+    /**
+     * \brief Modify an entry of check_live_live_enabled
+     * \param device the switch
+     * \param handle the entry
+     * \param action the action
+     * \param params the action parameters
+     */
+    void ModifyEntry(Ptr<P4SwitchNetDevice> device,
+                     uint32_t handle,
+                     const std::string& action,
+                     const std::vector<std::string>& params);
+
+    Ptr<P4SwitchNetDevice> m_spreader; //!< Switch encapsulating the flow
+    Ptr<P4SwitchNetDevice> m_merger;   //!< Switch decapsulating the flow
+    Ipv6Address m_source;              //!< Source of the flow
+    Ipv6Address m_destination;         //!< Destination of the flow
+    std::vector<Path> m_paths;         //!< Paths, in AddPath() order
+    std::vector<int64_t> m_scratch;    //!< Copy of a ring, to compute its percentile
+
+    Mode m_mode;                    //!< Events the controller reacts to
+    Time m_target_latency;          //!< Latency that starts a probe
+    double m_percentile;            //!< Percentile of the samples used as latency
+    uint32_t m_window_size;         //!< Samples kept for each path
+    uint32_t m_min_samples;         //!< Samples needed to react to the latency
+    Time m_probe_time;              //!< Duration of the replication on all the paths
+    uint32_t m_ooo_threshold;       //!< Out of order segments that move the flow
+    uint32_t m_tcp_path;            //!< Path the out of order segments move the flow to
+    uint16_t m_mcast_group;         //!< Multicast group replicating on all the paths
+    Ipv6Address m_spreader_address; //!< SRv6 source address of the spreader
+    Ipv6Address m_merger_address;   //!< SRv6 source address of the merger
+    uint32_t m_spreader_handle;     //!< Entry of the flow on the spreader
+    uint32_t m_merger_handle;       //!< Entry of the flow on the merger
+    uint32_t m_path;                //!< Path carrying the flow
+    bool m_probing;                 //!< Whether the flow is replicated on all the paths
+    EventId m_probe_event;          //!< End of the probe
+    SequenceNumber32 m_last_seq;    //!< Highest TCP sequence number received
+    uint32_t m_ooo_segments;        //!< Out of order segments since the last move
+
+    TracedCallback<uint32_t, Time> m_sample_trace;  //!< Latency sample of a path
+    TracedCallback<uint32_t, Time> m_latency_trace; //!< Latency of a path, at every sample
+    TracedCallback<uint32_t> m_alert_trace;         //!< Path that crossed its threshold
+    TracedCallback<uint32_t> m_path_trace;          //!< Path carrying the flow, when it changes
+};
+
+} // namespace ns3
+
+#endif /* SRV6_PATH_CONTROLLER_H */
@@ -0,0 +1,599 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+
+#include "ns3/live-live-net-device.h"
+#include "ns3/live-live-path-monitor.h"
+#include "ns3/live-live-path-selector.h"
+#include "ns3/p4-pipeline.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/test.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch-tests
+ * LiveLiveNetDevice test suite: the native model against srv6_livelive.p4 on bmv2.
+ */
+
+/**
+ * \ingroup p4-switch
+ * \defgroup p4-switch-tests P4 switch module tests
+ */
+
+using namespace ns3;
+
+namespace
+{
+
+/**
+ * Switch configuration shared by both implementations: sources in 2001::/64 are multicast to
+ * ports 2-4, sources in 2003::/64 are sent to port 5 through e2::2, and deduplicated packets
+ * for 2002::/64 are delivered to port 6.
+ */
+const char* COMMANDS = "mc_mgrp_create 1\n"
+                       "mc_node_create 1 4 2 3\n"
+                       "mc_node_associate 1 0\n"
+                       "table_add check_live_live_enabled live_live_mcast 2001::/64 => 1 e1::2\n"
+                       "table_add check_live_live_enabled ipv6_encap_forward_port 2003::/64 => "
+                       "e1::2 5\n"
+                       "table_add srv6_forward add_srv6_dest_segment 5 => e2::2\n"
+                       "table_add srv6_live_live_forward add_srv6_ll_segment 1 => e2::55\n"
+                       "table_add srv6_function srv6_ll_deduplicate 85 =>\n"
+                       "table_add ipv6_forward forward 2002::/64 => 6 00:00:00:00:00:a2\n";
+
+const uint8_t PROTO_TCP = 6;
+const uint8_t PROTO_UDP = 17;
+
+/**
+ * Offsets in the frames emitted by the spreader: Ethernet, IPv6, SRH with one segment, TLV,
+ * inner IPv6, UDP and the two bytes that the program rewrites with the sequence number
+ */
+const size_t TLV_OFFSET = 14 + 40 + 8 + 16;
+const size_t META_OFFSET = TLV_OFFSET + 8 + 40 + 8;
+
+/**
+ * Build an Ethernet/IPv6/UDP or TCP frame
+ */
+Ptr<Packet>
+MakeFrame(const char* src,
+          const char* dst,
+          uint8_t proto,
+          uint16_t srcPort,
+          uint16_t dstPort,
+          uint32_t payloadSize)
+{
+    uint32_t l4Size = (proto == PROTO_TCP ? 20 : 8) + payloadSize;
+    std::vector<uint8_t> frame(14 + 40 + l4Size, 0);
+    uint8_t* p = frame.data();
+
+    const uint8_t eth[] = {0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1, 0x86, 0xdd};
+    std::memcpy(p, eth, sizeof(eth));
+    p += sizeof(eth);
+
+    p[0] = 0x60;
+    p[4] = l4Size >> 8;
+    p[5] = l4Size & 0xff;
+    p[6] = proto;
+    p[7] = 64;
+    inet_pton(AF_INET6, src, p + 8);
+    inet_pton(AF_INET6, dst, p + 24);
+    p += 40;
+
+    p[0] = srcPort >> 8;
+    p[1] = srcPort & 0xff;
+    p[2] = dstPort >> 8;
+    p[3] = dstPort & 0xff;
+    if (proto == PROTO_TCP)
+    {
+        p[12] = 5 << 4;
+        p[13] = 0x10;
+        p[14] = 0xff;
+        p[15] = 0xff;
+        p += 20;
+    }
+    else
+    {
+        p[4] = l4Size >> 8;
+        p[5] = l4Size & 0xff;
+        p += 8;
+    }
+
+    for (uint32_t i = 0; i < payloadSize; i++)
+    {
+        p[i] = 0x80 + i;
+    }
+
+    return Create<Packet>(frame.data(), frame.size());
+}
+
+std::vector<uint8_t>
+GetBytes(Ptr<const Packet> packet)
+{
+    std::vector<uint8_t> bytes(packet->GetSize());
+    packet->CopyData(bytes.data(), bytes.size());
+    return bytes;
+}
+
+} // namespace
+
+/**
+ * \ingroup p4-switch-tests
+ * \brief Spreader and merger behavior of the native model
+ */
+class LiveLiveNativeTestCase : public TestCase
+{
+  public:
+    /**
+     * \brief Create the test
+     */
+    LiveLiveNativeTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+LiveLiveNativeTestCase::LiveLiveNativeTestCase()
+    : TestCase("Native Live-Live spreader and merger")
+{
+}
+
+void
+LiveLiveNativeTestCase::DoRun()
+{
+    // Check value of CRC-32, the flow ids depend on it matching bmv2's crc32
+    const uint8_t check[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    NS_TEST_EXPECT_MSG_EQ(LiveLiveNetDevice::Crc32(check, sizeof(check)),
+                          0xcbf43926,
+                          "Unexpected CRC-32");
+
+    Ptr<LiveLiveNetDevice> device = CreateObject<LiveLiveNetDevice>();
+    device->SetAttribute("PipelineCommands", StringValue(COMMANDS));
+
+    Ptr<Packet> frame = MakeFrame("2001::1", "2002::1", PROTO_UDP, 1000, 2000, 32);
+    std::vector<LiveLiveNetDevice::Output> replicas;
+    device->Process(frame, 1, replicas);
+
+    NS_TEST_ASSERT_MSG_EQ(replicas.size(), 3, "One replica per port of the multicast group");
+    for (size_t i = 0; i < replicas.size(); i++)
+    {
+        NS_TEST_EXPECT_MSG_EQ(replicas[i].port, i + 2, "Replicas are sent in port order");
+        std::vector<uint8_t> bytes = GetBytes(replicas[i].packet);
+        NS_TEST_ASSERT_MSG_EQ(bytes.size(), frame->GetSize() + 40 + 8 + 16 + 8, "SRv6 overhead");
+        NS_TEST_EXPECT_MSG_EQ(bytes[TLV_OFFSET], 0xff, "Live-Live TLV type");
+        NS_TEST_EXPECT_MSG_EQ(((bytes[TLV_OFFSET + 2] << 8) | bytes[TLV_OFFSET + 3]),
+                              1,
+                              "First sequence number of the flow");
+        NS_TEST_EXPECT_MSG_EQ(((bytes[META_OFFSET] << 8) | bytes[META_OFFSET + 1]),
+                              1,
+                              "Sequence number copied to the UDP payload");
+    }
+
+    // The first copy is decapsulated and forwarded, the others are duplicates
+    std::vector<LiveLiveNetDevice::Output> delivered;
+    device->Process(replicas[1].packet, 3, delivered);
+    NS_TEST_ASSERT_MSG_EQ(delivered.size(), 1, "First copy delivered");
+    NS_TEST_EXPECT_MSG_EQ(delivered[0].port, 6, "Forwarded by the inner destination");
+    device->Process(replicas[0].packet, 2, delivered);
+    device->Process(replicas[2].packet, 4, delivered);
+    NS_TEST_EXPECT_MSG_EQ(delivered.size(), 1, "Duplicates dropped");
+
+    // The delivered frame is the original one, with the new MAC destination and the sequence
+    // number in the first two bytes of the UDP payload
+    std::vector<uint8_t> expected = GetBytes(frame);
+    expected[5] = 0xa2;
+    expected[14 + 40 + 8] = 0;
+    expected[14 + 40 + 8 + 1] = 1;
+    std::vector<uint8_t> bytes = GetBytes(delivered[0].packet);
+    NS_TEST_EXPECT_MSG_EQ((bytes == expected), true, "Decapsulated frame");
+
+    Simulator::Destroy();
+}
+
+/**
+ * \ingroup p4-switch-tests
+ * \brief Replication restricted by LiveLivePathSelector to the paths delivering first
+ */
+class LiveLivePathSelectorTestCase : public TestCase
+{
+  public:
+    /**
+     * \brief Create the test
+     */
+    LiveLivePathSelectorTestCase();
+
+  private:
+    void DoRun() override;
+};
+
+LiveLivePathSelectorTestCase::LiveLivePathSelectorTestCase()
+    : TestCase("Live-Live replication on the selected paths")
+{
+}
+
+void
+LiveLivePathSelectorTestCase::DoRun()
+{
+    Ptr<LiveLiveNetDevice> spreader = CreateObject<LiveLiveNetDevice>();
+    spreader->SetAttribute("PipelineCommands", StringValue(COMMANDS));
+    Ptr<LiveLiveNetDevice> merger = CreateObject<LiveLiveNetDevice>();
+    merger->SetAttribute("PipelineCommands", StringValue(COMMANDS));
+
+    Ptr<LiveLivePathSelector> selector = CreateObject<LiveLivePathSelector>();
+    selector->SetAttribute("ActivePaths", UintegerValue(1));
+    selector->SetAttribute("ProbePaths", UintegerValue(0));
+    selector->SetSpreader(spreader);
+    selector->SetMerger(merger);
+    for (uint32_t port = 2; port <= 4; port++)
+    {
+        selector->AddPath(port, port);
+    }
+
+    // The copies through port 3 always arrive first
+    Ptr<Packet> frame = MakeFrame("2001::1", "2002::1", PROTO_UDP, 1000, 2000, 32);
+    std::vector<LiveLiveNetDevice::Output> replicas;
+    std::vector<LiveLiveNetDevice::Output> delivered;
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        replicas.clear();
+        spreader->Process(frame, 1, replicas);
+        NS_TEST_ASSERT_MSG_EQ(replicas.size(), 3, "Replicated on all the paths");
+        merger->Process(replicas[1].packet, 3, delivered);
+        merger->Process(replicas[0].packet, 2, delivered);
+        merger->Process(replicas[2].packet, 4, delivered);
+        if (i == 0)
+        {
+            // The first round sees the new flow, and starts measuring it
+            selector->Update();
+        }
+    }
+    NS_TEST_EXPECT_MSG_EQ(delivered.size(), 10, "One copy delivered per packet");
+
+    std::vector<uint8_t> bytes = GetBytes(replicas[0].packet);
+    uint32_t slot = ((bytes[TLV_OFFSET + 6] << 8) | bytes[TLV_OFFSET + 7]) & 0x3ff;
+    uint64_t wins = 0;
+    NS_TEST_EXPECT_MSG_EQ(merger->RegisterRead("IngressPipe.path_wins", (slot << 7) | 3, wins),
+                          true,
+                          "Readable register");
+    NS_TEST_EXPECT_MSG_EQ(wins, 10, "First copies of port 3");
+    NS_TEST_EXPECT_MSG_EQ(merger->RegisterRead("unknown", 0, wins), false, "Unknown register");
+
+    selector->Update();
+    replicas.clear();
+    spreader->Process(frame, 1, replicas);
+    NS_TEST_ASSERT_MSG_EQ(replicas.size(), 1, "Replicated on the best path only");
+    NS_TEST_EXPECT_MSG_EQ(replicas[0].port, 3, "Best path");
+    uint64_t group = 0;
+    spreader->RegisterRead("flow_mcast_grp", slot, group);
+    NS_TEST_EXPECT_MSG_EQ(group, 2 + slot, "Multicast group of the slot");
+    merger->Process(replicas[0].packet, 3, delivered);
+    NS_TEST_EXPECT_MSG_EQ(delivered.size(), 11, "Delivered through the best path");
+
+    // Without deliveries in a round, e.g. if the best path fails, all the paths are used again
+    selector->Update();
+    selector->Update();
+    replicas.clear();
+    spreader->Process(frame, 1, replicas);
+    NS_TEST_EXPECT_MSG_EQ(replicas.size(), 3, "Replicated on all the paths again");
+
+    Simulator::Destroy();
+}
+
+/**
+ * \ingroup p4-switch-tests
+ * \brief First-arrival statistics of the merger, reported by LiveLivePathMonitor
+ */
+class LiveLivePathMonitorTestCase : public TestCase
+{
+  public:
+    /**
+     * \brief Create the test
+     */
+    LiveLivePathMonitorTestCase();
+
+  private:
+    void DoRun() override;
+
+    /**
+     * \brief Save a report of the monitor
+     * \param stats the statistics of a path
+     */
+    void PathStats(const LiveLivePathStats& stats);
+
+    std::vector<LiveLivePathStats> m_stats; //!< Reports, in order
+};
+
+LiveLivePathMonitorTestCase::LiveLivePathMonitorTestCase()
+    : TestCase("Live-Live first-arrival statistics per path")
+{
+}
+
+void
+LiveLivePathMonitorTestCase::PathStats(const LiveLivePathStats& stats)
+{
+    m_stats.push_back(stats);
+}
+
+void
+LiveLivePathMonitorTestCase::DoRun()
+{
+    Ptr<LiveLiveNetDevice> spreader = CreateObject<LiveLiveNetDevice>();
+    spreader->SetAttribute("PipelineCommands", StringValue(COMMANDS));
+    // A window of a single block, so that packets soon become too old
+    Ptr<LiveLiveNetDevice> merger = CreateObject<LiveLiveNetDevice>();
+    merger->SetAttribute("PipelineCommands", StringValue(COMMANDS));
+    merger->SetAttribute("WindowWordBits", UintegerValue(0));
+
+    Ptr<LiveLivePathMonitor> monitor = CreateObject<LiveLivePathMonitor>();
+    monitor->SetMerger(merger);
+    for (uint32_t port = 2; port <= 4; port++)
+    {
+        monitor->AddPort(port);
+    }
+    monitor->TraceConnectWithoutContext(
+        "PathStats",
+        MakeCallback(&LiveLivePathMonitorTestCase::PathStats, this));
+
+    // Port 3 delivers first, port 2 is 8 us behind, port 4 arrives third
+    Ptr<Packet> frame = MakeFrame("2001::1", "2002::1", PROTO_UDP, 1000, 2000, 32);
+    std::vector<LiveLiveNetDevice::Output> replicas;
+    std::vector<LiveLiveNetDevice::Output> delivered;
+    spreader->Process(frame, 1, replicas);
+    NS_TEST_ASSERT_MSG_EQ(replicas.size(), 3, "Replicated on all the paths");
+    merger->Process(replicas[1].packet, 3, delivered);
+    Simulator::Schedule(MicroSeconds(8), [&]() {
+        merger->Process(replicas[0].packet, 2, delivered);
+    });
+    Simulator::Schedule(MicroSeconds(16), [&]() {
+        merger->Process(replicas[2].packet, 4, delivered);
+    });
+
+    // After 130 more packets, the first one is two blocks behind
+    Simulator::Schedule(MicroSeconds(20), [&]() {
+        std::vector<LiveLiveNetDevice::Output> next;
+        for (uint32_t i = 0; i < 130; i++)
+        {
+            next.clear();
+            spreader->Process(frame, 1, next);
+            merger->Process(next[1].packet, 3, delivered);
+        }
+        merger->Process(replicas[0].packet, 2, delivered);
+    });
+    Simulator::Schedule(MicroSeconds(30), &LiveLivePathMonitor::Update, monitor);
+    Simulator::Run();
+
+    NS_TEST_EXPECT_MSG_EQ(delivered.size(), 131, "One copy delivered per packet");
+    NS_TEST_ASSERT_MSG_EQ(m_stats.size(), 3, "One report per port with packets");
+    NS_TEST_EXPECT_MSG_EQ(m_stats[0].port, 2, "Reports in port order");
+    NS_TEST_EXPECT_MSG_EQ(m_stats[0].wins, 0, "No first copies on port 2");
+    NS_TEST_EXPECT_MSG_EQ(m_stats[0].dups, 1, "Duplicate on port 2");
+    NS_TEST_EXPECT_MSG_EQ(m_stats[0].tooOld, 1, "Packet behind the window on port 2");
+    NS_TEST_EXPECT_MSG_EQ(m_stats[0].gap, NanoSeconds(8000 >> 3), "First gap sample of port 2");
+    NS_TEST_EXPECT_MSG_EQ(m_stats[1].wins, 131, "First copies on port 3");
+    NS_TEST_EXPECT_MSG_EQ(m_stats[1].dups, 0, "No duplicates on port 3");
+    NS_TEST_EXPECT_MSG_EQ(m_stats[2].dups, 1, "Duplicate on port 4");
+    NS_TEST_EXPECT_MSG_EQ(m_stats[2].gap, Time(0), "Only the runner-up is measured");
+
+    // No new packets, no reports
+    m_stats.clear();
+    monitor->Update();
+    NS_TEST_EXPECT_MSG_EQ(m_stats.size(), 0, "No reports without packets");
+
+    Simulator::Destroy();
+}
+
+/**
+ * \ingroup p4-switch-tests
+ * \brief Run the same frames through srv6_livelive.p4 on bmv2 and through the native model,
+ *        and compare the outputs byte for byte
+ */
+class LiveLiveConformanceTestCase : public TestCase
+{
+  public:
+    /**
+     * \brief Create the test
+     * \param json the bmv2 JSON of srv6_livelive.p4
+     */
+    LiveLiveConformanceTestCase(std::string json);
+
+  private:
+    void DoRun() override;
+
+    /**
+     * \brief Process a frame with both implementations and compare the outputs
+     * \param frame the frame
+     * \param port the ingress port
+     * \return the frames emitted by bmv2
+     */
+    std::vector<P4PipelineOutput> Compare(Ptr<const Packet> frame, uint32_t port);
+
+    /**
+     * \brief Send frames from several flows through the spreader, then their replicas through
+     *        the merger, reordered and duplicated
+     */
+    void RunBurst();
+
+    /**
+     * \brief Send a long flow, so that the window moves and old packets become too old
+     */
+    void RunLongFlow();
+
+    std::string m_json;                     //!< bmv2 JSON file
+    std::unique_ptr<P4Pipeline> m_pipeline; //!< bmv2 implementation
+    Ptr<LiveLiveNetDevice> m_native;        //!< Native implementation
+    uint32_t m_frames;                      //!< Frames compared so far
+};
+
+LiveLiveConformanceTestCase::LiveLiveConformanceTestCase(std::string json)
+    : TestCase("Native Live-Live against srv6_livelive.p4 on bmv2"),
+      m_json(json),
+      m_frames(0)
+{
+}
+
+std::vector<P4PipelineOutput>
+LiveLiveConformanceTestCase::Compare(Ptr<const Packet> frame, uint32_t port)
+{
+    std::vector<P4PipelineOutput> expected;
+    m_pipeline->process(frame, port, expected);
+    std::vector<LiveLiveNetDevice::Output> actual;
+    m_native->Process(frame, port, actual);
+
+    NS_TEST_EXPECT_MSG_EQ(actual.size(),
+                          expected.size(),
+                          "Different number of outputs for frame " << m_frames);
+    for (size_t i = 0; i < std::min(actual.size(), expected.size()); i++)
+    {
+        NS_TEST_EXPECT_MSG_EQ(actual[i].port,
+                              expected[i].port,
+                              "Different port for output " << i << " of frame " << m_frames);
+        NS_TEST_EXPECT_MSG_EQ((GetBytes(actual[i].packet) == GetBytes(expected[i].packet)),
+                              true,
+                              "Different bytes for output " << i << " of frame " << m_frames);
+    }
+    m_frames++;
+    return expected;
+}
+
+void
+LiveLiveConformanceTestCase::RunBurst()
+{
+    std::vector<Ptr<const Packet>> frames = {
+        MakeFrame("2001::1", "2002::1", PROTO_UDP, 1000, 2000, 64),
+        MakeFrame("2001::1", "2002::1", PROTO_UDP, 1001, 2000, 1),
+        MakeFrame("2001::2", "2002::2", PROTO_TCP, 40000, 80, 100),
+        MakeFrame("2001::1", "2002::1", PROTO_UDP, 1000, 2000, 64),
+        MakeFrame("2003::1", "2002::3", PROTO_UDP, 1000, 2000, 16),
+        MakeFrame("2004::1", "2002::4", PROTO_UDP, 1000, 2000, 16),
+    };
+
+    std::vector<std::vector<P4PipelineOutput>> replicas;
+    for (const auto& frame : frames)
+    {
+        replicas.push_back(Compare(frame, 1));
+    }
+
+    // Non-IPv6 frames are dropped
+    uint8_t eth[14] = {0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1, 0x08, 0x06};
+    Ptr<Packet> arp = Create<Packet>(eth, sizeof(eth));
+    arp->AddAtEnd(Create<Packet>(64));
+    Compare(arp, 1);
+
+    // Merger: the copies of the multicast frames arrive in a different order on each path
+    for (size_t copy = 0; copy < 3; copy++)
+    {
+        for (size_t i = 0; i < 4; i++)
+        {
+            size_t frame = (copy % 2) ? 3 - i : i;
+            if (copy < replicas[frame].size())
+            {
+                Compare(replicas[frame][copy].packet, replicas[frame][copy].port);
+            }
+        }
+    }
+}
+
+void
+LiveLiveConformanceTestCase::RunLongFlow()
+{
+    // After the idle timeout the flow starts a new epoch, which takes over the merger slot
+    Ptr<Packet> frame = MakeFrame("2001::1", "2002::1", PROTO_UDP, 1000, 2000, 16);
+    std::vector<P4PipelineOutput> first;
+    for (uint32_t i = 0; i < 1200; i++)
+    {
+        std::vector<P4PipelineOutput> replicas = Compare(frame, 1);
+        if (i == 0)
+        {
+            first = replicas;
+        }
+        if (!replicas.empty() && i % 3 != 1)
+        {
+            Compare(replicas[i % replicas.size()].packet, 2);
+        }
+    }
+
+    // The first packets are now behind the window
+    for (const auto& replica : first)
+    {
+        Compare(replica.packet, replica.port);
+    }
+}
+
+void
+LiveLiveConformanceTestCase::DoRun()
+{
+    m_pipeline = std::make_unique<P4Pipeline>(m_json,
+                                              "conformance",
+                                              false,
+                                              bm::Logger::LogLevel::OFF);
+    m_pipeline->run_cli_commands(COMMANDS);
+    m_native = CreateObject<LiveLiveNetDevice>();
+    m_native->SetAttribute("PipelineCommands", StringValue(COMMANDS));
+
+    Simulator::Schedule(Seconds(0), &LiveLiveConformanceTestCase::RunBurst, this);
+    // Later than FlowIdleTimeout after the burst, which uses the same flow
+    Simulator::Schedule(Seconds(2), &LiveLiveConformanceTestCase::RunLongFlow, this);
+    Simulator::Run();
+    Simulator::Destroy();
+
+    m_native = nullptr;
+    m_pipeline = nullptr;
+}
+
+/**
+ * \ingroup p4-switch-tests
+ * \brief TestSuite for the native Live-Live model
+ *
+ * The tests on bmv2 need srv6_livelive.p4 compiled with p4c, found at
+ * NS3_LIVE_LIVE_JSON or where the Makefile of the simulation image builds it, and are skipped
+ * otherwise.
+ */
+class LiveLiveTestSuite : public TestSuite
+{
+  public:
+    /**
+     * \brief Constructor
+     */
+    LiveLiveTestSuite();
+};
+
+LiveLiveTestSuite::LiveLiveTestSuite()
+    : TestSuite("p4-switch-live-live", UNIT)
+{
+    AddTestCase(new LiveLiveNativeTestCase, TestCase::QUICK);
+    AddTestCase(new LiveLivePathSelectorTestCase, TestCase::QUICK);
+    AddTestCase(new LiveLivePathMonitorTestCase, TestCase::QUICK);
+
+    const char* env = std::getenv("NS3_LIVE_LIVE_JSON");
+    std::string json =
+        env ? env : "/ns3/ns-3.40/examples/srv6-live-live/livelive_build/srv6_livelive.json";
+    if (std::ifstream(json).good())
+    {
+        AddTestCase(new LiveLiveConformanceTestCase(json), TestCase::QUICK);
+    }
+}
+
+static LiveLiveTestSuite g_liveLiveTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,384 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Mariano Scazzariello <marianos@kth.se>
+ */
+
+#include "ns3/p4-pipeline.h"
+#include "ns3/simulator.h"
+#include "ns3/test.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * \file
+ * \ingroup p4-switch-tests
+ * P4Pipeline test suite: snapshots and transactions on srv6_livelive.p4.
+ */
+
+using namespace ns3;
+
+namespace
+{
+
+/**
+ * Entries in all the tables with entries of srv6_livelive.p4, several of them after the
+ * egress tables with a const default action
+ */
+const char* COMMANDS = "mc_mgrp_create 1\n"
+                       "mc_node_create 1 4 2 3\n"
+                       "mc_node_associate 1 0\n"
+                       "table_add check_live_live_enabled live_live_mcast 2001::/64 => 1 e1::2\n"
+                       "table_add check_live_live_enabled ipv6_encap_forward_port 2003::/64 => "
+                       "e1::2 5\n"
+                       "table_add srv6_forward add_srv6_dest_segment 5 => e2::2\n"
+                       "table_add srv6_live_live_forward add_srv6_ll_segment 1 => e2::55\n"
+                       "table_add srv6_function srv6_ll_deduplicate 85 =>\n"
+                       "table_add ipv6_forward forward 2002::/64 => 6 00:00:00:00:00:a2\n";
+
+/**
+ * \return the bmv2 JSON of srv6_livelive.p4, at NS3_LIVE_LIVE_JSON or where the Makefile of
+ *         the simulation image builds it
+ */
+std::string
+GetLiveLiveJson()
+{
+    const char* env = std::getenv("NS3_LIVE_LIVE_JSON");
+    return env ? env : "/ns3/ns-3.40/examples/srv6-live-live/livelive_build/srv6_livelive.json";
+}
+
+/**
+ * Build an Ethernet/IPv6/UDP frame to 2002::1
+ */
+Ptr<Packet>
+MakeFrame(const char* src)
+{
+    const uint32_t l4Size = 8 + 16;
+    std::vector<uint8_t> frame(14 + 40 + l4Size, 0);
+    uint8_t* p = frame.data();
+
+    const uint8_t eth[] = {0, 0, 0, 0, 0, 2, 0, 0, 0, 0, 0, 1, 0x86, 0xdd};
+    std::memcpy(p, eth, sizeof(eth));
+    p += sizeof(eth);
+
+    p[0] = 0x60;
+    p[5] = l4Size;
+    p[6] = 17;
+    p[7] = 64;
+    inet_pton(AF_INET6, src, p + 8);
+    inet_pton(AF_INET6, "2002::1", p + 24);
+    p += 40;
+
+    p[0] = 1000 >> 8;
+    p[1] = 1000 & 0xff;
+    p[2] = 2000 >> 8;
+    p[3] = 2000 & 0xff;
+    p[5] = l4Size;
+
+    return Create<Packet>(frame.data(), frame.size());
+}
+
+/**
+ * \return the content of a file
+ */
+std::string
+ReadFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+} // namespace
+
+/**
+ * \ingroup p4-switch-tests
+ * \brief Base of the test cases that need srv6_livelive.p4 compiled with p4c, which are
+ *        reported as skipped when it cannot be found
+ */
+class P4PipelineTestCase : public TestCase
+{
+  public:
+    /**
+     * \brief Create the test
+     * \param name the test name
+     */
+    P4PipelineTestCase(std::string name);
+
+  protected:
+    /**
+     * \brief Run the test on a pipeline configured with COMMANDS
+     */
+    virtual void DoRunPipeline() = 0;
+
+    /**
+     * \return a new pipeline running srv6_livelive.p4
+     */
+    std::unique_ptr<P4Pipeline> CreatePipeline();
+
+    std::unique_ptr<P4Pipeline> m_pipeline; //!< Pipeline configured with COMMANDS
+
+  private:
+    void DoRun() override;
+
+    std::string m_json; //!< bmv2 JSON file
+};
+
+P4PipelineTestCase::P4PipelineTestCase(std::string name)
+    : TestCase(name),
+      m_json(GetLiveLiveJson())
+{
+}
+
+std::unique_ptr<P4Pipeline>
+P4PipelineTestCase::CreatePipeline()
+{
+    return std::make_unique<P4Pipeline>(m_json, "test", false, bm::Logger::LogLevel::OFF);
+}
+
+void
+P4PipelineTestCase::DoRun()
+{
+    if (!std::ifstream(m_json).good())
+    {
+        std::clog << "SKIP: " << GetName() << ", " << m_json
+                  << " not found (set NS3_LIVE_LIVE_JSON)" << std::endl;
+        return;
+    }
+
+    m_pipeline = CreatePipeline();
+    m_pipeline->run_cli_commands(COMMANDS);
+    DoRunPipeline();
+    m_pipeline = nullptr;
+}
+
+/**
+ * \ingroup p4-switch-tests
+ * \brief Dump the tables, load them into a new pipeline and dump them again
+ */
+class P4PipelineSnapshotTestCase : public P4PipelineTestCase
+{
+  public:
+    /**
+     * \brief Create the test
+     */
+    P4PipelineSnapshotTestCase();
+
+  private:
+    void DoRunPipeline() override;
+};
+
+P4PipelineSnapshotTestCase::P4PipelineSnapshotTestCase()
+    : P4PipelineTestCase("Table snapshot round trip on srv6_livelive.p4")
+{
+}
+
+void
+P4PipelineSnapshotTestCase::DoRunPipeline()
+{
+    std::string first = CreateTempDirFilename("first.snapshot");
+    std::string second = CreateTempDirFilename("second.snapshot");
+    std::string error;
+
+    NS_TEST_ASSERT_MSG_EQ(m_pipeline->dump_table_snapshot(first, error),
+                          true,
+                          "Dump failed: " << error);
+    std::unique_ptr<P4Pipeline> loaded = CreatePipeline();
+    NS_TEST_ASSERT_MSG_EQ(loaded->load_table_snapshot(first, error),
+                          true,
+                          "Load failed: " << error);
+    NS_TEST_ASSERT_MSG_EQ(loaded->dump_table_snapshot(second, error),
+                          true,
+                          "Second dump failed: " << error);
+    NS_TEST_EXPECT_MSG_EQ((ReadFile(first) == ReadFile(second)),
+                          true,
+                          "Tables differ after the round trip");
+
+    // Nothing is loaded from a snapshot that does not match the program
+    std::string corrupt = CreateTempDirFilename("corrupt.snapshot");
+    std::string content = ReadFile(first);
+    std::ofstream(corrupt, std::ios::binary) << content.substr(0, content.size() - 1);
+    std::unique_ptr<P4Pipeline> empty = CreatePipeline();
+    NS_TEST_EXPECT_MSG_EQ(empty->load_table_snapshot(corrupt, error),
+                          false,
+                          "Truncated snapshot loaded");
+    NS_TEST_ASSERT_MSG_EQ(empty->dump_table_snapshot(second, error),
+                          true,
+                          "Dump failed: " << error);
+    std::unique_ptr<P4Pipeline> fresh = CreatePipeline();
+    NS_TEST_ASSERT_MSG_EQ(fresh->dump_table_snapshot(first, error),
+                          true,
+                          "Dump failed: " << error);
+    NS_TEST_EXPECT_MSG_EQ((ReadFile(first) == ReadFile(second)),
+                          true,
+                          "Truncated snapshot partially loaded");
+}
+
+/**
+ * \ingroup p4-switch-tests
+ * \brief Apply transactions of table and multicast changes
+ */
+class P4PipelineTransactionTestCase : public P4PipelineTestCase
+{
+  public:
+    /**
+     * \brief Create the test
+     */
+    P4PipelineTransactionTestCase();
+
+  private:
+    void DoRunPipeline() override;
+
+    /**
+     * \brief Commit transactions and check the ports of the frames processed after each one
+     */
+    void RunTransactions();
+
+    /**
+     * \brief Process a frame
+     * \param src the source address of the frame
+     * \return the sorted egress ports of the outputs
+     */
+    std::vector<uint32_t> GetPorts(const char* src);
+};
+
+P4PipelineTransactionTestCase::P4PipelineTransactionTestCase()
+    : P4PipelineTestCase("Transactions on srv6_livelive.p4")
+{
+}
+
+std::vector<uint32_t>
+P4PipelineTransactionTestCase::GetPorts(const char* src)
+{
+    std::vector<P4PipelineOutput> outputs;
+    m_pipeline->process(MakeFrame(src), 1, outputs);
+
+    std::vector<uint32_t> ports;
+    for (const auto& output : outputs)
+    {
+        ports.push_back(output.port);
+    }
+    std::sort(ports.begin(), ports.end());
+    return ports;
+}
+
+void
+P4PipelineTransactionTestCase::RunTransactions()
+{
+    // Entry 1 of check_live_live_enabled is 2003::/64, node 0 replicates on ports 2-4
+    std::string error;
+    P4PipelineTransaction swap;
+    swap.table_modify("check_live_live_enabled", "ipv6_encap_forward_port", 1, {"e1::2", "3"});
+    swap.mc_node_update(0, {2, 3});
+    NS_TEST_ASSERT_MSG_EQ(m_pipeline->commit(swap, error), true, "Commit failed: " << error);
+    NS_TEST_EXPECT_MSG_EQ((GetPorts("2003::1") == std::vector<uint32_t>{3}),
+                          true,
+                          "Modified entry not applied");
+    NS_TEST_EXPECT_MSG_EQ((GetPorts("2001::1") == std::vector<uint32_t>{2, 3}),
+                          true,
+                          "Updated node not applied");
+
+    // The modify is not applied when the delete has an invalid handle
+    P4PipelineTransaction failing;
+    failing.table_modify("check_live_live_enabled", "ipv6_encap_forward_port", 1, {"e1::2", "4"});
+    failing.mc_node_update(0, {4});
+    failing.table_delete("check_live_live_enabled", 99);
+    NS_TEST_EXPECT_MSG_EQ(m_pipeline->commit(failing, error), false, "Bad delete committed");
+    NS_TEST_EXPECT_MSG_EQ((GetPorts("2003::1") == std::vector<uint32_t>{3}),
+                          true,
+                          "Modify of a failed commit applied");
+    NS_TEST_EXPECT_MSG_EQ((GetPorts("2001::1") == std::vector<uint32_t>{2, 3}),
+                          true,
+                          "Update of a failed commit applied");
+
+    // Nothing is applied when a change cannot be staged
+    P4PipelineTransaction invalid;
+    invalid.table_modify("check_live_live_enabled", "ipv6_encap_forward_port", 1, {"e1::2", "4"});
+    invalid.table_add("no_such_table", "NoAction", {"1"}, {});
+    NS_TEST_EXPECT_MSG_EQ(m_pipeline->commit(invalid, error), false, "Bad table committed");
+    NS_TEST_EXPECT_MSG_EQ((GetPorts("2003::1") == std::vector<uint32_t>{3}),
+                          true,
+                          "Invalid transaction partially applied");
+
+    // Existing keys and multicast nodes outside their group are rejected before applying
+    P4PipelineTransaction duplicate;
+    duplicate.mc_node_dissociate(1, 0);
+    duplicate.table_add("check_live_live_enabled",
+                        "ipv6_encap_forward_port",
+                        {"2001::/64"},
+                        {"e1::2", "4"});
+    NS_TEST_EXPECT_MSG_EQ(m_pipeline->commit(duplicate, error), false, "Duplicate key committed");
+    P4PipelineTransaction dissociate;
+    dissociate.mc_node_dissociate(1, 0);
+    dissociate.mc_node_dissociate(1, 0);
+    NS_TEST_EXPECT_MSG_EQ(m_pipeline->commit(dissociate, error), false, "Bad dissociate committed");
+    NS_TEST_EXPECT_MSG_EQ((GetPorts("2001::1") == std::vector<uint32_t>{2, 3}),
+                          true,
+                          "Multicast node dissociated");
+
+    // A more specific entry replaces the deleted one
+    P4PipelineTransaction replace;
+    replace.table_add("check_live_live_enabled",
+                      "ipv6_encap_forward_port",
+                      {"2003::1/128"},
+                      {"e1::2", "2"});
+    replace.table_delete("check_live_live_enabled", 1);
+    NS_TEST_ASSERT_MSG_EQ(m_pipeline->commit(replace, error), true, "Commit failed: " << error);
+    NS_TEST_EXPECT_MSG_EQ(replace.get_added_handles().size(), 1, "Added handle not returned");
+    NS_TEST_EXPECT_MSG_EQ((GetPorts("2003::1") == std::vector<uint32_t>{2}),
+                          true,
+                          "Added entry not applied");
+}
+
+void
+P4PipelineTransactionTestCase::DoRunPipeline()
+{
+    Simulator::Schedule(Seconds(0), &P4PipelineTransactionTestCase::RunTransactions, this);
+    Simulator::Run();
+    Simulator::Destroy();
+}
+
+/**
+ * \ingroup p4-switch-tests
+ * \brief TestSuite for P4Pipeline
+ *
+ * The tests need srv6_livelive.p4 compiled with p4c, found at NS3_LIVE_LIVE_JSON or where the
+ * Makefile of the simulation image builds it, and are reported as skipped otherwise.
+ */
+class P4PipelineTestSuite : public TestSuite
+{
+  public:
+    /**
+     * \brief Constructor
+     */
+    P4PipelineTestSuite();
+};
+
+P4PipelineTestSuite::P4PipelineTestSuite()
+    : TestSuite("p4-switch-pipeline", UNIT)
+{
+    AddTestCase(new P4PipelineSnapshotTestCase, TestCase::QUICK);
+    AddTestCase(new P4PipelineTransactionTestCase, TestCase::QUICK);
+}
+
+static P4PipelineTestSuite g_p4PipelineTestSuite; //!< Static variable for test initialization